@@ -0,0 +1,219 @@
+#include "tracer.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// --- Record path: ns per event, at 1..N threads ---
+
+namespace
+{
+	const int kMaxThreads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+	const char* const kSessionFile = "tracer_bench_session.tmp";
+	const char* const kDumpFile = "tracer_bench_dump.tmp";
+
+	// A ring buffer keeps memory flat however many iterations the library picks
+	TraceOptions ringOptions()
+	{
+		TraceOptions options;
+		options.ringBufferEvents = 1 << 16;
+		return options;
+	}
+
+	void beginSession(benchmark::State& state, const TraceOptions& options)
+	{
+		if (state.thread_index() == 0)
+			ChromeTracer::instance().beginSession(kSessionFile, options);
+	}
+
+	void endSession(benchmark::State& state)
+	{
+		state.SetItemsProcessed(state.iterations());
+		if (state.thread_index() == 0)
+		{
+			ChromeTracer::instance().endSession();
+			std::remove(kSessionFile);
+		}
+	}
+}
+
+static void BM_ScopeTrace(benchmark::State& state)
+{
+	beginSession(state, ringOptions());
+	for (auto _ : state)
+	{
+		TRACE_SCOPE("scope");
+	}
+	endSession(state);
+}
+BENCHMARK(BM_ScopeTrace)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_ScopeTraceDynamicName(benchmark::State& state)
+{
+	const std::string name = "dynamic scope";
+	beginSession(state, ringOptions());
+	for (auto _ : state)
+	{
+		TRACE_SCOPE(name);
+	}
+	endSession(state);
+}
+BENCHMARK(BM_ScopeTraceDynamicName)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_BeginEnd(benchmark::State& state)
+{
+	beginSession(state, ringOptions());
+	for (auto _ : state)
+	{
+		TRACE_BEGIN("span", "bench");
+		TRACE_END("span", "bench");
+	}
+	endSession(state);
+}
+BENCHMARK(BM_BeginEnd)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_Span(benchmark::State& state)
+{
+	beginSession(state, ringOptions());
+	for (auto _ : state)
+	{
+		const TraceSpan span = TRACE_SPAN_BEGIN("span", "bench");
+		TRACE_SPAN_END(span);
+	}
+	endSession(state);
+}
+BENCHMARK(BM_Span)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_Instant(benchmark::State& state)
+{
+	beginSession(state, ringOptions());
+	for (auto _ : state)
+	{
+		TRACE_INSTANT("instant", "bench");
+	}
+	endSession(state);
+}
+BENCHMARK(BM_Instant)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_ScopeTraceSampled(benchmark::State& state)
+{
+	beginSession(state, ringOptions());
+	for (auto _ : state)
+	{
+		TRACE_SCOPE_SAMPLED("sampled", 64);
+	}
+	endSession(state);
+}
+BENCHMARK(BM_ScopeTraceSampled)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_ScopeTraceAggregate(benchmark::State& state)
+{
+	TraceOptions options;
+	options.aggregate = true;
+	beginSession(state, options);
+	for (auto _ : state)
+	{
+		TRACE_SCOPE("aggregated");
+	}
+	endSession(state);
+}
+BENCHMARK(BM_ScopeTraceAggregate)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+// Counters this machine cannot open are left out; the others are read with rdpmc
+static void BM_ScopeTracePerfCounters(benchmark::State& state)
+{
+	TraceOptions options = ringOptions();
+	options.perfCounters = { TracePerfCounter::Cycles, TracePerfCounter::Instructions, TracePerfCounter::CacheMisses };
+	beginSession(state, options);
+	for (auto _ : state)
+	{
+		TRACE_SCOPE("counted");
+	}
+	endSession(state);
+}
+BENCHMARK(BM_ScopeTracePerfCounters)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+// --- Disabled paths: should cost one load and branch ---
+
+static void BM_DisabledCategory(benchmark::State& state)
+{
+	TraceOptions options = ringOptions();
+	options.categories = { "enabled" };
+	beginSession(state, options);
+	for (auto _ : state)
+	{
+		TRACE_SCOPE("disabled");
+		TRACE_INSTANT("disabled", "disabled");
+	}
+	endSession(state);
+}
+BENCHMARK(BM_DisabledCategory)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+static void BM_NoSession(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		TRACE_SCOPE("inactive");
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NoSession);
+
+// --- Compiled out: TRACER_DISABLED macros must cost and evaluate nothing ---
+
+namespace tracer_bench
+{
+	extern int g_disabledEvaluations;
+	void disabledMacros(const std::string& name);    // bench_disabled.cpp
+}
+
+static void BM_CompiledOut(benchmark::State& state)
+{
+	const std::string name = "Worker_0";
+	for (auto _ : state)
+	{
+		tracer_bench::disabledMacros(name);
+	}
+	if (tracer_bench::g_disabledEvaluations != 0)
+		state.SkipWithError("disabled macros evaluated their arguments");
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CompiledOut);
+
+// --- Export throughput: events/sec through dumpFlightRecorder() ---
+
+static void BM_Export(benchmark::State& state)
+{
+	TraceOptions options;
+	options.format = static_cast<TraceFormat>(state.range(0));
+	const auto events = state.range(1);
+
+	ChromeTracer& tracer = ChromeTracer::instance();
+	tracer.beginSession(kSessionFile, options);
+	for (int64_t i = 0; i < events; ++i)
+	{
+		TRACE_SCOPE("exported");
+	}
+
+	for (auto _ : state)
+	{
+		if (!tracer.dumpFlightRecorder(kDumpFile))
+			state.SkipWithError("dump failed");
+	}
+	state.SetItemsProcessed(state.iterations() * events);
+
+	// Not timed: the loop is over
+	tracer.endSession();
+	std::remove(kSessionFile);
+	std::remove(kDumpFile);
+}
+BENCHMARK(BM_Export)
+	->ArgNames({ "format", "events" })
+	->Args({ static_cast<int64_t>(TraceFormat::Json), 1 << 20 })
+	->Args({ static_cast<int64_t>(TraceFormat::Perfetto), 1 << 20 })
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
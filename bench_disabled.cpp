@@ -0,0 +1,42 @@
+// Compiled with TRACER_DISABLED (see CMakeLists.txt), so every macro here
+// must compile to nothing, arguments included
+#include "tracer.h"
+
+#include <string>
+
+namespace tracer_bench
+{
+	int g_disabledEvaluations = 0;
+
+	// Counts every argument the macros evaluate; the benchmark expects none
+	void disabledMacros(const std::string& name)
+	{
+		TRACE_FUNCTION();
+		TRACE_FUNCTION_ARGS(TRACE_ARG("n", ++g_disabledEvaluations));
+		TRACE_FUNCTION_SAMPLED(++g_disabledEvaluations);
+		TRACE_FUNCTION_RATE_LIMITED(++g_disabledEvaluations);
+		TRACE_SCOPE((++g_disabledEvaluations, name + "_TaskA"));
+		TRACE_SCOPE_ARGS((++g_disabledEvaluations, name + "_TaskB"), TRACE_ARG("n", ++g_disabledEvaluations));
+		TRACE_SCOPE_SAMPLED((++g_disabledEvaluations, name), ++g_disabledEvaluations);
+		TRACE_SCOPE_RATE_LIMITED((++g_disabledEvaluations, name), ++g_disabledEvaluations);
+		TRACE_BEGIN((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"));
+		TRACE_BEGIN_ARGS((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), TRACE_ARG("n", ++g_disabledEvaluations));
+		TRACE_END((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"));
+		TRACE_INSTANT((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"));
+		TRACE_INSTANT_ARGS((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), TRACE_ARG("n", ++g_disabledEvaluations));
+		TRACE_COUNTER((++g_disabledEvaluations, name), ++g_disabledEvaluations);
+
+		TraceSpan span = TRACE_SPAN_BEGIN((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"));
+		TRACE_SPAN_END((++g_disabledEvaluations, span));
+
+		const uint64_t id = TRACE_NEW_ID();
+		TRACE_ASYNC_BEGIN((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), (++g_disabledEvaluations, id));
+		TRACE_ASYNC_INSTANT((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), (++g_disabledEvaluations, id));
+		TRACE_ASYNC_END((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), (++g_disabledEvaluations, id));
+		TRACE_FLOW_START((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), (++g_disabledEvaluations, id));
+		TRACE_FLOW_STEP((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), (++g_disabledEvaluations, id));
+		TRACE_FLOW_END((++g_disabledEvaluations, name), (++g_disabledEvaluations, "bench"), (++g_disabledEvaluations, id));
+		(void)id;
+		(void)name;
+	}
+}
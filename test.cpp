@@ -29,9 +29,9 @@ void computePhysics()
 	std::this_thread::sleep_for(std::chrono::milliseconds(15));
 	TRACE_END("BroadPhase", "physics");
 
-	TRACE_BEGIN("NarrowPhase", "physics");
+	const TraceSpan narrowPhase = TRACE_SPAN_BEGIN("NarrowPhase", "physics");
 	std::this_thread::sleep_for(std::chrono::milliseconds(25));
-	TRACE_END("NarrowPhase", "physics");
+	TRACE_SPAN_END(narrowPhase);
 }
 
 double heavyMath(int iterations)
@@ -46,6 +46,7 @@ double heavyMath(int iterations)
 void workerThread(int id)
 {
 	std::string name = "Worker_" + std::to_string(id);
+	ChromeTracer::instance().setThreadName(name, id + 1);
 	TRACE_SCOPE(name);
 
 	simulateWork(name + "_TaskA", 20 + id * 10);
@@ -57,6 +58,7 @@ int main()
 {
 	// Start the tracing session — all events go to this file
 	ChromeTracer::instance().beginSession("trace.json");
+	ChromeTracer::instance().setThreadName("Main", 0);
 
 	{
 		TRACE_SCOPE("Main");
@@ -1,130 +1,2915 @@
 #include "tracer.h"
+#include "tracer_compress.h"
+#include "tracer_export.h"
+#include "tracer_live.h"
+#include "tracer_mapped.h"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <new>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <link.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+// ============================================================================
+// String interning
+// ============================================================================
+
+// IDs are never recycled — call sites cache them in statics across sessions
+class ChromeTracer::StringTable
+{
+public:
+	// Direct-mapped per-thread cache in front of the shared table
+	struct Cache
+	{
+		static constexpr size_t kSize = 256;
+
+		struct Entry
+		{
+			size_t hash = 0;
+			std::string_view str;                // points into the table's storage
+			TraceStringId id = 0;
+		};
+
+		Entry entries[kSize];
+	};
+
+	// added is set when str was not in the table yet
+	TraceStringId intern(std::string_view str, Cache& cache, bool* added = nullptr)
+	{
+		const size_t hash = std::hash<std::string_view>{}(str);
+		Cache::Entry& entry = cache.entries[hash % Cache::kSize];
+		if (entry.hash == hash && entry.str.data() && entry.str == str)
+			return entry.id;
+
+		const ChromeTracer::Ticks before = ChromeTracer::now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_lockWaitTicks += ChromeTracer::now() - before;
+		auto it = m_ids.find(str);
+		if (it == m_ids.end())
+		{
+			const std::string& stored = m_strings.emplace_back(str);
+			const auto id = static_cast<TraceStringId>(m_views.size());
+			m_views.push_back(stored);
+			it = m_ids.emplace(std::string_view(stored), id).first;
+			if (added)
+				*added = true;
+			if (m_observer)
+				m_observer(id, stored);
+		}
+
+		entry.hash = hash;
+		entry.str = it->first;
+		entry.id = it->second;
+		return entry.id;
+	}
+
+	// Copy of the ID → string mapping for export
+	std::vector<std::string_view> snapshot() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_views;
+	}
+
+	// Time intern() spent acquiring the lock, which it only takes on a
+	// cache miss
+	ChromeTracer::Ticks lockWaitTicks() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_lockWaitTicks;
+	}
+
+	// observer is called under the table's lock for each string already in
+	// the table and then for every one added, until replaced
+	using Observer = std::function<void(TraceStringId, std::string_view)>;
+	void observe(Observer observer)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_observer = std::move(observer);
+		if (!m_observer)
+			return;
+		for (size_t id = 0; id < m_views.size(); ++id)
+			m_observer(static_cast<TraceStringId>(id), m_views[id]);
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::deque<std::string> m_strings;           // stable addresses for the views below
+	std::vector<std::string_view> m_views;       // indexed by ID
+	std::unordered_map<std::string_view, TraceStringId> m_ids;
+	Observer m_observer;
+	ChromeTracer::Ticks m_lockWaitTicks = 0;
+};
+
+// ============================================================================
+// Per-thread event storage
+// ============================================================================
+
+struct ChromeTracer::EventChunk
+{
+	static constexpr size_t kCapacity = 1024;
+	static constexpr size_t kArgCapacity = 512;  // bump arena; a full one ends the chunk early
+
+	TraceEvent events[kCapacity];
+	TraceArg args[kArgCapacity];
+	std::atomic<size_t> count{ 0 };              // published with release by the owner
+	std::atomic<size_t> argCount{ 0 };           // written before count, read after it
+	std::atomic<uint64_t> sequence{ 0 };         // bumped whenever a ring chunk is reused
+	std::atomic<EventChunk*> next{ nullptr };
+};
+
+// ============================================================================
+// Perf counters
+// ============================================================================
+
+namespace
+{
+#if defined(__linux__)
+	perf_event_attr perfAttributes(TracePerfCounter counter)
+	{
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.exclude_kernel = 1;                 // allowed at perf_event_paranoid 2
+		attr.exclude_hv = 1;
+		switch (counter)
+		{
+		case TracePerfCounter::Cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+		case TracePerfCounter::Instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+		case TracePerfCounter::CacheMisses: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+		case TracePerfCounter::BranchMisses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+		case TracePerfCounter::PageFaults:
+			attr.type = PERF_TYPE_SOFTWARE;
+			attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+			break;
+		case TracePerfCounter::ContextSwitches:
+			attr.type = PERF_TYPE_SOFTWARE;
+			attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+			attr.exclude_kernel = 0;             // switches happen in the kernel; may need CAP_PERFMON
+			break;
+		}
+		return attr;
+	}
+#endif
+
+	std::string_view perfCounterKey(TracePerfCounter counter)
+	{
+		switch (counter)
+		{
+		case TracePerfCounter::Cycles: return "cycles";
+		case TracePerfCounter::Instructions: return "instructions";
+		case TracePerfCounter::CacheMisses: return "llc_misses";
+		case TracePerfCounter::BranchMisses: return "branch_misses";
+		case TracePerfCounter::PageFaults: return "page_faults";
+		case TracePerfCounter::ContextSwitches: return "context_switches";
+		}
+		return "perf_counter";
+	}
+}
+
+// One thread's counters for one session. Each counts the owner thread only,
+// in user space; owner thread only.
+struct ChromeTracer::PerfCounters
+{
+	uint64_t session = 0;                        // session the counters were opened for
+	size_t count = 0;                            // opened, at the front of the arrays
+	TraceStringId keys[kMaxPerfCounters] = {};
+	int fds[kMaxPerfCounters] = {};
+	void* pages[kMaxPerfCounters] = {};          // perf_event_mmap_page, for rdpmc
+
+	PerfCounters() = default;
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	~PerfCounters()
+	{
+		close();
+	}
+
+	void open(uint64_t newSession, std::span<const TracePerfCounter> counters, const TraceStringId* counterKeys)
+	{
+		close();
+		session = newSession;
+#if defined(__linux__)
+		for (size_t i = 0; i < counters.size() && count < kMaxPerfCounters; ++i)
+		{
+			perf_event_attr attr = perfAttributes(counters[i]);
+			const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+			if (fd < 0)
+				continue;
+			fds[count] = fd;
+			keys[count] = counterKeys[i];
+			pages[count] = nullptr;
+#if defined(__x86_64__) || defined(__i386__)
+			void* page = mmap(nullptr, static_cast<size_t>(sysconf(_SC_PAGESIZE)), PROT_READ, MAP_SHARED, fd, 0);
+			if (page != MAP_FAILED)
+				pages[count] = page;
+#endif
+			++count;
+		}
+#else
+		(void)counters;
+		(void)counterKeys;
+#endif
+	}
+
+	void close()
+	{
+#if defined(__linux__)
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (pages[i])
+				munmap(pages[i], static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+			::close(fds[i]);
+		}
+#endif
+		count = 0;
+	}
+
+	size_t read(uint64_t* values) const
+	{
+		for (size_t i = 0; i < count; ++i)
+			values[i] = readOne(i);
+		return count;
+	}
+
+	// rdpmc as described in perf_event_open(2): retry while the kernel
+	// updates the page, and fall back to read(2) while the counter is not
+	// on the PMU or user-space reads are disabled
+	uint64_t readOne(size_t i) const
+	{
+#if defined(__linux__)
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+		if (const auto* page = static_cast<const volatile perf_event_mmap_page*>(pages[i]))
+		{
+			for (;;)
+			{
+				const uint32_t lock = page->lock;
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+				const uint32_t index = page->index;
+				if (!page->cap_user_rdpmc || index == 0)
+					break;
+				uint32_t low, high;
+				asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+				const unsigned shift = 64 - page->pmc_width;
+				const int64_t pmc = static_cast<int64_t>((uint64_t(high) << 32 | low) << shift) >> shift;
+				const int64_t value = page->offset + pmc;
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+				if (page->lock == lock)
+					return static_cast<uint64_t>(value);
+			}
+		}
+#endif
+		uint64_t value = 0;
+		if (::read(fds[i], &value, sizeof(value)) != sizeof(value))
+			return 0;
+		return value;
+#else
+		(void)i;
+		return 0;
+#endif
+	}
+};
+
+// ============================================================================
+// Mapped mode
+// ============================================================================
+
+namespace
+{
+	constexpr size_t kMappedThreads = 1024;
+	constexpr size_t kMappedMinStrings = 64 * 1024;
+	constexpr size_t kMappedAlign = 64;              // keeps chunks of different threads off shared lines
+	constexpr size_t kMappedPage = 4096;
+
+	constexpr size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void copyTruncated(char (&target)[128], std::string_view source)
+	{
+		const size_t length = std::min(source.size(), sizeof(target) - 1);
+		std::memcpy(target, source.data(), length);
+		target[length] = '\0';
+	}
+}
+
+// File of a mapped session (see tracer_mapped.h). The descriptor is closed
+// once mapped; the view lives until this is destroyed.
+struct ChromeTracer::MappedFile
+{
+	std::byte* base = nullptr;
+	size_t bytes = 0;
+	TraceMappedHeader* header = nullptr;
+	std::mutex stringsMutex;                     // names and categories are interned under different locks
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		if (!base)
+			return;
+#if defined(_WIN32)
+		UnmapViewOfFile(base);
+#else
+		munmap(base, bytes);
+#endif
+	}
+
+	// Creates filepath at size bytes and writes the header; false if the
+	// file cannot be mapped or is too small for a single chunk
+	bool open(const std::string& filepath, size_t size, const TraceSessionInfo& info)
+	{
+		const size_t chunkBytes = alignUp(sizeof(EventChunk), kMappedAlign);
+		const size_t threadsOffset = alignUp(sizeof(TraceMappedHeader), kMappedAlign);
+		const size_t stringsOffset = alignUp(threadsOffset + kMappedThreads * sizeof(TraceMappedThread), kMappedAlign);
+		const size_t stringsBytes = alignUp(std::max(size / 16, kMappedMinStrings), kMappedAlign);
+		const size_t chunksOffset = alignUp(stringsOffset + stringsBytes, kMappedPage);
+		if (size < chunksOffset + chunkBytes)
+			return false;
+
+#if defined(_WIN32)
+		const HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+			nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		const DWORD high = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+		const DWORD low = static_cast<DWORD>(size & 0xffffffffu);
+		const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, high, low, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			return false;
+		void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+		CloseHandle(mapping);
+		if (!view)
+			return false;
+#else
+		const int fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return false;
+		if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+		void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED)
+			return false;
+#endif
+
+		// A fresh file reads as zeros, which is what every counter starts at
+		base = static_cast<std::byte*>(view);
+		bytes = size;
+		header = new (base) TraceMappedHeader{};
+		initHeader(*header, info);
+		header->threadsOffset = threadsOffset;
+		header->threadCapacity = kMappedThreads;
+		header->stringsOffset = stringsOffset;
+		header->stringsBytes = stringsBytes;
+		header->chunksOffset = chunksOffset;
+		header->chunkCapacity = (size - chunksOffset) / chunkBytes;
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(header->magic, TraceMappedHeader::kMagic, sizeof(header->magic));
+		return true;
+	}
+
+	// Everything but the magic, the offsets and the counters
+	static void initHeader(TraceMappedHeader& header, const TraceSessionInfo& info)
+	{
+		header.version = TraceMappedHeader::kVersion;
+		header.state = TraceMappedHeader::Recording;
+		header.startTicks = info.startTicks;
+		header.nsPerTick = info.nsPerTick;
+		header.clockAnchorNs = info.clockAnchorNs;
+		header.pid = info.pid;
+		copyTruncated(header.processName, info.processName);
+		copyTruncated(header.hostName, info.hostName);
+		header.eventBytes = sizeof(TraceEvent);
+		header.argBytes = sizeof(TraceArg);
+		header.chunkBytes = static_cast<uint32_t>(alignUp(sizeof(EventChunk), kMappedAlign));
+		header.chunkEvents = static_cast<uint32_t>(EventChunk::kCapacity);
+		header.chunkArgs = static_cast<uint32_t>(EventChunk::kArgCapacity);
+		header.eventsOffset = static_cast<uint32_t>(offsetof(EventChunk, events));
+		header.argsOffset = static_cast<uint32_t>(offsetof(EventChunk, args));
+		header.countOffset = static_cast<uint32_t>(offsetof(EventChunk, count));
+		header.argCountOffset = static_cast<uint32_t>(offsetof(EventChunk, argCount));
+		header.countBytes = static_cast<uint32_t>(sizeof(size_t));
+	}
+
+	// Any recording thread; nullptr once the file is full
+	EventChunk* allocateChunk()
+	{
+		const uint64_t index = std::atomic_ref<uint64_t>(header->chunksUsed).fetch_add(1, std::memory_order_relaxed);
+		if (index >= header->chunkCapacity)
+			return nullptr;
+		return new (base + header->chunksOffset + index * header->chunkBytes) EventChunk;
+	}
+
+	// Strings that no longer fit are left out; the reader shows their IDs
+	void addString(TraceMappedString::Table table, TraceStringId id, std::string_view str)
+	{
+		std::lock_guard<std::mutex> lock(stringsMutex);
+		std::atomic_ref<uint64_t> used(header->stringsUsed);
+		const uint64_t offset = used.load(std::memory_order_relaxed);
+		const size_t recordBytes = alignUp(sizeof(TraceMappedString) + str.size(), 4);
+		if (offset + recordBytes > header->stringsBytes)
+			return;
+
+		std::byte* record = base + header->stringsOffset + offset;
+		const TraceMappedString entry{ table, id, static_cast<uint32_t>(str.size()) };
+		std::memcpy(record, &entry, sizeof(entry));
+		std::memcpy(record + sizeof(entry), str.data(), str.size());
+		used.store(offset + recordBytes, std::memory_order_release);
+	}
+
+	// name is kTraceNoName and sortIndex INT64_MIN when unset
+	void setThread(uint32_t index, TraceStringId name, int64_t sortIndex)
+	{
+		if (index >= header->threadCapacity)
+			return;
+		auto* threads = reinterpret_cast<TraceMappedThread*>(base + header->threadsOffset);
+		TraceMappedThread& thread = threads[index];
+		std::atomic_ref<uint32_t>(thread.name).store(name, std::memory_order_relaxed);
+		std::atomic_ref<int64_t>(thread.sortIndex).store(sortIndex, std::memory_order_relaxed);
+		const uint32_t flags = (name != kTraceNoName ? TraceMappedThread::kNamed : 0)
+			| (sortIndex != INT64_MIN ? TraceMappedThread::kSorted : 0);
+		std::atomic_ref<uint32_t>(thread.flags).store(flags, std::memory_order_release);
+	}
+
+	// endSession(): nothing left to write but the refined tick rate
+	void close(const TraceSessionInfo& info)
+	{
+		header->nsPerTick = info.nsPerTick;
+		std::atomic_ref<uint32_t>(header->state).store(TraceMappedHeader::Closed, std::memory_order_release);
+	}
+};
+
+// Aggregation mode: statistics of one name on one thread. Only the owner
+// writes (relaxed load + store, no read-modify-write); profile() reads the
+// atomics concurrently.
+struct ChromeTracer::ScopeStats
+{
+	// Log-linear histogram of durations in ticks: 2^kSubBits buckets per
+	// power of two, values below 2^kSubBits exact
+	static constexpr unsigned kSubBits = 3;
+	static constexpr size_t kSubBuckets = size_t(1) << kSubBits;
+	static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+	TraceStringId name;
+	TraceCategoryId category;
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> total{ 0 };
+	std::atomic<uint64_t> min{ UINT64_MAX };
+	std::atomic<uint64_t> max{ 0 };
+	std::atomic<uint64_t> buckets[kBuckets] = {};
+
+	ScopeStats(TraceStringId name, TraceCategoryId category)
+		: name(name), category(category)
+	{
+	}
+
+	static size_t bucketIndex(uint64_t ticks)
+	{
+		if (ticks < kSubBuckets)
+			return static_cast<size_t>(ticks);
+		const unsigned shift = static_cast<unsigned>(std::bit_width(ticks)) - 1 - kSubBits;
+		return (shift + 1) * kSubBuckets + static_cast<size_t>((ticks >> shift) & (kSubBuckets - 1));
+	}
+
+	// Midpoint of a bucket, in ticks
+	static double bucketValue(size_t index)
+	{
+		if (index < kSubBuckets)
+			return static_cast<double>(index);
+		const unsigned shift = static_cast<unsigned>(index / kSubBuckets) - 1;
+		const double low = static_cast<double>((kSubBuckets + index % kSubBuckets) << shift);
+		return low + static_cast<double>(uint64_t(1) << shift) / 2.0;
+	}
+
+	void add(uint64_t ticks)
+	{
+		constexpr auto relaxed = std::memory_order_relaxed;
+		count.store(count.load(relaxed) + 1, relaxed);
+		total.store(total.load(relaxed) + ticks, relaxed);
+		if (ticks < min.load(relaxed))
+			min.store(ticks, relaxed);
+		if (ticks > max.load(relaxed))
+			max.store(ticks, relaxed);
+		std::atomic<uint64_t>& bucket = buckets[bucketIndex(ticks)];
+		bucket.store(bucket.load(relaxed) + 1, relaxed);
+	}
+};
+
+struct ChromeTracer::ThreadBuffer
+{
+	std::atomic<EventChunk*> head{ nullptr };
+	std::atomic<EventChunk*> ringOldest{ nullptr };  // ring mode: the chunk after the one being written
+	EventChunk* tail = nullptr;                  // owner thread only
+	uint64_t chunkSequence = 0;                  // owner thread only
+	std::atomic<uint64_t> session{ 0 };          // session the chunks belong to
+
+	// Streaming mode: the writer thread unlinks full chunks from head and hands
+	// them back through recycled; the owner reuses them before allocating
+	size_t chunkLimit = 0;                       // owner thread only, 0 = unbounded
+	size_t chunkCount = 0;                       // owner thread only
+	EventChunk* spare = nullptr;                 // owner thread only
+	MappedFile* mapped = nullptr;                // owner thread only: mapped mode, chunks come from the file
+	std::atomic<EventChunk*> recycled{ nullptr };
+	std::atomic<uint64_t> dropped{ 0 };          // events lost to a full stream buffer or mapped file
+	std::atomic<bool> exited{ false };
+	uint32_t index = 0;                          // registration order, never reused
+	std::atomic<TraceStringId> threadName{ kTraceNoName };   // see setThreadName()
+	std::atomic<int64_t> sortIndex{ kNoSortIndex };
+	uint64_t asyncIds = 0;                       // owner thread only, see newAsyncId()
+	std::unique_ptr<PerfCounters> perf;          // owner thread only, see readPerfCounters()
+	StringTable::Cache nameCache;
+	StringTable::Cache categoryCache;
+
+	// Aggregation mode: the owner only locks statsMutex to add or clear
+	// entries; their addresses are stable, so updates need no lock
+	std::mutex statsMutex;
+	std::deque<ScopeStats> stats;
+	std::vector<ScopeStats*> statsByName;        // owner thread only, indexed by name ID
+
+	// Overhead subtraction (TraceOptions::subtractOverhead): events not yet
+	// enclosed by a complete event, innermost last, each with the recording
+	// cost of the events it stands for. Owner thread only.
+	struct Enclosed
+	{
+		ChromeTracer::Ticks start;
+		double ticks;
+	};
+	std::vector<Enclosed> enclosed;
+
+	// Rotation hand-off (see rotateSession): the owner moves the chunks and
+	// statistics of a rotated-out session here when it leaves it, and the
+	// export thread frees them. Guarded by retireMutex, which neither side
+	// takes on the record path.
+	std::mutex retireMutex;
+	uint64_t retiredSession = 0;                 // session the retired data belongs to
+	EventChunk* retiredChunks = nullptr;
+	std::deque<ScopeStats> retiredStats;
+	uint64_t exportedSession = 0;                // read in place; the owner frees its own chunks
+
+	static constexpr int64_t kNoSortIndex = INT64_MIN;
+
+	~ThreadBuffer()
+	{
+		freeAll();
+		freeChunks(retiredChunks);
+	}
+
+	// Export view; names set after the snapshot show up in the next batch
+	TraceThreadInfo info(std::span<const std::string_view> names) const
+	{
+		TraceThreadInfo result{ index, {}, std::nullopt };
+		const TraceStringId id = threadName.load(std::memory_order_relaxed);
+		if (id < names.size())
+			result.name = names[id];
+		const int64_t sort = sortIndex.load(std::memory_order_relaxed);
+		if (sort != kNoSortIndex)
+			result.sortIndex = static_cast<int32_t>(sort);
+		return result;
+	}
+
+	// Owner only — no reader touches a buffer whose session is stale.
+	// A non-zero ringChunks preallocates a closed ring that append() wraps
+	// around, overwriting the oldest chunk; a non-zero streamChunks caps the
+	// chunks in flight to the stream writer; a mappedFile supplies the chunks.
+	void reset(uint64_t newSession, size_t ringChunks, size_t streamChunks, MappedFile* mappedFile)
+	{
+		freeAll();
+		mapped = mappedFile;
+		tail = nullptr;
+		chunkLimit = streamChunks;
+		chunkCount = 0;
+		dropped.store(0, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			stats.clear();
+		}
+		statsByName.clear();
+		enclosed.clear();
+
+		if (ringChunks > 0)
+		{
+			EventChunk* first = new EventChunk;
+			EventChunk* last = first;
+			for (size_t i = 1; i < ringChunks; ++i)
+			{
+				EventChunk* chunk = new EventChunk;
+				last->next.store(chunk, std::memory_order_relaxed);
+				last = chunk;
+			}
+			last->next.store(first, std::memory_order_relaxed);
+
+			startChunk(first);
+			head.store(first, std::memory_order_release);
+			ringOldest.store(first->next.load(std::memory_order_relaxed), std::memory_order_release);
+			tail = first;
+		}
+
+		session.store(newSession, std::memory_order_release);
+	}
+
+	// Owner, leaving a rotated-out session: hand its data to the export
+	// thread, unless that already read it in place. reset() follows.
+	void retire(uint64_t oldSession)
+	{
+		std::lock_guard<std::mutex> lock(retireMutex);
+		if (exportedSession == oldSession)
+			return;
+		EventChunk* const oldest = ringOldest.exchange(nullptr, std::memory_order_relaxed);
+		EventChunk* const chunks = head.exchange(nullptr, std::memory_order_relaxed);
+		retiredChunks = oldest ? oldest : chunks;
+		{
+			std::lock_guard<std::mutex> statsLock(statsMutex);
+			retiredStats = std::move(stats);
+			stats.clear();
+		}
+		retiredSession = oldSession;
+	}
+
+	// Returns true when the event completed a chunk
+	bool append(const TraceEvent& ev, std::span<const TraceArg> args)
+	{
+		const size_t argCount = std::min<size_t>(args.size(), UINT8_MAX);
+		if (!tail)
+		{
+			tail = takeChunk();
+			if (!tail)
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			startChunk(tail);
+			head.store(tail, std::memory_order_release);
+		}
+		else if (tail->count.load(std::memory_order_relaxed) == EventChunk::kCapacity
+			|| tail->argCount.load(std::memory_order_relaxed) + argCount > EventChunk::kArgCapacity)
+		{
+			EventChunk* next = tail->next.load(std::memory_order_relaxed);
+			if (next)
+			{
+				startChunk(next);                // ring mode: overwrite the oldest chunk
+				ringOldest.store(next->next.load(std::memory_order_relaxed), std::memory_order_release);
+			}
+			else
+			{
+				next = takeChunk();
+				if (!next)
+				{
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				startChunk(next);
+				tail->next.store(next, std::memory_order_release);
+			}
+			tail = next;
+		}
+
+		const size_t slotIndex = tail->count.load(std::memory_order_relaxed);
+		TraceEvent& slot = tail->events[slotIndex];
+		slot = ev;
+		slot.thread = index;
+		if (argCount > 0)
+		{
+			const size_t argIndex = tail->argCount.load(std::memory_order_relaxed);
+			std::memcpy(tail->args + argIndex, args.data(), argCount * sizeof(TraceArg));
+			slot.argCount = static_cast<uint8_t>(argCount);
+			slot.argIndex = static_cast<uint32_t>(argIndex);
+			tail->argCount.store(argIndex + argCount, std::memory_order_relaxed);
+		}
+		tail->count.store(slotIndex + 1, std::memory_order_release);
+		return slotIndex + 1 == EventChunk::kCapacity;
+	}
+
+	// Takes the cost of the events recorded since a complete event started
+	// out of its duration; eventTicks is the cost of recording ev itself.
+	// Events arrive in the order they finish, so those inside it are the
+	// enclosed ones starting at or after it.
+	void subtractOverhead(TraceEvent& ev, double eventTicks)
+	{
+		static constexpr size_t kMaxEnclosed = 4096;     // the oldest half goes when full
+		double nested = 0.0;
+		if (ev.phase == 'X')
+		{
+			while (!enclosed.empty() && enclosed.back().start >= ev.timestamp)
+			{
+				nested += enclosed.back().ticks;
+				enclosed.pop_back();
+			}
+			const auto overhead = static_cast<uint64_t>(nested);
+			ev.duration = ev.duration > overhead ? ev.duration - overhead : 0;
+		}
+		if (enclosed.size() == kMaxEnclosed)
+			enclosed.erase(enclosed.begin(), enclosed.begin() + kMaxEnclosed / 2);
+		enclosed.push_back({ ev.timestamp, nested + eventTicks });
+	}
+
+	void aggregate(TraceStringId name, TraceCategoryId category, uint64_t ticks)
+	{
+		if (name >= statsByName.size())
+			statsByName.resize(name + 1, nullptr);
+		ScopeStats*& entry = statsByName[name];
+		if (!entry)
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			entry = &stats.emplace_back(name, category);
+		}
+		entry->add(ticks);
+	}
+
+	EventChunk* newChunk()
+	{
+		if (mapped)
+			return mapped->allocateChunk();
+		++chunkCount;
+		return new EventChunk;
+	}
+
+	// Owner side of the stream hand-off: reuse a written chunk if there is one
+	EventChunk* takeChunk()
+	{
+		if (!spare)
+			spare = recycled.exchange(nullptr, std::memory_order_acquire);
+		if (spare)
+		{
+			EventChunk* chunk = spare;
+			spare = chunk->next.load(std::memory_order_relaxed);
+			chunk->next.store(nullptr, std::memory_order_relaxed);
+			return chunk;
+		}
+		if (chunkLimit > 0 && chunkCount >= chunkLimit)
+			return nullptr;
+		return newChunk();
+	}
+
+	// Writer side: a chunk is complete once the owner has linked a successor,
+	// and the writer may rewrite it until handing it back. At most maxChunks
+	// per call, so an owner refilling the recycled chunks cannot keep one
+	// pass going.
+	template <typename Fn>
+	void drainFullChunks(size_t maxChunks, Fn&& fn)
+	{
+		EventChunk* chunk = head.load(std::memory_order_acquire);
+		for (size_t drained = 0; chunk && drained < maxChunks; ++drained)
+		{
+			EventChunk* next = chunk->next.load(std::memory_order_acquire);
+			if (!next)
+				break;
+
+			const size_t count = chunk->count.load(std::memory_order_acquire);
+			fn(chunk->events, count, std::span<const TraceArg>(chunk->args, chunk->argCount.load(std::memory_order_relaxed)));
+			head.store(next, std::memory_order_release);
+
+			EventChunk* top = recycled.load(std::memory_order_relaxed);
+			do
+			{
+				chunk->next.store(top, std::memory_order_relaxed);
+			} while (!recycled.compare_exchange_weak(top, chunk,
+				std::memory_order_release, std::memory_order_relaxed));
+
+			chunk = next;
+		}
+	}
+
+	// Seqlock-style write side: readers that copied a chunk while it was being
+	// reused see a changed sequence afterwards and discard their copy
+	void startChunk(EventChunk* chunk)
+	{
+		chunk->sequence.store(++chunkSequence, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		chunk->count.store(0, std::memory_order_relaxed);
+		chunk->argCount.store(0, std::memory_order_relaxed);
+	}
+
+	// Copies a consistent view of a chunk into events/args; returns the event
+	// count and sets argCount
+	static size_t readChunk(const EventChunk* chunk, TraceEvent* events, TraceArg* args, size_t& argCount)
+	{
+		const uint64_t sequence = chunk->sequence.load(std::memory_order_acquire);
+		const size_t count = chunk->count.load(std::memory_order_acquire);
+		argCount = std::min(chunk->argCount.load(std::memory_order_relaxed), EventChunk::kArgCapacity);
+		std::memcpy(events, chunk->events, count * sizeof(TraceEvent));
+		std::memcpy(args, chunk->args, argCount * sizeof(TraceArg));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence == 0 || chunk->sequence.load(std::memory_order_relaxed) != sequence)
+			return 0;
+		return count;
+	}
+
+	// Where readers start: the head of the chain, or the oldest chunk of the
+	// ring, so events come out in the order they were written
+	const EventChunk* firstChunk() const
+	{
+		const EventChunk* oldest = ringOldest.load(std::memory_order_acquire);
+		return oldest ? oldest : head.load(std::memory_order_acquire);
+	}
+
+	// Calls fn(events, count, args) for a consistent copy of each chunk of the
+	// chain or ring starting at first
+	template <typename Fn>
+	static void readChain(const EventChunk* first, TraceEvent* events, TraceArg* args, Fn&& fn)
+	{
+		for (const EventChunk* chunk = first; chunk; )
+		{
+			size_t argCount = 0;
+			const size_t count = readChunk(chunk, events, args, argCount);
+			if (count > 0)
+				fn(events, count, std::span<const TraceArg>(args, argCount));
+
+			chunk = chunk->next.load(std::memory_order_acquire);
+			if (chunk == first)
+				break;
+		}
+	}
+
+	void freeAll()
+	{
+		// Mapped chunks belong to their file, which may be unmapped by now
+		EventChunk* chain = head.exchange(nullptr, std::memory_order_relaxed);
+		ringOldest.store(nullptr, std::memory_order_relaxed);
+		if (!mapped)
+			freeChunks(chain);
+		freeChunks(spare);
+		freeChunks(recycled.exchange(nullptr, std::memory_order_relaxed));
+		spare = nullptr;
+	}
+
+	// Handles both open chains and closed rings
+	static void freeChunks(EventChunk* first)
+	{
+		EventChunk* chunk = first;
+		while (chunk)
+		{
+			EventChunk* next = chunk->next.load(std::memory_order_relaxed);
+			delete chunk;
+			chunk = next != first ? next : nullptr;
+		}
+	}
+};
+
+// Aggregation mode: same name on different threads → one row
+struct ChromeTracer::ProfileMerge
+{
+	struct Row
+	{
+		TraceCategoryId category = 0;
+		uint64_t count = 0;
+		uint64_t total = 0;
+		uint64_t min = UINT64_MAX;
+		uint64_t max = 0;
+		std::vector<uint64_t> buckets;
+	};
+
+	std::unordered_map<TraceStringId, Row> rows;
+
+	void add(const ScopeStats& stats)
+	{
+		constexpr auto relaxed = std::memory_order_relaxed;
+		Row& row = rows[stats.name];
+		if (row.buckets.empty())
+		{
+			row.category = stats.category;
+			row.buckets.resize(ScopeStats::kBuckets);
+		}
+		row.count += stats.count.load(relaxed);
+		row.total += stats.total.load(relaxed);
+		row.min = std::min(row.min, stats.min.load(relaxed));
+		row.max = std::max(row.max, stats.max.load(relaxed));
+		for (size_t i = 0; i < ScopeStats::kBuckets; ++i)
+			row.buckets[i] += stats.buckets[i].load(relaxed);
+	}
+
+	// Most total time first
+	std::vector<TraceScopeStats> result(std::span<const std::string_view> names,
+		std::span<const std::string_view> categories,
+		double nsPerTick) const
+	{
+		std::vector<TraceScopeStats> result;
+		result.reserve(rows.size());
+		for (const auto& [name, row] : rows)
+		{
+			if (row.count == 0)
+				continue;
+
+			// The percentile counts may trail count slightly while threads record
+			const auto percentile = [&](double q) {
+				uint64_t histogramCount = 0;
+				for (const uint64_t n : row.buckets)
+					histogramCount += n;
+				const auto rank = static_cast<uint64_t>(q * static_cast<double>(histogramCount));
+				uint64_t seen = 0;
+				for (size_t i = 0; i < ScopeStats::kBuckets; ++i)
+				{
+					seen += row.buckets[i];
+					if (seen > rank)
+					{
+						const double value = ScopeStats::bucketValue(i);
+						return std::clamp(value, static_cast<double>(row.min), static_cast<double>(row.max)) * nsPerTick;
+					}
+				}
+				return static_cast<double>(row.max) * nsPerTick;
+			};
+
+			TraceScopeStats& stats = result.emplace_back();
+			stats.name = names[name];
+			stats.category = categories[row.category];
+			stats.count = row.count;
+			stats.totalNs = static_cast<double>(row.total) * nsPerTick;
+			stats.minNs = static_cast<double>(row.min) * nsPerTick;
+			stats.maxNs = static_cast<double>(row.max) * nsPerTick;
+			stats.p50Ns = percentile(0.50);
+			stats.p90Ns = percentile(0.90);
+			stats.p99Ns = percentile(0.99);
+		}
+
+		std::sort(result.begin(), result.end(), [](const TraceScopeStats& a, const TraceScopeStats& b) {
+			return a.totalNs > b.totalNs;
+		});
+		return result;
+	}
+};
+
+thread_local ChromeTracer::ThreadSlot ChromeTracer::s_threadSlot;
+std::atomic<bool> ChromeTracer::s_instrumenting{ false };
+std::atomic<bool> ChromeTracer::s_countingPerf{ false };
+
+ChromeTracer::ThreadSlot::~ThreadSlot()
+{
+	if (!buffer)
+		return;
+	buffer->perf.reset();
+	buffer->exited.store(true, std::memory_order_release);
+}
+
+namespace
+{
+	constexpr auto kStreamInterval = std::chrono::milliseconds(20);
+
+	// Sessions at least this long derive the tick rate from their own span,
+	// which is far more precise than the short calibration at start
+	constexpr auto kRecalibrateAfter = std::chrono::seconds(1);
+
+	// Nanoseconds per ChromeTracer::now() tick
+	double calibrateNsPerTick()
+	{
+#if defined(TRACER_CLOCK_TSC) && defined(__aarch64__)
+		uint64_t frequency;
+		asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+		return 1e9 / static_cast<double>(frequency);
+#elif defined(TRACER_CLOCK_TSC)
+		using steady = std::chrono::steady_clock;
+		const auto startTime = steady::now();
+		const ChromeTracer::Ticks startTicks = ChromeTracer::now();
+		auto endTime = startTime;
+		while (endTime - startTime < std::chrono::milliseconds(2))
+			endTime = steady::now();
+		const ChromeTracer::Ticks endTicks = ChromeTracer::now();
+		const double ns = std::chrono::duration<double, std::nano>(endTime - startTime).count();
+		return ns / static_cast<double>(endTicks - startTicks);
+#else
+		using period = ChromeTracer::clock::period;
+		return 1e9 * period::num / period::den;
+#endif
+	}
+
+	// TRACER_CATEGORIES=physics,io → { "physics", "io" }; empty when unset
+	std::vector<std::string> categoriesFromEnvironment()
+	{
+		std::vector<std::string> categories;
+		const char* value = std::getenv("TRACER_CATEGORIES");
+		if (!value)
+			return categories;
+
+		std::string_view rest = value;
+		while (!rest.empty())
+		{
+			const size_t comma = rest.find(',');
+			std::string_view item = rest.substr(0, comma);
+			rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+			while (!item.empty() && item.front() == ' ')
+				item.remove_prefix(1);
+			while (!item.empty() && item.back() == ' ')
+				item.remove_suffix(1);
+			if (!item.empty())
+				categories.emplace_back(item);
+		}
+		return categories;
+	}
+
+	uint32_t currentProcessId()
+	{
+#if defined(_WIN32)
+		return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	// File name of the running executable, without directory or extension
+	std::string executableName()
+	{
+		std::string path;
+#if defined(_WIN32)
+		char buffer[MAX_PATH];
+		const DWORD length = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+		path.assign(buffer, length);
+#elif defined(__linux__)
+		char buffer[4096];
+		const ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+		if (length > 0)
+			path.assign(buffer, static_cast<size_t>(length));
+#endif
+		const size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+#if defined(_WIN32)
+		if (const size_t dot = name.rfind('.'); dot != std::string::npos)
+			name.resize(dot);
+#endif
+		if (name.empty())
+			name = "pid " + std::to_string(currentProcessId());
+		return name;
+	}
+
+	std::string hostName()
+	{
+		char buffer[256] = {};
+#if defined(_WIN32)
+		DWORD length = sizeof(buffer);
+		if (!GetComputerNameA(buffer, &length))
+			return {};
+#else
+		if (gethostname(buffer, sizeof(buffer) - 1) != 0)
+			return {};
+#endif
+		return buffer;
+	}
+
+	// Reads the tick counter between two system clock reads and keeps the
+	// tightest of a few tries, so the anchor is off by well under a microsecond
+	int64_t sampleClockAnchor(ChromeTracer::Ticks& ticks)
+	{
+		using system = std::chrono::system_clock;
+		int64_t anchorNs = 0;
+		auto best = system::duration::max();
+		for (int i = 0; i < 5; ++i)
+		{
+			const auto before = system::now();
+			const ChromeTracer::Ticks sample = ChromeTracer::now();
+			const auto after = system::now();
+			if (after - before < best)
+			{
+				best = after - before;
+				ticks = sample;
+				const auto middle = before + (after - before) / 2;
+				anchorNs = std::chrono::duration_cast<std::chrono::nanoseconds>(middle.time_since_epoch()).count();
+			}
+		}
+		return anchorNs;
+	}
+}
+
+// ============================================================================
+// Crash dump
+// ============================================================================
+
+namespace
+{
+	constexpr size_t kCrashThreads = 4096;           // buffers the handlers can see
+	constexpr size_t kCrashStringsBytes = size_t(16) << 20;  // sparse until used
+	constexpr uint64_t kCrashMaxChunks = uint64_t(1) << 16;  // bounds a chain corrupted by the crash
+
+#if defined(_WIN32)
+	constexpr int kCrashSignals[] = { SIGSEGV, SIGILL, SIGFPE, SIGABRT };
+#else
+	constexpr int kCrashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+#endif
+}
+
+// File of a session with TraceOptions::crashDumpPath, in the mapped layout
+// (see tracer_mapped.h). Strings are written as they are interned; a fatal
+// signal or std::terminate() writes the chunks, the thread table and last
+// the header. Allocated on first use and kept for the tracer's lifetime,
+// since a handler may run at any time.
+struct ChromeTracer::CrashDump
+{
+	static inline std::atomic<CrashDump*> s_armed{ nullptr };
+
+	std::mutex mutex;                            // guards the string records and the header
+	std::atomic<ThreadBuffer*> slots[kCrashThreads] = {};   // under m_buffersMutex
+	std::atomic<uint64_t> session{ 0 };          // 0 = disarmed
+	std::atomic<uint64_t> stringsUsed{ 0 };
+	std::atomic<bool> dumped{ false };
+	TraceMappedHeader header{};                  // magic and counters are set by dump()
+	TraceMappedThread threads[kMappedThreads] = {};  // dump() only
+	std::string filepath;
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+#else
+	int fd = -1;
+#endif
+
+	CrashDump() = default;
+	CrashDump(const CrashDump&) = delete;
+	CrashDump& operator=(const CrashDump&) = delete;
+
+	~CrashDump()
+	{
+		disarm();
+	}
+
+	// Under m_buffersMutex; buffers past kCrashThreads are left out
+	void add(ThreadBuffer* buffer)
+	{
+		for (std::atomic<ThreadBuffer*>& slot : slots)
+		{
+			if (!slot.load(std::memory_order_relaxed))
+			{
+				slot.store(buffer, std::memory_order_release);
+				return;
+			}
+		}
+	}
+
+	void remove(const ThreadBuffer* buffer)
+	{
+		for (std::atomic<ThreadBuffer*>& slot : slots)
+		{
+			if (slot.load(std::memory_order_relaxed) == buffer)
+				slot.store(nullptr, std::memory_order_release);
+		}
+	}
+
+	// Creates path for the session starting and installs the handlers; the
+	// string observers are registered by the caller
+	bool arm(const std::string& path, const TraceSessionInfo& info, uint64_t sessionId)
+	{
+		disarm();
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+#else
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return false;
+#endif
+		filepath = path;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			header = TraceMappedHeader{};
+			MappedFile::initHeader(header, info);
+			header.threadsOffset = alignUp(sizeof(TraceMappedHeader), kMappedAlign);
+			header.threadCapacity = kMappedThreads;
+			header.stringsOffset = alignUp(header.threadsOffset + kMappedThreads * sizeof(TraceMappedThread), kMappedAlign);
+			header.stringsBytes = kCrashStringsBytes;
+			header.chunksOffset = alignUp(header.stringsOffset + kCrashStringsBytes, kMappedPage);
+			stringsUsed.store(0, std::memory_order_relaxed);
+		}
+		std::memset(threads, 0, sizeof(threads));
+		dumped.store(false, std::memory_order_relaxed);
+		session.store(sessionId, std::memory_order_release);
+
+		static std::once_flag s_installed;
+		std::call_once(s_installed, installHandlers);
+		s_armed.store(this, std::memory_order_release);
+		return true;
+	}
+
+	// rotateSession(): the dump covers the session taking over
+	void rotate(const TraceSessionInfo& info, uint64_t sessionId)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		MappedFile::initHeader(header, info);
+		session.store(sessionId, std::memory_order_release);
+	}
+
+	// endSession(): the session ended normally, so the file goes
+	void disarm()
+	{
+		CrashDump* self = this;
+		s_armed.compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+		session.store(0, std::memory_order_release);
+#if defined(_WIN32)
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		DeleteFileA(filepath.c_str());
+#else
+		if (fd < 0)
+			return;
+		::close(fd);
+		fd = -1;
+		::unlink(filepath.c_str());
+#endif
+	}
+
+	// Strings that no longer fit are left out; the reader shows their IDs
+	void addString(TraceMappedString::Table table, TraceStringId id, std::string_view str)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const uint64_t offset = stringsUsed.load(std::memory_order_relaxed);
+		const size_t recordBytes = alignUp(sizeof(TraceMappedString) + str.size(), 4);
+		if (offset + recordBytes > header.stringsBytes)
+			return;
+
+		std::string record(recordBytes, '\0');
+		const TraceMappedString entry{ table, id, static_cast<uint32_t>(str.size()) };
+		std::memcpy(record.data(), &entry, sizeof(entry));
+		std::memcpy(record.data() + sizeof(entry), str.data(), str.size());
+		if (writeAt(header.stringsOffset + offset, record.data(), record.size()))
+			stringsUsed.store(offset + recordBytes, std::memory_order_release);
+	}
+
+	bool writeAt(uint64_t offset, const void* data, size_t size) const
+	{
+#if defined(_WIN32)
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset & 0xffffffffu);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD written = 0;
+		return WriteFile(file, data, static_cast<DWORD>(size), &written, &overlapped) && written == size;
+#else
+		const char* bytes = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			const ssize_t written = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+				return false;
+			bytes += written;
+			offset += static_cast<uint64_t>(written);
+			size -= static_cast<size_t>(written);
+		}
+		return true;
+#endif
+	}
+
+	// Async-signal-safe: lock-free loads, copies into members and writes of
+	// the raw chunks. Owners may still be appending; readers skip the events
+	// past each chunk's count, as they do in mapped mode. Runs once per session.
+	void dump()
+	{
+		const uint64_t current = session.load(std::memory_order_acquire);
+		if (current == 0 || dumped.exchange(true, std::memory_order_acq_rel))
+			return;
+
+		uint64_t chunks = 0;
+		for (std::atomic<ThreadBuffer*>& slot : slots)
+		{
+			const ThreadBuffer* buffer = slot.load(std::memory_order_acquire);
+			if (!buffer || buffer->session.load(std::memory_order_acquire) != current)
+				continue;
+
+			if (buffer->index < kMappedThreads)
+			{
+				TraceMappedThread& thread = threads[buffer->index];
+				thread.name = buffer->threadName.load(std::memory_order_relaxed);
+				thread.sortIndex = buffer->sortIndex.load(std::memory_order_relaxed);
+				thread.flags = (thread.name != kTraceNoName ? TraceMappedThread::kNamed : 0)
+					| (thread.sortIndex != ThreadBuffer::kNoSortIndex ? TraceMappedThread::kSorted : 0);
+			}
+
+			const EventChunk* first = buffer->firstChunk();
+			for (const EventChunk* chunk = first; chunk && chunks < kCrashMaxChunks; )
+			{
+				if (chunk->count.load(std::memory_order_acquire) > 0
+					&& writeAt(header.chunksOffset + chunks * header.chunkBytes, chunk, sizeof(EventChunk)))
+					++chunks;
+				chunk = chunk->next.load(std::memory_order_acquire);
+				if (chunk == first)
+					break;
+			}
+		}
+
+		// Readers take whole strides; the last chunk ends short of one
+		const uint64_t size = header.chunksOffset + chunks * header.chunkBytes;
+#if defined(_WIN32)
+		LARGE_INTEGER end;
+		end.QuadPart = static_cast<LONGLONG>(size);
+		if (SetFilePointerEx(file, end, nullptr, FILE_BEGIN))
+			SetEndOfFile(file);
+#else
+		if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+			return;
+#endif
+
+		header.stringsUsed = stringsUsed.load(std::memory_order_acquire);
+		header.chunkCapacity = chunks;
+		header.chunksUsed = chunks;
+		std::memcpy(header.magic, TraceMappedHeader::kMagic, sizeof(header.magic));
+		writeAt(header.threadsOffset, threads, sizeof(threads));
+		writeAt(0, &header, sizeof(header));
+	}
+
+	// Handlers that were installed before ours, run after the dump
+#if defined(_WIN32)
+	static inline void (*s_previous[std::size(kCrashSignals)])(int) = {};
+#else
+	static inline struct sigaction s_previous[std::size(kCrashSignals)] = {};
+#endif
+	static inline std::terminate_handler s_previousTerminate = nullptr;
+
+	static void installHandlers()
+	{
+		for (size_t i = 0; i < std::size(kCrashSignals); ++i)
+		{
+#if defined(_WIN32)
+			s_previous[i] = signal(kCrashSignals[i], onSignal);
+#else
+			struct sigaction action = {};
+			action.sa_handler = onSignal;
+			sigemptyset(&action.sa_mask);
+			sigaction(kCrashSignals[i], &action, &s_previous[i]);
+#endif
+		}
+		s_previousTerminate = std::set_terminate(onTerminate);
+	}
+
+	// Dumps, then puts the previous handler back and raises the signal
+	// again; it is delivered once this returns
+	static void onSignal(int number)
+	{
+		const int savedErrno = errno;
+		if (CrashDump* armed = s_armed.load(std::memory_order_acquire))
+			armed->dump();
+		for (size_t i = 0; i < std::size(kCrashSignals); ++i)
+		{
+			if (kCrashSignals[i] != number)
+				continue;
+#if defined(_WIN32)
+			signal(number, s_previous[i] ? s_previous[i] : SIG_DFL);
+#else
+			sigaction(number, &s_previous[i], nullptr);
+#endif
+		}
+		errno = savedErrno;
+		raise(number);
+	}
+
+	[[noreturn]] static void onTerminate()
+	{
+		if (CrashDump* armed = s_armed.load(std::memory_order_acquire))
+			armed->dump();
+		if (s_previousTerminate)
+			s_previousTerminate();
+		std::abort();
+	}
+};
+
+// ============================================================================
+// Function symbolization
+// ============================================================================
+
+namespace
+{
+	std::string hexAddress(uintptr_t value)
+	{
+		char buffer[2 + 2 * sizeof(uintptr_t)] = { '0', 'x' };
+		const auto result = std::to_chars(buffer + 2, buffer + sizeof(buffer), value, 16);
+		return std::string(buffer, result.ptr);
+	}
+
+	// Demangled name of the function starting at address, or
+	// "module+0xoffset" for one without a dynamic symbol (resolve it with
+	// addr2line or the like); "0x..." if even the module is unknown
+	std::string symbolize(uintptr_t address)
+	{
+#if defined(_WIN32)
+		HMODULE module = nullptr;
+		char path[MAX_PATH];
+		if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+				reinterpret_cast<LPCSTR>(address), &module)
+			&& GetModuleFileNameA(module, path, MAX_PATH) > 0)
+		{
+			const std::string_view file = path;
+			const size_t slash = file.find_last_of("/\\");
+			return std::string(slash == std::string_view::npos ? file : file.substr(slash + 1))
+				+ "+" + hexAddress(address - reinterpret_cast<uintptr_t>(module));
+		}
+#else
+		Dl_info info{};
+		if (dladdr(reinterpret_cast<void*>(address), &info))
+		{
+			// The nearest exported symbol below a static function is not its name
+			if (info.dli_sname && reinterpret_cast<uintptr_t>(info.dli_saddr) == address)
+			{
+#if defined(__GNUC__)
+				int status = 0;
+				char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+				if (status == 0 && demangled)
+				{
+					std::string name = demangled;
+					std::free(demangled);
+					return name;
+				}
+#endif
+				return info.dli_sname;
+			}
+			if (info.dli_fname && info.dli_fname[0])
+			{
+				const std::string_view file = info.dli_fname;
+				const size_t slash = file.rfind('/');
+				return std::string(slash == std::string_view::npos ? file : file.substr(slash + 1))
+					+ "+" + hexAddress(address - reinterpret_cast<uintptr_t>(info.dli_fbase));
+			}
+		}
+#endif
+		return hexAddress(address);
+	}
+}
+
+// Address → name ID, shared by all export threads
+struct ChromeTracer::Symbolizer
+{
+	std::mutex mutex;
+	std::unordered_map<uint64_t, TraceStringId> ids;
+	StringTable::Cache cache;                    // export threads have no buffer of their own
+};
+
+TraceAddressRange TraceAddressRange::module(const void* address)
+{
+#if defined(_WIN32)
+	HMODULE module = nullptr;
+	MODULEINFO info{};
+	if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+			static_cast<LPCSTR>(address), &module)
+		|| !GetModuleInformation(GetCurrentProcess(), module, &info, sizeof(info)))
+	{
+		return { nullptr, nullptr };
+	}
+	const auto* base = static_cast<const char*>(info.lpBaseOfDll);
+	return { base, base + info.SizeOfImage };
+#elif defined(__linux__)
+	// The executable segment holding address
+	struct Search
+	{
+		uintptr_t address;
+		TraceAddressRange range;
+	};
+	Search search{ reinterpret_cast<uintptr_t>(address), { nullptr, nullptr } };
+	dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data) {
+		Search& search = *static_cast<Search*>(data);
+		for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+		{
+			const ElfW(Phdr)& header = info->dlpi_phdr[i];
+			if (header.p_type != PT_LOAD || !(header.p_flags & PF_X))
+				continue;
+			const uintptr_t begin = info->dlpi_addr + header.p_vaddr;
+			if (search.address >= begin && search.address < begin + header.p_memsz)
+			{
+				search.range = { reinterpret_cast<const void*>(begin), reinterpret_cast<const void*>(begin + header.p_memsz) };
+				return 1;
+			}
+		}
+		return 0;
+	}, &search);
+	return search.range;
+#else
+	(void)address;
+	return { nullptr, nullptr };
+#endif
+}
+
+// ============================================================================
+// Streaming writer
+// ============================================================================
+
+// Allocated on first use and kept for the tracer's lifetime, so a recording
+// thread racing with endSession() can still notify it safely
+struct ChromeTracer::StreamState
+{
+	TraceOutputFile file;                        // unused in live mode
+	std::ostream discard{ nullptr };             // live mode: passed to the exporter instead
+	std::unique_ptr<TraceExporter> exporter;
+	bool live = false;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stop = false;
+	uint64_t session = 0;                        // the writer drains this session's buffers only
+	Ticks flushTicks = 0;                        // writer thread, read once it has stopped
+	uint64_t flushes = 0;
+};
+
+// ============================================================================
+// Session rotation
+// ============================================================================
+
+namespace
+{
+	// How long the export of a rotated-out session waits for idle threads to
+	// hand their buffers over before reading them in place
+	constexpr auto kRotateGrace = std::chrono::milliseconds(100);
+	constexpr auto kRotatePoll = std::chrono::milliseconds(1);
+}
+
+// The rotated-out session, written by its own thread
+struct ChromeTracer::RotationState
+{
+	uint64_t session = 0;
+	std::string filepath;
+	TraceSessionInfo info;
+	bool aggregate = false;
+	std::vector<ThreadBuffer*> buffers;          // snapshot taken after the switch
+	std::unique_ptr<StreamState> stream;         // streaming: the retired session's writer, file and exporter
+	TraceOutputFile file;                        // otherwise
+	TraceOverheadInfo overhead;                  // taken at the switch
+	std::thread thread;
+};
+
+// ============================================================================
+// Resource monitor
+// ============================================================================
+
+namespace
+{
+	// Resident set size; false where the platform offers no cheap query
+	bool readResidentBytes(uint64_t& bytes)
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return false;
+		bytes = counters.WorkingSetSize;
+		return true;
+#elif defined(__linux__)
+		// statm: total and resident size in pages
+		std::ifstream statm("/proc/self/statm");
+		uint64_t total = 0;
+		uint64_t resident = 0;
+		if (!(statm >> total >> resident))
+			return false;
+		bytes = resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+		return true;
+#else
+		(void)bytes;
+		return false;
+#endif
+	}
+
+	// User + system CPU time of the whole process
+	bool readProcessCpuNs(uint64_t& ns)
+	{
+#if defined(_WIN32)
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+			return false;
+		const auto toNs = [](const FILETIME& time) {
+			return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+		};
+		ns = toNs(kernel) + toNs(user);
+		return true;
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return false;
+		const auto toNs = [](const timeval& time) {
+			return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_usec) * 1000ull;
+		};
+		ns = toNs(usage.ru_utime) + toNs(usage.ru_stime);
+		return true;
+#endif
+	}
+}
+
+// Created by beginSession() and destroyed by endSession() once the thread
+// has been joined
+struct ChromeTracer::MonitorState
+{
+	std::chrono::milliseconds interval;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stop = false;
+};
+
+void ChromeTracer::monitorLoop()
+{
+	MonitorState& monitor = *m_monitor;
+	setThreadName("Tracer resource monitor");
+	const TraceStringId rssName = internName("process.rss_bytes");
+	const TraceStringId cpuName = internName("process.cpu_percent");
+	const TraceCategoryId category = internCategory("process");
+
+	uint64_t lastCpuNs = 0;
+	bool haveCpu = false;
+	auto lastTime = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(monitor.mutex);
+	while (!monitor.stop)
+	{
+		lock.unlock();
+
+		uint64_t rss = 0;
+		if (readResidentBytes(rss))
+			addCounterEvent(rssName, category, static_cast<double>(rss));
+
+		// The first sample only sets the baseline
+		uint64_t cpuNs = 0;
+		const auto time = std::chrono::steady_clock::now();
+		if (readProcessCpuNs(cpuNs))
+		{
+			const double wallNs = std::chrono::duration<double, std::nano>(time - lastTime).count();
+			if (haveCpu && wallNs > 0.0)
+				addCounterEvent(cpuName, category, 100.0 * static_cast<double>(cpuNs - lastCpuNs) / wallNs);
+			lastCpuNs = cpuNs;
+			lastTime = time;
+			haveCpu = true;
+		}
+
+		lock.lock();
+		monitor.wake.wait_for(lock, monitor.interval, [&] { return monitor.stop; });
+	}
+}
+
+void ChromeTracer::stopMonitor()
+{
+	if (!m_monitor)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_monitor->mutex);
+		m_monitor->stop = true;
+	}
+	m_monitor->wake.notify_one();
+	m_monitor->thread.join();
+	m_monitor.reset();
+}
+
+// ============================================================================
+// ChromeTracer implementation
+// ============================================================================
 
 ChromeTracer& ChromeTracer::instance()
 {
-	static ChromeTracer s_instance;
-	return s_instance;
+	static ChromeTracer s_instance;
+	return s_instance;
+}
+
+ChromeTracer::ChromeTracer()
+	: m_names(std::make_unique<StringTable>())
+	, m_categories(std::make_unique<StringTable>())
+	, m_categoryEnabled(std::make_unique<std::atomic<bool>[]>(size_t(1) << (8 * sizeof(TraceCategoryId))))
+	, m_symbolizer(std::make_unique<Symbolizer>())
+{
+	// Without going through a thread buffer: hooks may construct the
+	// tracer on any thread, before main()
+	m_instrumentCategory = static_cast<TraceCategoryId>(m_categories->intern("instrumented", m_symbolizer->cache));
+}
+
+ChromeTracer::~ChromeTracer()
+{
+	endSession();
+}
+
+std::vector<ChromeTracer::ThreadBuffer*> ChromeTracer::buffers() const
+{
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	std::vector<ThreadBuffer*> result;
+	result.reserve(m_buffers.size());
+	for (const auto& buffer : m_buffers)
+		result.push_back(buffer.get());
+	return result;
+}
+
+void ChromeTracer::beginSession(const std::string& filepath, const TraceOptions& options)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_active.load(std::memory_order_relaxed))
+		return;
+
+	eraseExitedBuffers(0);
+
+	{
+		// A thread that passed its category check just before the last
+		// session ended may still be writing to that session's file, so only
+		// the one before it is unmapped here
+		std::lock_guard<std::mutex> mappedLock(m_mappedMutex);
+		m_previousMapped = std::move(m_mapped);
+	}
+
+	m_filepath = filepath;
+	if (options.exporter)
+		m_makeExporter = options.exporter;
+	else if (options.format == TraceFormat::Perfetto)
+		m_makeExporter = makePerfettoExporter;
+	else
+		m_makeExporter = makeJsonExporter;
+	m_compression = options.compression;
+	m_aggregate = options.aggregate;
+	m_instrumentAllow = options.instrumentAllow;
+	m_instrumentDeny = options.instrumentDeny;
+	m_lockWaitBase = m_names->lockWaitTicks() + m_categories->lockWaitTicks();
+	m_perfCounterCount = m_aggregate ? 0 : std::min(options.perfCounters.size(), kMaxPerfCounters);
+	for (size_t i = 0; i < m_perfCounterCount; ++i)
+	{
+		m_perfCounters[i] = options.perfCounters[i];
+		m_perfKeys[i] = internName(perfCounterKey(m_perfCounters[i]));
+	}
+	// A ring chunk ends when its events or its arguments run out; the chunk
+	// being overwritten holds nothing yet, hence the extra one
+	m_ringChunks = 0;
+	if (options.ringBufferEvents > 0 && !m_aggregate)
+	{
+		const size_t argsPerEvent = options.ringBufferArgsPerEvent + m_perfCounterCount;
+		const size_t eventsPerChunk = argsPerEvent == 0 ? EventChunk::kCapacity
+			: std::clamp<size_t>(EventChunk::kArgCapacity / argsPerEvent, 1, EventChunk::kCapacity);
+		m_ringChunks = (options.ringBufferEvents + eventsPerChunk - 1) / eventsPerChunk + 1;
+	}
+	m_streamChunks = 0;
+	m_nsPerTick = calibrateNsPerTick();
+	m_ticksPerSecond.store(static_cast<Ticks>(1e9 / m_nsPerTick), std::memory_order_relaxed);
+	m_pid = currentProcessId();
+	m_processName = options.processName.empty() ? executableName() : options.processName;
+	m_hostName = hostName();
+	m_startTime = std::chrono::steady_clock::now();
+	m_clockAnchorNs = sampleClockAnchor(m_startTicks);
+	m_session.fetch_add(1, std::memory_order_relaxed);
+
+	// The subtraction itself is part of the cost it takes out
+	m_subtractOverhead = options.subtractOverhead;
+	calibrateRecordTicks();
+
+	// Chunks come from the file, so there is no ring and nothing to stream
+	if (options.mappedBytes > 0 && !m_aggregate && openMapped(options.mappedBytes))
+		m_ringChunks = 0;
+
+	// A ring buffer never fills, so there is nothing to stream
+	if (m_ringChunks == 0 && !m_aggregate && !m_mapped)
+	{
+		std::unique_ptr<TraceExporter> live;
+		if (!options.liveName.empty())
+			live = makeLiveExporter(options.liveName, options.liveBytes);
+		if (options.streaming || live)
+		{
+			m_streamChunks = std::max<size_t>(options.streamChunksPerThread, 2);
+			startStreaming(std::move(live));
+		}
+	}
+
+	if (!options.crashDumpPath.empty() && !m_aggregate && !m_mapped)
+		armCrashDump(options.crashDumpPath);
+
+	m_active.store(true, std::memory_order_release);
+	s_instrumenting.store(true, std::memory_order_relaxed);
+	s_countingPerf.store(m_perfCounterCount > 0, std::memory_order_relaxed);
+
+	// Call sites start recording once their category flag is set
+	setCategoryFilter(options.categories.empty() ? categoriesFromEnvironment() : options.categories);
+
+	if (options.resourceSampleInterval.count() > 0)
+	{
+		m_monitor = std::make_unique<MonitorState>();
+		m_monitor->interval = options.resourceSampleInterval;
+		m_monitor->thread = std::thread(&ChromeTracer::monitorLoop, this);
+	}
+}
+
+void ChromeTracer::endSession()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_active.load(std::memory_order_relaxed))
+		return;
+	m_active.store(false, std::memory_order_relaxed);
+	s_instrumenting.store(false, std::memory_order_relaxed);
+	s_countingPerf.store(false, std::memory_order_relaxed);
+	setCategoryFilter({});
+	stopMonitor();
+	finishRotation();
+	if (m_crash && m_crash->session.load(std::memory_order_relaxed) != 0)
+	{
+		m_names->observe({});
+		m_categories->observe({});
+		m_crash->disarm();
+	}
+
+	if (m_aggregate)
+	{
+		writeProfile(m_filepath);
+		return;
+	}
+
+	// Everything recorded is in the file already
+	if (m_mapped)
+	{
+		m_names->observe({});
+		m_categories->observe({});
+		m_mapped->close(sessionInfo());
+		return;
+	}
+
+	if (m_streamChunks == 0)
+	{
+		writeToFile(m_filepath, 0);
+		return;
+	}
+
+	stopStreaming(*m_stream);
+
+	// Only the partially filled chunks are left
+	TraceExporter& exporter = *m_stream->exporter;
+	std::vector<std::string_view> names = m_names->snapshot();
+	const std::vector<std::string_view> categories = m_categories->snapshot();
+	forEachChunk([&](const ThreadBuffer& buffer, TraceEvent* events, size_t count, std::span<const TraceArg> args) {
+		resolveFunctionNames({ events, count }, names);
+		exporter.writeEvents({ names, categories }, buffer.info(names), { events, count }, args);
+	});
+	finishExport(exporter, overheadInfo(m_stream.get(), m_session.load(std::memory_order_relaxed)));
+	m_stream->exporter.reset();
+	m_stream->file.close();
+}
+
+// Maps m_filepath for the session starting; false leaves the session
+// recording in memory, exported at endSession() as usual
+bool ChromeTracer::openMapped(size_t bytes)
+{
+	auto mapped = std::make_unique<MappedFile>();
+	if (!mapped->open(m_filepath, bytes, sessionInfo()))
+		return false;
+
+	MappedFile& file = *mapped;
+	m_names->observe([&file](TraceStringId id, std::string_view name) {
+		file.addString(TraceMappedString::Name, id, name);
+	});
+	m_categories->observe([&file](TraceStringId id, std::string_view category) {
+		file.addString(TraceMappedString::Category, id, category);
+	});
+
+	// Thread names may have been set in an earlier session
+	std::lock_guard<std::mutex> lock(m_mappedMutex);
+	m_mapped = std::move(mapped);
+	for (const ThreadBuffer* buffer : buffers())
+	{
+		m_mapped->setThread(buffer->index, buffer->threadName.load(std::memory_order_relaxed),
+			buffer->sortIndex.load(std::memory_order_relaxed));
+	}
+	return true;
+}
+
+// Creates the crash dump file for the session starting; without it, a
+// crash loses the session as before
+void ChromeTracer::armCrashDump(const std::string& filepath)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		if (!m_crash)
+		{
+			m_crash = std::make_unique<CrashDump>();
+			for (const auto& buffer : m_buffers)
+				m_crash->add(buffer.get());
+		}
+	}
+	if (!m_crash->arm(filepath, sessionInfo(), m_session.load(std::memory_order_relaxed)))
+		return;
+
+	CrashDump& crash = *m_crash;
+	m_names->observe([&crash](TraceStringId id, std::string_view name) {
+		crash.addString(TraceMappedString::Name, id, name);
+	});
+	m_categories->observe([&crash](TraceStringId id, std::string_view category) {
+		crash.addString(TraceMappedString::Category, id, category);
+	});
+}
+
+// Buffers of threads that have exited have no owner left to reset them.
+// Those still holding keepSession's events (if non-zero) stay for its export.
+void ChromeTracer::eraseExitedBuffers(uint64_t keepSession)
+{
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	std::erase_if(m_buffers, [&](const std::unique_ptr<ThreadBuffer>& buffer) {
+		const bool erase = buffer->exited.load(std::memory_order_acquire)
+			&& (keepSession == 0 || buffer->session.load(std::memory_order_relaxed) != keepSession);
+		if (erase && m_crash)
+			m_crash->remove(buffer.get());
+		return erase;
+	});
+}
+
+// Opens m_filepath, unless live is set, and starts the writer thread
+void ChromeTracer::startStreaming(std::unique_ptr<TraceExporter> live)
+{
+	if (!m_stream)
+		m_stream = std::make_unique<StreamState>();
+	m_stream->stop = false;
+	m_stream->session = m_session.load(std::memory_order_relaxed);
+	m_stream->live = live != nullptr;
+	m_stream->flushTicks = 0;
+	m_stream->flushes = 0;
+	if (live)
+	{
+		m_stream->exporter = std::move(live);
+		m_stream->exporter->begin(m_stream->discard, sessionInfo());
+	}
+	else
+	{
+		m_stream->file.open(m_filepath, m_compression);
+		m_stream->exporter = m_makeExporter();
+		m_stream->exporter->begin(m_stream->file.stream(), sessionInfo());
+	}
+	m_stream->thread = std::thread(&ChromeTracer::streamLoop, this, std::ref(*m_stream));
+	m_wakeStream.store(m_stream.get(), std::memory_order_release);
+}
+
+// Stops the writer thread, which finishes its pass first; the file and
+// exporter stay open
+void ChromeTracer::stopStreaming(StreamState& stream)
+{
+	{
+		std::lock_guard<std::mutex> streamLock(stream.mutex);
+		stream.stop = true;
+	}
+	stream.wake.notify_one();
+	stream.thread.join();
 }
 
-ChromeTracer::~ChromeTracer()
+void ChromeTracer::streamLoop(StreamState& stream)
 {
-	endSession();
+	const TraceStringId flushName = internName("tracer.flush_us");
+	const TraceStringId droppedName = internName("tracer.dropped_events");
+	const TraceCategoryId category = internCategory("tracer");
+
+	std::unique_lock<std::mutex> lock(stream.mutex);
+	while (!stream.stop)
+	{
+		stream.wake.wait_for(lock, kStreamInterval);
+		lock.unlock();
+
+		const Ticks start = now();
+		uint64_t dropped = 0;
+		std::vector<std::string_view> names = m_names->snapshot();
+		const std::vector<std::string_view> categories = m_categories->snapshot();
+		for (ThreadBuffer* buffer : buffers())
+		{
+			// After a rotation, an owner retires its buffer on its next event
+			// and may free the chunks right after, so the writer of the
+			// retired session holds off retire() while it drains
+			std::lock_guard<std::mutex> retireLock(buffer->retireMutex);
+			const uint64_t session = buffer->session.load(std::memory_order_acquire);
+			if (session != stream.session || buffer->retiredSession == session)
+				continue;
+			buffer->drainFullChunks(m_streamChunks, [&](TraceEvent* events, size_t count, std::span<const TraceArg> args) {
+				resolveFunctionNames({ events, count }, names);
+				stream.exporter->writeEvents({ names, categories }, buffer->info(names), { events, count }, args);
+			});
+			dropped += buffer->dropped.load(std::memory_order_relaxed);
+		}
+		stream.exporter->flush();
+		if (!stream.live)
+			stream.file.stream().flush();
+
+		// Written with the next pass, like the events of any other thread
+		const Ticks passTicks = now() - start;
+		stream.flushTicks += passTicks;
+		++stream.flushes;
+		addCounterEvent(flushName, category, static_cast<double>(passTicks) * m_nsPerTick / 1000.0);
+		addCounterEvent(droppedName, category, static_cast<double>(dropped));
+
+		lock.lock();
+	}
 }
 
-void ChromeTracer::beginSession(const std::string& filepath)
+bool ChromeTracer::dumpFlightRecorder(const std::string& filepath, double lastSeconds)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	m_filepath = filepath;
-	m_events.clear();
-	m_startTime = clock::now();
-	m_active = true;
+	if (!m_active.load(std::memory_order_relaxed) || m_streamChunks > 0 || m_aggregate)
+		return false;
+
+	// A window reaching back past the session start keeps all of it, rather
+	// than wrapping the unsigned ticks for one longer than the clock's epoch
+	uint64_t sinceTicks = 0;
+	if (lastSeconds > 0.0)
+	{
+		const Ticks end = now();
+		const double window = lastSeconds * 1e9 / sessionInfo().nsPerTick;
+		if (window < static_cast<double>(end - m_startTicks))
+			sinceTicks = end - static_cast<Ticks>(window);
+	}
+	return writeToFile(filepath, sinceTicks);
 }
 
-void ChromeTracer::endSession()
+bool ChromeTracer::rotateSession(const std::string& filepath)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	if (!m_active)
+	if (!m_active.load(std::memory_order_relaxed) || m_mapped || (m_streamChunks > 0 && m_stream->live))
+		return false;
+
+	// One export at a time; only the calling thread waits for it
+	finishRotation();
+	eraseExitedBuffers(m_session.load(std::memory_order_relaxed));
+
+	auto rotation = std::make_unique<RotationState>();
+	rotation->session = m_session.load(std::memory_order_relaxed);
+	rotation->filepath = m_filepath;
+	rotation->info = sessionInfo();
+	rotation->aggregate = m_aggregate;
+	rotation->overhead = overheadInfo(nullptr, rotation->session);
+	m_lockWaitBase = m_names->lockWaitTicks() + m_categories->lockWaitTicks();
+
+	// Threads see the new session on their next event. m_rotatedSession is
+	// published with the bump, so they know to hand the old data over.
+	m_filepath = filepath;
+	m_startTime = std::chrono::steady_clock::now();
+	m_clockAnchorNs = sampleClockAnchor(m_startTicks);
+	m_rotatedSession.store(rotation->session, std::memory_order_relaxed);
+	m_session.fetch_add(1, std::memory_order_release);
+	rotation->buffers = buffers();
+	if (m_crash && m_crash->session.load(std::memory_order_relaxed) != 0)
+		m_crash->rotate(sessionInfo(), m_session.load(std::memory_order_relaxed));
+
+	// The retired session's writer keeps draining its buffers until the
+	// export thread stops it; the exporter holds on to the stream's file, so
+	// both move with it. Producers see the new session on their next event
+	// and no longer feed it. One that read m_wakeStream just before may
+	// still wake the old writer, which lives until the next rotation.
+	if (m_streamChunks > 0)
+	{
+		rotation->stream = std::move(m_stream);
+		startStreaming(nullptr);
+	}
+
+	rotation->thread = std::thread(&ChromeTracer::exportRotated, this, std::ref(*rotation));
+	m_rotation = std::move(rotation);
+	return true;
+}
+
+void ChromeTracer::finishRotation()
+{
+	if (!m_rotation)
 		return;
-	m_active = false;
-	writeToFile();
+	m_rotation->thread.join();
+	m_rotation.reset();
+}
+
+void ChromeTracer::exportRotated(RotationState& rotation)
+{
+	const uint64_t session = rotation.session;
+	TraceOutputFile& file = rotation.stream ? rotation.stream->file : rotation.file;
+	std::unique_ptr<TraceExporter> exporter;
+	if (rotation.stream)
+	{
+		stopStreaming(*rotation.stream);
+		rotation.overhead.flushNs = static_cast<double>(rotation.stream->flushTicks) * rotation.info.nsPerTick;
+		rotation.overhead.flushes = rotation.stream->flushes;
+		exporter = std::move(rotation.stream->exporter);
+	}
+	else
+	{
+		file.open(rotation.filepath, m_compression);
+		if (!rotation.aggregate)
+		{
+			exporter = m_makeExporter();
+			exporter->begin(file.stream(), rotation.info);
+		}
+	}
+
+	ProfileMerge merge;
+	std::vector<TraceEvent> scratch(EventChunk::kCapacity);
+	std::vector<TraceArg> argScratch(EventChunk::kArgCapacity);
+	const auto writeChunks = [&](const ThreadBuffer& buffer, const EventChunk* chunks) {
+		if (!exporter || !chunks)
+			return;
+		std::vector<std::string_view> names = m_names->snapshot();
+		const std::vector<std::string_view> categories = m_categories->snapshot();
+		const TraceThreadInfo thread = buffer.info(names);
+		ThreadBuffer::readChain(chunks, scratch.data(), argScratch.data(),
+			[&](TraceEvent* events, size_t count, std::span<const TraceArg> args) {
+				resolveFunctionNames({ events, count }, names);
+				exporter->writeEvents({ names, categories }, thread, { events, count }, args);
+			});
+	};
+
+	// From the hand-off once the owner has left the session, otherwise in
+	// place. An owner leaving while its buffer is read in place only moves
+	// the chunks aside, so they stay valid until freed here.
+	const auto exportBuffer = [&](ThreadBuffer& buffer) {
+		std::unique_lock<std::mutex> lock(buffer.retireMutex);
+		if (buffer.retiredSession != session)
+		{
+			const EventChunk* chunks = buffer.firstChunk();
+			{
+				std::lock_guard<std::mutex> statsLock(buffer.statsMutex);
+				for (const ScopeStats& stats : buffer.stats)
+					merge.add(stats);
+			}
+			lock.unlock();
+			writeChunks(buffer, chunks);
+			lock.lock();
+			if (buffer.retiredSession != session)
+			{
+				buffer.exportedSession = session;
+				return;
+			}
+		}
+		else
+		{
+			lock.unlock();
+			for (const ScopeStats& stats : buffer.retiredStats)
+				merge.add(stats);
+			writeChunks(buffer, buffer.retiredChunks);
+			lock.lock();
+		}
+		ThreadBuffer::freeChunks(buffer.retiredChunks);
+		buffer.retiredChunks = nullptr;
+		buffer.retiredStats.clear();
+	};
+
+	std::vector<ThreadBuffer*> pending;
+	for (ThreadBuffer* buffer : rotation.buffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->retireMutex);
+		if (buffer->retiredSession == session || buffer->session.load(std::memory_order_acquire) == session)
+			pending.push_back(buffer);
+	}
+
+	// Threads that exited will never hand over; busy ones do so promptly
+	const auto deadline = std::chrono::steady_clock::now() + kRotateGrace;
+	for (;;)
+	{
+		std::erase_if(pending, [&](ThreadBuffer* buffer) {
+			{
+				std::lock_guard<std::mutex> lock(buffer->retireMutex);
+				if (buffer->retiredSession != session && !buffer->exited.load(std::memory_order_acquire))
+					return false;
+			}
+			exportBuffer(*buffer);
+			return true;
+		});
+		if (pending.empty() || std::chrono::steady_clock::now() >= deadline)
+			break;
+		std::this_thread::sleep_for(kRotatePoll);
+	}
+	for (ThreadBuffer* buffer : pending)
+		exportBuffer(*buffer);
+
+	if (rotation.aggregate)
+	{
+		const std::vector<std::string_view> names = m_names->snapshot();
+		const std::vector<std::string_view> categories = m_categories->snapshot();
+		writeProfileJson(file.stream(), merge.result(names, categories, rotation.info.nsPerTick));
+	}
+	else
+	{
+		finishExport(*exporter, rotation.overhead);
+	}
+	exporter.reset();
+	file.close();
+}
+
+ChromeTracer::ThreadBuffer* ChromeTracer::registerThread()
+{
+	auto buffer = std::make_unique<ThreadBuffer>();
+
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	buffer->index = m_nextThreadIndex++;
+	if (m_crash)
+		m_crash->add(buffer.get());
+	m_buffers.push_back(std::move(buffer));
+	s_threadSlot.buffer = m_buffers.back().get();
+	return s_threadSlot.buffer;
+}
+
+ChromeTracer::ThreadBuffer* ChromeTracer::localBuffer()
+{
+	ThreadBuffer* buffer = s_threadSlot.buffer;
+	if (!buffer)
+		buffer = registerThread();
+
+	// First event of a new session drops whatever is left from the previous
+	// one, or hands it to the export thread if that session was rotated out
+	const uint64_t session = m_session.load(std::memory_order_relaxed);
+	const uint64_t previous = buffer->session.load(std::memory_order_relaxed);
+	if (previous != session)
+	{
+		// Pairs with the release in rotateSession(), which sets m_rotatedSession first
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (previous != 0 && previous == m_rotatedSession.load(std::memory_order_relaxed))
+			buffer->retire(previous);
+		buffer->reset(session, m_ringChunks, m_streamChunks, m_mapped.get());
+	}
+	return buffer;
+}
+
+// Opens the thread's counters on its first scope of each session
+size_t ChromeTracer::readPerfCounters(uint64_t* values)
+{
+	ThreadBuffer* buffer = s_threadSlot.buffer ? s_threadSlot.buffer : registerThread();
+	if (!buffer->perf)
+		buffer->perf = std::make_unique<PerfCounters>();
+	PerfCounters& perf = *buffer->perf;
+	const uint64_t session = m_session.load(std::memory_order_relaxed);
+	if (perf.session != session)
+		perf.open(session, { m_perfCounters, m_perfCounterCount }, m_perfKeys);
+	return perf.read(values);
+}
+
+// Nothing if the counters were reopened since start was read
+size_t ChromeTracer::perfCounterArgs(const uint64_t* start, size_t count, TraceArg* args)
+{
+	const PerfCounters* perf = s_threadSlot.buffer ? s_threadSlot.buffer->perf.get() : nullptr;
+	if (!perf || perf->session != m_session.load(std::memory_order_relaxed) || perf->count != count)
+		return 0;
+
+	uint64_t values[kMaxPerfCounters];
+	perf->read(values);
+	for (size_t i = 0; i < count; ++i)
+		args[i] = TraceArg(perf->keys[i], values[i] - start[i]);
+	return count;
+}
+
+TraceStringId ChromeTracer::internName(std::string_view name)
+{
+	ThreadBuffer* buffer = s_threadSlot.buffer ? s_threadSlot.buffer : registerThread();
+	return m_names->intern(name, buffer->nameCache);
+}
+
+TraceCategoryId ChromeTracer::internCategory(std::string_view category)
+{
+	ThreadBuffer* buffer = s_threadSlot.buffer ? s_threadSlot.buffer : registerThread();
+	bool added = false;
+	const TraceStringId id = m_categories->intern(category, buffer->categoryCache, &added);
+	if (id >= kTraceCalibrationCategory)
+		return kTraceOverflowCategory;
+	if (added)
+		updateCategoryFlag(static_cast<TraceCategoryId>(id), category);
+	return static_cast<TraceCategoryId>(id);
+}
+
+void ChromeTracer::setCategoryFilter(const std::vector<std::string>& categories)
+{
+	// Holding m_categoryMutex across the update keeps a category interned
+	// concurrently from being set under the old filter afterwards
+	std::lock_guard<std::mutex> lock(m_categoryMutex);
+	m_categoryFilter = categories;
+	const std::vector<std::string_view> known = m_categories->snapshot();
+	const size_t count = std::min<size_t>(known.size(), kTraceCalibrationCategory);
+	for (size_t id = 0; id < count; ++id)
+		updateCategoryFlagLocked(static_cast<TraceCategoryId>(id), known[id]);
+}
+
+void ChromeTracer::updateCategoryFlag(TraceCategoryId id, std::string_view category)
+{
+	std::lock_guard<std::mutex> lock(m_categoryMutex);
+	updateCategoryFlagLocked(id, category);
+}
+
+void ChromeTracer::updateCategoryFlagLocked(TraceCategoryId id, std::string_view category)
+{
+	// The flag doubles as the session switch, so it is false while inactive
+	const bool enabled = m_active.load(std::memory_order_relaxed);
+	const bool listed = m_categoryFilter.empty()
+		|| std::find(m_categoryFilter.begin(), m_categoryFilter.end(), category) != m_categoryFilter.end();
+	m_categoryEnabled[id].store(enabled && listed, std::memory_order_release);
+}
+
+namespace
+{
+	// Which calibrated cost TraceOptions::subtractOverhead takes for an event
+	size_t eventKind(char phase, bool hasArgs)
+	{
+		TraceEventKind kind = hasArgs ? TraceEventKind::InstantArgs : TraceEventKind::Instant;
+		if (phase == 'X')
+			kind = hasArgs ? TraceEventKind::CompleteArgs : TraceEventKind::Complete;
+		else if (phase == 'C')
+			kind = TraceEventKind::Counter;
+		return static_cast<size_t>(kind);
+	}
+}
+
+void ChromeTracer::record(const TraceEvent& ev, std::span<const TraceArg> args)
+{
+	ThreadBuffer* buffer = localBuffer();
+	bool full;
+	if (m_subtractOverhead) [[unlikely]]
+	{
+		TraceEvent corrected = ev;
+		buffer->subtractOverhead(corrected, m_recordTicks[eventKind(ev.phase, !args.empty())]);
+		full = buffer->append(corrected, args);
+	}
+	else
+	{
+		full = buffer->append(ev, args);
+	}
+
+	// Wake the stream writer as soon as a chunk is ready for it
+	if (full && m_streamChunks > 0)
+		m_wakeStream.load(std::memory_order_acquire)->wake.notify_one();
 }
 
-void ChromeTracer::addDurationEvent(const std::string& name,
-	const std::string& category,
-	TimePoint start,
-	TimePoint end)
+void ChromeTracer::addDurationEvent(TraceStringId name,
+	TraceCategoryId category,
+	Ticks start,
+	Ticks end,
+	std::span<const TraceArg> args)
 {
-	using us = std::chrono::duration<double, std::micro>;
-	TraceEvent ev;
+	if (!isCategoryEnabled(category))
+		return;
+
+	if (m_aggregate)
+	{
+		ThreadBuffer* buffer = localBuffer();
+		uint64_t ticks = end - start;
+		if (m_subtractOverhead) [[unlikely]]
+		{
+			TraceEvent ev{};
+			ev.timestamp = start;
+			ev.duration = ticks;
+			ev.phase = 'X';
+			buffer->subtractOverhead(ev, m_recordTicks[eventKind(ev.phase, !args.empty())]);
+			ticks = ev.duration;
+		}
+		buffer->aggregate(name, category, ticks);
+		return;
+	}
+
+	TraceEvent ev{};
+	ev.timestamp = start;
+	ev.duration = end - start;
 	ev.name = name;
 	ev.category = category;
 	ev.phase = 'X';
-	ev.timestampUs = std::chrono::duration_cast<us>(start - m_startTime).count();
-	ev.durationUs = std::chrono::duration_cast<us>(end - start).count();
-	ev.threadId = std::this_thread::get_id();
-
-	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_active)
-		m_events.push_back(std::move(ev));
+	record(ev, args);
 }
 
-void ChromeTracer::addBeginEvent(const std::string& name, const std::string& category)
+void ChromeTracer::addBeginEvent(TraceStringId name, TraceCategoryId category, std::span<const TraceArg> args)
 {
-	addPhaseEvent(name, category, 'B');
+	addPhaseEvent(name, category, 'B', 0, args);
 }
 
-void ChromeTracer::addEndEvent(const std::string& name, const std::string& category)
+void ChromeTracer::addEndEvent(TraceStringId name, TraceCategoryId category)
 {
 	addPhaseEvent(name, category, 'E');
 }
 
-void ChromeTracer::addInstantEvent(const std::string& name, const std::string& category)
+void ChromeTracer::addInstantEvent(TraceStringId name, TraceCategoryId category, std::span<const TraceArg> args)
+{
+	addPhaseEvent(name, category, 'I', 0, args);
+}
+
+void ChromeTracer::addAsyncBeginEvent(TraceStringId name, TraceCategoryId category, uint64_t id, std::span<const TraceArg> args)
+{
+	addPhaseEvent(name, category, 'b', id, args);
+}
+
+void ChromeTracer::addAsyncEndEvent(TraceStringId name, TraceCategoryId category, uint64_t id)
+{
+	addPhaseEvent(name, category, 'e', id);
+}
+
+void ChromeTracer::addAsyncInstantEvent(TraceStringId name, TraceCategoryId category, uint64_t id)
+{
+	addPhaseEvent(name, category, 'n', id);
+}
+
+void ChromeTracer::addFlowStartEvent(TraceStringId name, TraceCategoryId category, uint64_t id)
+{
+	addPhaseEvent(name, category, 's', id);
+}
+
+void ChromeTracer::addFlowStepEvent(TraceStringId name, TraceCategoryId category, uint64_t id)
+{
+	addPhaseEvent(name, category, 't', id);
+}
+
+void ChromeTracer::addFlowEndEvent(TraceStringId name, TraceCategoryId category, uint64_t id)
+{
+	addPhaseEvent(name, category, 'f', id);
+}
+
+void ChromeTracer::addFunctionEnter(const void* function)
+{
+	addFunctionEvent(function, 'B');
+}
+
+void ChromeTracer::addFunctionExit(const void* function)
+{
+	addFunctionEvent(function, 'E');
+}
+
+void ChromeTracer::addFunctionEvent(const void* function, char phase)
+{
+	if (!isCategoryEnabled(m_instrumentCategory) || m_aggregate)
+		return;
+
+	const auto inside = [function](const TraceAddressRange& range) { return range.contains(function); };
+	if (!m_instrumentAllow.empty() && std::none_of(m_instrumentAllow.begin(), m_instrumentAllow.end(), inside))
+		return;
+	if (std::any_of(m_instrumentDeny.begin(), m_instrumentDeny.end(), inside))
+		return;
+
+	TraceEvent ev{};
+	ev.timestamp = now();
+	ev.name = kTraceAddressName;
+	ev.category = m_instrumentCategory;
+	ev.id = reinterpret_cast<uintptr_t>(function);
+	ev.phase = phase;
+	record(ev);
+}
+
+// Swaps the addresses of function instrumentation events for the interned
+// names of their symbols. Re-snapshots names when that adds any.
+void ChromeTracer::resolveFunctionNames(std::span<TraceEvent> events, std::vector<std::string_view>& names) const
+{
+	for (TraceEvent& ev : events)
+	{
+		if (ev.name != kTraceAddressName)
+			continue;
+
+		{
+			std::lock_guard<std::mutex> lock(m_symbolizer->mutex);
+			auto [it, added] = m_symbolizer->ids.try_emplace(ev.id, 0);
+			if (added)
+				it->second = m_names->intern(symbolize(static_cast<uintptr_t>(ev.id)), m_symbolizer->cache);
+			ev.name = it->second;
+		}
+		ev.id = 0;
+		if (ev.name >= names.size())
+			names = m_names->snapshot();
+	}
+}
+
+void ChromeTracer::addCounterEvent(TraceStringId name, TraceCategoryId category, double value)
 {
-	addPhaseEvent(name, category, 'I');
+	addPhaseEvent(name, category, 'C', std::bit_cast<uint64_t>(value));
 }
 
-void ChromeTracer::addPhaseEvent(const std::string& name,
-	const std::string& category,
-	char phase)
+void ChromeTracer::setThreadName(std::string_view name, std::optional<int32_t> sortIndex)
 {
-	using us = std::chrono::duration<double, std::micro>;
-	TraceEvent ev;
+	ThreadBuffer* buffer = s_threadSlot.buffer ? s_threadSlot.buffer : registerThread();
+	const TraceStringId id = internName(name);
+	const int64_t sort = sortIndex ? *sortIndex : ThreadBuffer::kNoSortIndex;
+	buffer->threadName.store(id, std::memory_order_relaxed);
+	buffer->sortIndex.store(sort, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(m_mappedMutex);
+	if (m_mapped)
+		m_mapped->setThread(buffer->index, id, sort);
+}
+
+uint64_t ChromeTracer::newAsyncId()
+{
+	// 2^40 IDs per thread before the counter wraps into its own range again
+	constexpr unsigned kCounterBits = 40;
+	ThreadBuffer* buffer = s_threadSlot.buffer ? s_threadSlot.buffer : registerThread();
+	const uint64_t counter = ++buffer->asyncIds & ((uint64_t(1) << kCounterBits) - 1);
+	return (static_cast<uint64_t>(buffer->index) << kCounterBits) | counter;
+}
+
+void ChromeTracer::addPhaseEvent(TraceStringId name,
+	TraceCategoryId category,
+	char phase,
+	uint64_t id,
+	std::span<const TraceArg> args)
+{
+	if (!isCategoryEnabled(category) || m_aggregate)
+		return;
+
+	TraceEvent ev{};
+	ev.timestamp = now();
 	ev.name = name;
 	ev.category = category;
+	ev.id = id;
 	ev.phase = phase;
-	ev.timestampUs = std::chrono::duration_cast<us>(clock::now() - m_startTime).count();
-	ev.durationUs = 0.0;
-	ev.threadId = std::this_thread::get_id();
+	record(ev, args);
+}
+
+template <typename Fn>
+void ChromeTracer::forEachChunk(Fn&& fn) const
+{
+	const uint64_t session = m_session.load(std::memory_order_relaxed);
+	std::vector<TraceEvent> scratch(EventChunk::kCapacity);
+	std::vector<TraceArg> argScratch(EventChunk::kArgCapacity);
+
+	for (ThreadBuffer* buffer : buffers())
+	{
+		if (buffer->session.load(std::memory_order_acquire) != session)
+			continue;
+
+		ThreadBuffer::readChain(buffer->firstChunk(), scratch.data(), argScratch.data(),
+			[&](TraceEvent* events, size_t count, std::span<const TraceArg> args) {
+				fn(*buffer, events, count, args);
+			});
+	}
+}
+
+TraceSessionInfo ChromeTracer::sessionInfo() const
+{
+	TraceSessionInfo info;
+	info.startTicks = m_startTicks;
+	info.nsPerTick = m_nsPerTick;
+	info.pid = m_pid;
+	info.processName = m_processName;
+	info.hostName = m_hostName;
+	info.clockAnchorNs = m_clockAnchorNs;
+
+#if defined(TRACER_CLOCK_TSC) && !defined(__aarch64__)
+	const auto endTime = std::chrono::steady_clock::now();
+	const Ticks endTicks = now();
+	if (endTime - m_startTime >= kRecalibrateAfter && endTicks > m_startTicks)
+	{
+		const double ns = std::chrono::duration<double, std::nano>(endTime - m_startTime).count();
+		info.nsPerTick = ns / static_cast<double>(endTicks - m_startTicks);
+	}
+#endif
+	return info;
+}
 
+bool ChromeTracer::dumpProfile(const std::string& filepath)
+{
 	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_active)
-		m_events.push_back(std::move(ev));
+	if (!m_active.load(std::memory_order_relaxed) || !m_aggregate)
+		return false;
+	return writeProfile(filepath);
 }
 
-void ChromeTracer::writeToFile() const
+std::vector<TraceScopeStats> ChromeTracer::profile() const
 {
-	std::ofstream ofs(m_filepath);
-	ofs << "{\"traceEvents\":[";
+	if (!m_active.load(std::memory_order_acquire) || !m_aggregate)
+		return {};
+	return mergeProfile();
+}
 
-	for (size_t i = 0; i < m_events.size(); ++i)
+std::vector<TraceScopeStats> ChromeTracer::mergeProfile() const
+{
+	ProfileMerge merge;
+	const uint64_t session = m_session.load(std::memory_order_relaxed);
+	for (ThreadBuffer* buffer : buffers())
 	{
-		const auto& ev = m_events[i];
-		if (i > 0)
-			ofs << ",";
+		if (buffer->session.load(std::memory_order_acquire) != session)
+			continue;
+
+		std::lock_guard<std::mutex> lock(buffer->statsMutex);
+		for (const ScopeStats& stats : buffer->stats)
+			merge.add(stats);
+	}
 
-		// Thread id → numeric
-		std::ostringstream tidStream;
-		tidStream << ev.threadId;
+	const std::vector<std::string_view> names = m_names->snapshot();
+	const std::vector<std::string_view> categories = m_categories->snapshot();
+	return merge.result(names, categories, sessionInfo().nsPerTick);
+}
 
-		ofs << "{\"name\":\"" << ev.name
-			<< "\",\"cat\":\"" << ev.category
-			<< "\",\"ph\":\"" << ev.phase
-			<< "\",\"ts\":" << ev.timestampUs
-			<< ",\"pid\":0"
-			<< ",\"tid\":" << tidStream.str();
+bool ChromeTracer::writeProfile(const std::string& filepath) const
+{
+	TraceOutputFile file;
+	if (!file.open(filepath, m_compression))
+		return false;
 
-		if (ev.phase == 'X')
-			ofs << ",\"dur\":" << ev.durationUs;
+	const std::vector<TraceScopeStats> stats = mergeProfile();
+	writeProfileJson(file.stream(), stats);
+	return file.close();
+}
+
+void ChromeTracer::registerSampler(TraceSampler* sampler)
+{
+	std::lock_guard<std::mutex> lock(m_samplersMutex);
+	m_samplers.push_back(sampler);
+}
+
+// Totals of the running session; stream is its writer, if any
+TraceOverheadInfo ChromeTracer::overheadInfo(const StreamState* stream, uint64_t session) const
+{
+	TraceOverheadInfo overhead;
+	const double nsPerTick = sessionInfo().nsPerTick;
+	for (size_t kind = 0; kind < kTraceEventKinds; ++kind)
+		overhead.recordNs[kind] = m_recordTicks[kind] * nsPerTick;
+	if (stream)
+	{
+		overhead.flushNs = static_cast<double>(stream->flushTicks) * nsPerTick;
+		overhead.flushes = stream->flushes;
+	}
+	const Ticks lockWait = m_names->lockWaitTicks() + m_categories->lockWaitTicks() - m_lockWaitBase;
+	overhead.lockWaitNs = static_cast<double>(lockWait) * nsPerTick;
+	for (const ThreadBuffer* buffer : buffers())
+	{
+		if (buffer->session.load(std::memory_order_acquire) == session)
+			overhead.droppedEvents += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	overhead.subtracted = m_subtractOverhead;
+	return overhead;
+}
+
+// Cost of recording one event of each TraceEventKind, timed with empty
+// scopes and bare events whose records go to a scratch ring swapped in for
+// the calling thread's buffer. Best of a few rounds. The events carry
+// kTraceCalibrationCategory, which only this thread records with and
+// which the category filter never sees.
+void ChromeTracer::calibrateRecordTicks()
+{
+	std::fill(std::begin(m_recordTicks), std::end(m_recordTicks), 0.0);
+	const TraceStringId name = internName("tracer.calibration");
+	const TraceCategoryId category = kTraceCalibrationCategory;
+	m_categoryEnabled[category].store(true, std::memory_order_release);
+
+	ThreadBuffer scratch;
+	scratch.reset(m_session.load(std::memory_order_relaxed), 1, 0, nullptr);
+	ThreadBuffer* const own = s_threadSlot.buffer;
+	s_threadSlot.buffer = &scratch;
+
+	const TraceArg arg(name, 0);
+	const auto time = [&](TraceEventKind kind, auto&& recordOne)
+	{
+		constexpr size_t kEvents = EventChunk::kCapacity;
+		double best = std::numeric_limits<double>::max();
+		for (int round = 0; round < 5; ++round)
+		{
+			const Ticks start = now();
+			for (size_t i = 0; i < kEvents; ++i)
+				recordOne();
+			best = std::min(best, static_cast<double>(now() - start) / kEvents);
+		}
+		m_recordTicks[static_cast<size_t>(kind)] = best;
+	};
+	time(TraceEventKind::Complete, [&] { ScopeTrace scope(name, category); });
+	time(TraceEventKind::CompleteArgs, [&]
+	{
+		ScopeTrace scope(name, category);
+		scope.addArg(arg);
+	});
+	time(TraceEventKind::Instant, [&] { addInstantEvent(name, category); });
+	time(TraceEventKind::InstantArgs, [&] { addInstantEvent(name, category, { &arg, 1 }); });
+	time(TraceEventKind::Counter, [&] { addCounterEvent(name, category, 1.0); });
 
-		ofs << "}";
+	s_threadSlot.buffer = own;
+	m_categoryEnabled[category].store(false, std::memory_order_release);
+}
+
+void ChromeTracer::finishExport(TraceExporter& exporter, const TraceOverheadInfo& overhead) const
+{
+	const std::vector<std::string_view> names = m_names->snapshot();
+	std::vector<TraceSamplingInfo> sampling;
+	{
+		std::lock_guard<std::mutex> lock(m_samplersMutex);
+		for (const TraceSampler* sampler : m_samplers)
+		{
+			sampling.push_back({ names[sampler->name()], sampler->interval(), sampler->maxPerSecond(),
+				sampler->calls(), sampler->recorded() });
+		}
+	}
+
+	TraceSummary summary;
+	summary.sampling = sampling;
+	summary.overhead = overhead;
+	exporter.end(summary);
+}
+
+namespace
+{
+	constexpr size_t kChunksPerFragment = 64;    // parallel export unit, up to 64k events
+	constexpr size_t kFragmentsAhead = 2;        // per worker, formatted ahead of the writer
+
+	// Dumps leave out events that ended before sinceTicks
+	size_t keepSince(TraceEvent* events, size_t count, ChromeTracer::Ticks sinceTicks)
+	{
+		if (sinceTicks == 0)
+			return count;
+		return static_cast<size_t>(std::remove_if(events, events + count, [&](const TraceEvent& ev) {
+			return ev.timestamp + (ev.phase == 'X' ? ev.duration : 0) < sinceTicks;
+		}) - events);
+	}
+}
+
+bool ChromeTracer::writeToFile(const std::string& filepath, Ticks sinceTicks) const
+{
+	TraceOutputFile file;
+	if (!file.open(filepath, m_compression))
+		return false;
+
+	const TraceSessionInfo info = sessionInfo();
+	const std::unique_ptr<TraceExporter> exporter = m_makeExporter();
+	exporter->begin(file.stream(), info);
+	if (!exportParallel(*exporter, file.stream(), info, sinceTicks))
+	{
+		std::vector<std::string_view> names = m_names->snapshot();
+		const std::vector<std::string_view> categories = m_categories->snapshot();
+		forEachChunk([&](const ThreadBuffer& buffer, TraceEvent* events, size_t count, std::span<const TraceArg> args) {
+			resolveFunctionNames({ events, count }, names);
+			count = keepSince(events, count, sinceTicks);
+			exporter->writeEvents({ names, categories }, buffer.info(names), { events, count }, args);
+		});
+	}
+	finishExport(*exporter, overheadInfo(nullptr, m_session.load(std::memory_order_relaxed)));
+
+	return file.close();
+}
+
+// Splits the session's chains into runs of chunks, formats each run into a
+// fragment (TraceExporter::makeFragment) on a pool of workers, and writes
+// the fragments in chain order, so every thread's events stay in sequence.
+// Workers stay a few fragments ahead of the writer to bound memory. False
+// if there is nothing to gain; the caller then exports on this thread.
+bool ChromeTracer::exportParallel(TraceExporter& exporter, std::ostream& out, const TraceSessionInfo& info, Ticks sinceTicks) const
+{
+	struct Run
+	{
+		const ThreadBuffer* buffer;
+		const EventChunk* first;
+		size_t chunks;
+	};
+	std::vector<Run> runs;
+	const uint64_t session = m_session.load(std::memory_order_relaxed);
+	for (const ThreadBuffer* buffer : buffers())
+	{
+		if (buffer->session.load(std::memory_order_acquire) != session)
+			continue;
+
+		const EventChunk* first = buffer->firstChunk();
+		for (const EventChunk* chunk = first; chunk; )
+		{
+			if (runs.empty() || runs.back().buffer != buffer || runs.back().chunks == kChunksPerFragment)
+				runs.push_back({ buffer, chunk, 0 });
+			++runs.back().chunks;
+			chunk = chunk->next.load(std::memory_order_acquire);
+			if (chunk == first)
+				break;
+		}
 	}
 
-	ofs << "]}";
+	const size_t workers = std::min<size_t>(runs.size(), std::thread::hardware_concurrency());
+	if (workers < 2 || !exporter.makeFragment(0))
+		return false;
+
+	struct Fragment
+	{
+		std::string data;
+		bool done = false;
+	};
+	std::vector<Fragment> fragments(runs.size());
+	std::mutex mutex;                            // guards fragments, next and written
+	std::condition_variable changed;
+	size_t next = 0;                             // run to format next
+	size_t written = 0;                          // fragments handed to out
+	const size_t ahead = workers * kFragmentsAhead;
+
+	const auto work = [&] {
+		std::vector<std::string_view> names = m_names->snapshot();
+		const std::vector<std::string_view> categories = m_categories->snapshot();
+		std::vector<TraceEvent> scratch(EventChunk::kCapacity);
+		std::vector<TraceArg> argScratch(EventChunk::kArgCapacity);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			changed.wait(lock, [&] { return next == runs.size() || next < written + ahead; });
+			if (next == runs.size())
+				return;
+			const size_t index = next++;
+			lock.unlock();
+
+			const Run& run = runs[index];
+			std::ostringstream fragmentOut;
+			const std::unique_ptr<TraceExporter> fragment = exporter.makeFragment(static_cast<uint32_t>(index));
+			fragment->begin(fragmentOut, info);
+			const EventChunk* chunk = run.first;
+			for (size_t i = 0; i < run.chunks && chunk; ++i)
+			{
+				size_t argCount = 0;
+				size_t count = ThreadBuffer::readChunk(chunk, scratch.data(), argScratch.data(), argCount);
+				resolveFunctionNames({ scratch.data(), count }, names);
+				count = keepSince(scratch.data(), count, sinceTicks);
+				if (count > 0)
+				{
+					fragment->writeEvents({ names, categories }, run.buffer->info(names),
+						{ scratch.data(), count }, { argScratch.data(), argCount });
+				}
+				chunk = chunk->next.load(std::memory_order_acquire);
+			}
+			fragment->end({});
+
+			lock.lock();
+			fragments[index].data = std::move(fragmentOut).str();
+			fragments[index].done = true;
+			changed.notify_all();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t i = 0; i < workers; ++i)
+		pool.emplace_back(work);
+
+	exporter.flush();
+	for (size_t index = 0; index < fragments.size(); ++index)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return fragments[index].done; });
+		const std::string data = std::move(fragments[index].data);
+		written = index + 1;
+		lock.unlock();
+		changed.notify_all();
+		out.write(data.data(), static_cast<std::streamsize>(data.size()));
+	}
+	for (std::thread& thread : pool)
+		thread.join();
+	return true;
 }
 
 // ============================================================================
 // ScopeTrace implementation
 // ============================================================================
 
-ScopeTrace::ScopeTrace(const std::string& name, const std::string& category)
-	: m_name(name), m_category(category), m_start(ChromeTracer::now())
+ScopeTrace::ScopeTrace(std::string_view name, std::string_view category)
+	: ScopeTrace(ChromeTracer::instance().categorySite(category),
+		[name] { return ChromeTracer::instance().internName(name); })
+{
+}
+
+void ScopeTrace::finish(ChromeTracer::Ticks end)
+{
+	ChromeTracer& tracer = ChromeTracer::instance();
+	if (m_perfCount == 0)
+	{
+		tracer.addDurationEvent(m_name, m_category, m_start, end, { m_args, m_argCount });
+		return;
+	}
+
+	TraceArg args[kMaxArgs + ChromeTracer::kMaxPerfCounters];
+	std::copy_n(m_args, m_argCount, args);
+	const size_t perfArgs = tracer.perfCounterArgs(m_perf, m_perfCount, args + m_argCount);
+	tracer.addDurationEvent(m_name, m_category, m_start, end, { args, m_argCount + perfArgs });
+}
+
+// ============================================================================
+// TraceArg implementation
+// ============================================================================
+
+TraceArg::TraceArg(TraceStringId key, std::string_view value)
+	: key(key), type(Type::String), stringValue(ChromeTracer::instance().internName(value))
 {
 }
 
-ScopeTrace::~ScopeTrace()
+// ============================================================================
+// TraceSampler implementation
+// ============================================================================
+
+bool TraceSampler::admit()
+{
+	const ChromeTracer::Ticks now = ChromeTracer::now();
+	ChromeTracer::Ticks start = m_windowStart.load(std::memory_order_relaxed);
+	if (now - start >= ChromeTracer::instance().ticksPerSecond()
+		&& m_windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+	{
+		// Calls racing with the roll-over may land in either window
+		const uint64_t calls = m_windowCalls.exchange(0, std::memory_order_relaxed);
+		m_pastCalls.fetch_add(calls, std::memory_order_relaxed);
+		m_pastRecorded.fetch_add(std::min<uint64_t>(calls, m_maxPerSecond), std::memory_order_relaxed);
+	}
+	return m_windowCalls.fetch_add(1, std::memory_order_relaxed) < m_maxPerSecond;
+}
+
+void TraceSampler::noteRecorded(TraceStringId name)
 {
-	ChromeTracer::instance().addDurationEvent(
-		m_name, m_category, m_start, ChromeTracer::now());
-}
\ No newline at end of file
+	if (m_registered.load(std::memory_order_relaxed) || m_registered.exchange(true, std::memory_order_acq_rel))
+		return;
+	m_name = name;
+	ChromeTracer::instance().registerSampler(this);
+}
+
+uint64_t TraceSampler::calls() const
+{
+	return m_pastCalls.load(std::memory_order_relaxed) + m_windowCalls.load(std::memory_order_relaxed);
+}
+
+uint64_t TraceSampler::recorded() const
+{
+	const uint64_t window = std::min<uint64_t>(m_windowCalls.load(std::memory_order_relaxed), m_maxPerSecond);
+	return m_pastRecorded.load(std::memory_order_relaxed) + window;
+}
@@ -3,77 +3,656 @@
 
 #pragma once
 
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#if defined(TRACER_CLOCK_TSC)
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#error "TRACER_CLOCK=tsc is only supported on x86 and AArch64"
+#endif
+#endif
+
 // ============================================================================
 // Chrome Trace Event Format logger
 // Output: JSON loadable in chrome://tracing or https://ui.perfetto.dev
 // ============================================================================
 
+// Names and categories are interned once and referred to by ID afterwards
+using TraceStringId = uint32_t;
+using TraceCategoryId = uint16_t;
+
+// Categories are limited to what a TraceCategoryId holds. Every category
+// interned past the limit gets this reserved ID, which is never enabled, so
+// its events are dropped instead of aliasing another category
+inline constexpr TraceCategoryId kTraceOverflowCategory = UINT16_MAX;
+
+// Reserved for timing the recording cost at beginSession, and enabled only
+// meanwhile. No interned category gets it, so no call site records with it.
+inline constexpr TraceCategoryId kTraceCalibrationCategory = kTraceOverflowCategory - 1;
+
+// Name ID of a scope that was sampled out and records nothing
+inline constexpr TraceStringId kTraceNoName = UINT32_MAX;
+
+// Name ID of a function instrumentation event until export, which looks up
+// the symbol at the address the event carries in its id
+inline constexpr TraceStringId kTraceAddressName = UINT32_MAX - 1;
+
+// What a call site keeps for its category: the ID and the switch that says
+// whether the running session records it (see ChromeTracer::categoryFlag)
+struct TraceCategorySite
+{
+	const std::atomic<bool>* enabled;
+	TraceCategoryId id;
+};
+
+// Static descriptor of a scope whose name is a literal or __FUNCTION__,
+// resolved once per call site
+struct TraceScopeSite
+{
+	TraceCategorySite category;
+	TraceStringId name;
+};
+
+// Typed event argument ("args" in the Chrome format). Keys and string
+// values are interned names, so an argument is a fixed 16 bytes that is
+// copied into the recording thread's chunk next to its event.
+struct TraceArg
+{
+	enum class Type : uint8_t
+	{
+		Int,
+		UInt,
+		Double,
+		Bool,
+		String,
+	};
+
+	TraceStringId key;
+	Type type;
+	union
+	{
+		int64_t intValue;
+		uint64_t uintValue;
+		double doubleValue;
+		bool boolValue;
+		TraceStringId stringValue;       // interned like names
+	};
+
+	TraceArg() = default;
+
+	template <typename T>
+		requires std::is_arithmetic_v<T>
+	TraceArg(TraceStringId key, T value)
+		: key(key)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			type = Type::Bool;
+			boolValue = value;
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			type = Type::Double;
+			doubleValue = static_cast<double>(value);
+		}
+		else if constexpr (std::is_signed_v<T>)
+		{
+			type = Type::Int;
+			intValue = static_cast<int64_t>(value);
+		}
+		else
+		{
+			type = Type::UInt;
+			uintValue = static_cast<uint64_t>(value);
+		}
+	}
+
+	// Interns value on every call
+	TraceArg(TraceStringId key, std::string_view value);
+};
+
+static_assert(sizeof(TraceArg) == 16, "TraceArg should stay packed");
+static_assert(std::is_trivially_copyable_v<TraceArg>);
+
+// Packed in-memory record. Times are raw clock ticks; conversion to
+// microseconds happens at export. Arguments live in the argument arena of
+// the chunk the record is stored in.
 struct TraceEvent
+{
+	uint64_t timestamp;                  // clock ticks
+	union
+	{
+		uint64_t duration;               // clock ticks, 'X' (complete) events
+		uint64_t id;                     // async ('b' 'e' 'n') and flow ('s' 't' 'f') events
+		double value;                    // 'C' (counter) events
+	};
+	TraceStringId name;
+	TraceCategoryId category;
+	char phase;                          // 'B' = begin, 'E' = end, 'X' = complete, 'I' = instant,
+	                                     // 'b' 'e' 'n' = async, 's' 't' 'f' = flow, 'C' = counter
+	uint8_t argCount;                    // arguments at [argIndex, argIndex + argCount)
+	uint32_t argIndex;                   // in the chunk's argument arena
+	uint32_t thread;                     // dense recording thread index, exported as tid
+};
+
+static_assert(sizeof(TraceEvent) == 32, "TraceEvent should stay packed");
+static_assert(std::is_trivially_copyable_v<TraceEvent>);
+
+class TraceExporter;
+class TraceSampler;
+struct TraceOverheadInfo;
+struct TraceSessionInfo;
+struct TraceSummary;
+
+enum class TraceFormat
+{
+	Json,                                // Chrome JSON, see makeJsonExporter()
+	Perfetto,                            // Perfetto protobuf, see makePerfettoExporter()
+};
+
+// Compression of trace files, see TraceOptions::compression
+enum class TraceCompression
+{
+	None,
+	Gzip,                                // regular .gz, needs zlib at build time
+	Zstd,                                // needs libzstd at build time
+};
+
+// perf_event counter read around each scope, see TraceOptions::perfCounters.
+// The comment gives the argument each delta is recorded as.
+enum class TracePerfCounter
+{
+	Cycles,                              // "cycles"
+	Instructions,                        // "instructions"
+	CacheMisses,                         // "llc_misses", last-level cache
+	BranchMisses,                        // "branch_misses"
+	PageFaults,                          // "page_faults", software event
+	ContextSwitches,                     // "context_switches", software event counted in the kernel
+};
+
+// Events whose recording cost is calibrated separately, see
+// TraceOptions::subtractOverhead
+enum class TraceEventKind
+{
+	Complete,                            // 'X': scopes and spans
+	CompleteArgs,                        // 'X' with arguments
+	Instant,                             // one timestamp: 'B' 'E' 'I', async, flow, instrumented functions
+	InstantArgs,                         // as above with arguments
+	Counter,                             // 'C'
+};
+
+inline constexpr size_t kTraceEventKinds = 5;
+
+// Code addresses [begin, end), see TraceOptions::instrumentAllow
+struct TraceAddressRange
+{
+	const void* begin;
+	const void* end;
+
+	bool contains(const void* address) const
+	{
+		const auto value = reinterpret_cast<uintptr_t>(address);
+		return value >= reinterpret_cast<uintptr_t>(begin) && value < reinterpret_cast<uintptr_t>(end);
+	}
+
+	// The loaded executable or shared library containing address, e.g.
+	// TraceAddressRange::module(&main); empty if it cannot be determined
+	static TraceAddressRange module(const void* address);
+};
+
+// Per-session settings passed to ChromeTracer::beginSession
+struct TraceOptions
+{
+	// Output format written by endSession(), dumps and the stream writer
+	TraceFormat format = TraceFormat::Json;
+
+	// Compresses whatever sessions write to files: endSession(), dumps, the
+	// stream writer and rotated sessions. A worker thread compresses the
+	// output in 1 MiB blocks while the exporter serializes the next ones, so
+	// the file name is used as given (add ".gz" / ".zst" yourself). A format
+	// this build lacks falls back to gzip, then to none; see
+	// TraceOutputFile::supports(). Ignored in mapped mode.
+	TraceCompression compression = TraceCompression::None;
+
+	// Custom exporter factory (see tracer_export.h); overrides format when set
+	std::function<std::unique_ptr<TraceExporter>()> exporter;
+
+	// Flight recorder mode: when non-zero, each thread keeps only its most
+	// recent events in a preallocated ring, overwriting the oldest. Memory
+	// stays fixed for the whole session. The ring holds at least this many
+	// events as long as none carries more than ringBufferArgsPerEvent
+	// arguments of its own. Perf counter deltas (perfCounters) are added to
+	// that count. Events with more arguments fill chunks sooner, so fewer
+	// events are kept.
+	size_t ringBufferEvents = 0;
+	size_t ringBufferArgsPerEvent = 1;
+
+	// Streaming mode: a background thread writes filled chunks to the file as
+	// the session runs, so endSession() only flushes the last partial chunks.
+	// Each thread keeps at most streamChunksPerThread chunks in flight (one
+	// being filled, the rest waiting for the writer); if the writer falls that
+	// far behind, new events are dropped rather than blocking the thread.
+	// Ignored in flight recorder mode.
+	bool streaming = false;
+	size_t streamChunksPerThread = 64;
+
+	// Live mode: when set, the stream writer publishes events into a
+	// shared-memory segment of liveBytes with this name (see tracer_live.h)
+	// instead of writing the session's file, and tracer_collect forwards them
+	// from there to a viewer as the session runs. Implies streaming; if the
+	// collector falls behind, events are dropped and counted in the segment.
+	// Overridden by the other modes; if the segment cannot be created, the
+	// session records to the file as usual. Sessions cannot rotate.
+	std::string liveName;
+	size_t liveBytes = size_t(64) << 20;
+
+	// Categories to record; everything else costs one relaxed load at the
+	// call site. When empty, the comma-separated TRACER_CATEGORIES
+	// environment variable is used, and when that is unset too, all
+	// categories are recorded.
+	std::vector<std::string> categories;
+
+	// Aggregation mode: complete events (scopes) update per-thread, per-name
+	// statistics instead of being stored, and endSession() writes the merged
+	// profile() as JSON. Memory grows with the number of distinct scopes, not
+	// events. Begin/end/instant events are not recorded. Overrides flight
+	// recorder and streaming mode.
+	bool aggregate = false;
+
+	// When non-zero, a background thread records the process's resident
+	// memory ("process.rss_bytes") and CPU use ("process.cpu_percent", 100 =
+	// one core) as counters in the "process" category at this interval
+	std::chrono::milliseconds resourceSampleInterval{ 0 };
+
+	// Shown for this process when traces are viewed or merged; defaults to
+	// the executable's file name
+	std::string processName;
+
+	// Mapped mode: when non-zero, the session's file is created at this size
+	// and mapped, and threads record straight into it in the binary layout
+	// of tracer_mapped.h. Data reaches the page cache as it is recorded, so
+	// a trace survives the process crashing (not the machine), and
+	// endSession() has nothing left to write. Convert the file with
+	// tracer_recover. Once it is full, new events are dropped. Overrides
+	// flight recorder and streaming mode; if the file cannot be mapped, the
+	// session records in memory as usual.
+	size_t mappedBytes = 0;
+
+	// Crash dump: when set, a fatal signal (SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+	// SIGABRT) or std::terminate() during the session writes the events the
+	// threads still hold to this file, in the layout of tracer_mapped.h and
+	// with async-signal-safe calls only, before passing on to the previous
+	// handler. Convert it with tracer_recover. Meant for flight recorder
+	// mode; streaming sessions dump what the writer has not taken yet. The
+	// handlers are installed by the first such session and stay; the file
+	// is removed when the session ends. Ignored in mapped and aggregation mode.
+	std::string crashDumpPath;
+
+	// Function instrumentation (TRACER_INSTRUMENT_FUNCTIONS, category
+	// "instrumented"): when instrumentAllow is non-empty, only functions
+	// starting inside one of its ranges are recorded, and functions inside an
+	// instrumentDeny range never are. Checked on every call, so keep both short.
+	std::vector<TraceAddressRange> instrumentAllow;
+	std::vector<TraceAddressRange> instrumentDeny;
+
+	// Linux: each recorded ScopeTrace (TRACE_SCOPE, TRACE_FUNCTION, ...)
+	// reads these counters of its thread on entry and exit and records the
+	// deltas as arguments, so IPC and cache behavior can be attributed to
+	// spans. Threads open their counters with perf_event_open on their first
+	// scope of the session and read them in user space with rdpmc where the
+	// kernel allows it (x86), with read(2) otherwise. Counters that cannot be
+	// opened (no PMU, perf_event_paranoid) are left out. The first
+	// ChromeTracer::kMaxPerfCounters are used; the deltas take argument slots
+	// after the scope's own. Ignored in aggregation mode.
+	std::vector<TracePerfCounter> perfCounters;
+
+	// The tracer measures its own cost in every session: the calibrated
+	// cost of recording one event of each TraceEventKind, the stream
+	// writer's passes, waits for the string tables' locks and dropped
+	// events. JSON output has the totals in its metadata ("overhead"), and
+	// streaming sessions record "tracer.flush_us" and "tracer.dropped_events"
+	// counters (category "tracer"). When this is set, each complete event's
+	// duration is also reduced by the calibrated cost of the events recorded
+	// on its thread while it ran, each by its kind, in aggregation mode too.
+	// Calibration times one-argument events and leaves out perf counter
+	// reads. Timestamps stay as recorded, so a shortened scope may end
+	// before its last child in the timeline.
+	bool subtractOverhead = false;
+};
+
+// One row of ChromeTracer::profile(): a scope merged across all threads
+struct TraceScopeStats
 {
 	std::string name;
 	std::string category;
-	char phase;                          // 'B' = begin, 'E' = end, 'X' = complete, 'I' = instant
-	double timestampUs;                  // microseconds since session start
-	double durationUs;                   // only used for 'X' (complete) events
-	std::thread::id threadId;
+	uint64_t count = 0;
+	double totalNs = 0.0;
+	double minNs = 0.0;
+	double maxNs = 0.0;
+	double p50Ns = 0.0;                  // percentiles come from a log-linear
+	double p90Ns = 0.0;                  // histogram and are accurate to 1/16
+	double p99Ns = 0.0;
 };
 
 class ChromeTracer
 {
 public:
 	// Type aliases — must be at the top for use in public methods
-	using clock = std::chrono::high_resolution_clock;
-	using TimePoint = clock::time_point;
+	using clock = std::chrono::steady_clock;   // monotonic; wall time only via the clock anchor
+	using Ticks = uint64_t;
 
 	static ChromeTracer& instance();
 
+	bool isActive() const { return m_active.load(std::memory_order_relaxed); }
+
 	// Call once at program start
-	void beginSession(const std::string& filepath = "trace.json");
+	void beginSession(const std::string& filepath = "trace.json",
+		const TraceOptions& options = {});
 
 	// Call once at program end — writes the JSON file
 	void endSession();
 
-	// Record a complete duration event (phase 'X')
-	void addDurationEvent(const std::string& name,
-		const std::string& category,
-		TimePoint start,
-		TimePoint end);
+	// Switch the active session to filepath without pausing recording
+	// threads: events recorded from here on go to the new file, and a
+	// background thread writes the previous one. Each thread hands its
+	// buffers over on its first event after the switch; threads that stay
+	// idle are read in place after a short grace period. The new file gets
+	// its own start time and clock anchor; options carry over. Waits for the
+	// previous rotation's export, if still running. Returns false if no
+	// session is active or it is mapped or live.
+	bool rotateSession(const std::string& filepath);
+
+	// Write what is currently buffered to filepath without ending the session,
+	// e.g. when a latency budget is exceeded. lastSeconds > 0 keeps only events
+	// that ended within that window. Returns false if no session is active, the
+	// session is streaming, or the file cannot be written.
+	bool dumpFlightRecorder(const std::string& filepath, double lastSeconds = 0.0);
+
+	// Aggregation mode: merge the per-thread statistics recorded so far, most
+	// total time first. Empty if no aggregating session is active.
+	std::vector<TraceScopeStats> profile() const;
+
+	// Aggregation mode: write profile() to filepath without ending the
+	// session. Returns false if no aggregating session is active or the file
+	// cannot be written.
+	bool dumpProfile(const std::string& filepath);
+
+	// Look up (or add) a string and return its ID. Repeated lookups of the same
+	// string on a thread are served from a per-thread cache and never allocate.
+	TraceStringId internName(std::string_view name);
+	TraceCategoryId internCategory(std::string_view category);
+
+	// Record a complete duration event (phase 'X'). Events that take args
+	// copy them next to the record; at most 255 are kept.
+	void addDurationEvent(TraceStringId name,
+		TraceCategoryId category,
+		Ticks start,
+		Ticks end,
+		std::span<const TraceArg> args = {});
 
 	// Record a begin ('B') or end ('E') event for manual pairing
-	void addBeginEvent(const std::string& name, const std::string& category);
-	void addEndEvent(const std::string& name, const std::string& category);
+	void addBeginEvent(TraceStringId name, TraceCategoryId category, std::span<const TraceArg> args = {});
+	void addEndEvent(TraceStringId name, TraceCategoryId category);
 
 	// Record an instant event ('I')
-	void addInstantEvent(const std::string& name, const std::string& category);
+	void addInstantEvent(TraceStringId name, TraceCategoryId category, std::span<const TraceArg> args = {});
 
-	// Static accessor for current time
-	static TimePoint now() { return clock::now(); }
+	// Convenience overloads that intern on every call
+	void addBeginEvent(std::string_view name, std::string_view category, std::span<const TraceArg> args = {})
+	{
+		addBeginEvent(internName(name), internCategory(category), args);
+	}
+	void addEndEvent(std::string_view name, std::string_view category)
+	{
+		addEndEvent(internName(name), internCategory(category));
+	}
+	void addInstantEvent(std::string_view name, std::string_view category, std::span<const TraceArg> args = {})
+	{
+		addInstantEvent(internName(name), internCategory(category), args);
+	}
 
-private:
-	using time_point = clock::time_point;
+	// Record a counter sample ('C'); each name is plotted as its own track
+	void addCounterEvent(TraceStringId name, TraceCategoryId category, double value);
+	void addCounterEvent(std::string_view name, std::string_view category, double value)
+	{
+		addCounterEvent(internName(name), internCategory(category), value);
+	}
+
+	// Name the calling thread in the viewer ("thread_name" metadata) and
+	// optionally set its position among threads ("thread_sort_index").
+	// Names persist across sessions for the thread's lifetime.
+	void setThreadName(std::string_view name, std::optional<int32_t> sortIndex = std::nullopt);
+
+	// Process-unique ID for async and flow events. The recording thread's
+	// index fills the top bits and a per-thread counter the rest, so no two
+	// threads ever touch the same counter.
+	uint64_t newAsyncId();
+
+	// Async events ('b' begin, 'e' end, 'n' instant): spans that may start and
+	// finish on different threads, matched by category, name and id
+	void addAsyncBeginEvent(TraceStringId name, TraceCategoryId category, uint64_t id, std::span<const TraceArg> args = {});
+	void addAsyncEndEvent(TraceStringId name, TraceCategoryId category, uint64_t id);
+	void addAsyncInstantEvent(TraceStringId name, TraceCategoryId category, uint64_t id);
+
+	// Flow events ('s' start, 't' step, 'f' end): arrows between the slices
+	// that enclose them, linked by category, name and id
+	void addFlowStartEvent(TraceStringId name, TraceCategoryId category, uint64_t id);
+	void addFlowStepEvent(TraceStringId name, TraceCategoryId category, uint64_t id);
+	void addFlowEndEvent(TraceStringId name, TraceCategoryId category, uint64_t id);
 
-	ChromeTracer() = default;
+	void addAsyncBeginEvent(std::string_view name, std::string_view category, uint64_t id, std::span<const TraceArg> args = {})
+	{
+		addAsyncBeginEvent(internName(name), internCategory(category), id, args);
+	}
+	void addAsyncEndEvent(std::string_view name, std::string_view category, uint64_t id)
+	{
+		addAsyncEndEvent(internName(name), internCategory(category), id);
+	}
+	void addAsyncInstantEvent(std::string_view name, std::string_view category, uint64_t id)
+	{
+		addAsyncInstantEvent(internName(name), internCategory(category), id);
+	}
+	void addFlowStartEvent(std::string_view name, std::string_view category, uint64_t id)
+	{
+		addFlowStartEvent(internName(name), internCategory(category), id);
+	}
+	void addFlowStepEvent(std::string_view name, std::string_view category, uint64_t id)
+	{
+		addFlowStepEvent(internName(name), internCategory(category), id);
+	}
+	void addFlowEndEvent(std::string_view name, std::string_view category, uint64_t id)
+	{
+		addFlowEndEvent(internName(name), internCategory(category), id);
+	}
+
+	// Function instrumentation hooks (see tracer_instrument.cpp). Entry and
+	// exit are recorded as 'B'/'E' events holding only the function's
+	// address; it is resolved to a name when the trace is written.
+	static bool isInstrumenting() { return s_instrumenting.load(std::memory_order_relaxed); }
+	void addFunctionEnter(const void* function);
+	void addFunctionExit(const void* function);
+
+	// True while the running session records this category. Call sites keep
+	// the pointer and load it before reading the clock or building names.
+	const std::atomic<bool>* categoryFlag(TraceCategoryId category) const
+	{
+		return &m_categoryEnabled[category];
+	}
+	bool isCategoryEnabled(TraceCategoryId category) const
+	{
+		return m_categoryEnabled[category].load(std::memory_order_acquire);
+	}
+	TraceCategorySite categorySite(std::string_view category)
+	{
+		const TraceCategoryId id = internCategory(category);
+		return { categoryFlag(id), id };
+	}
+
+	// ScopeTrace side of TraceOptions::perfCounters. readPerfCounters()
+	// stores the calling thread's counter values and returns how many it
+	// read (0 if it has none); perfCounterArgs() turns the change since into
+	// arguments and returns how many it wrote.
+	static constexpr size_t kMaxPerfCounters = 4;
+	static bool isCountingPerf() { return s_countingPerf.load(std::memory_order_relaxed); }
+	size_t readPerfCounters(uint64_t* values);
+	size_t perfCounterArgs(const uint64_t* start, size_t count, TraceArg* args);
+
+	// Clock rate of the current session
+	Ticks ticksPerSecond() const { return m_ticksPerSecond.load(std::memory_order_relaxed); }
+
+	// Make a sampled call site's rate part of the session metadata
+	void registerSampler(TraceSampler* sampler);
+
+	// Static accessor for current time, in clock ticks. With TRACER_CLOCK_TSC
+	// this reads the CPU counter directly (rdtsc / cntvct_el0, assumed
+	// invariant and synchronized across cores); ticks are calibrated against
+	// steady_clock at beginSession and converted only at export.
+	static Ticks now()
+	{
+#if defined(TRACER_CLOCK_TSC) && defined(__aarch64__)
+		uint64_t ticks;
+		asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+		return ticks;
+#elif defined(TRACER_CLOCK_TSC)
+		return __rdtsc();
+#else
+		return static_cast<Ticks>(clock::now().time_since_epoch().count());
+#endif
+	}
+
+private:
+	ChromeTracer();
 	~ChromeTracer();
 	ChromeTracer(const ChromeTracer&) = delete;
 	ChromeTracer& operator=(const ChromeTracer&) = delete;
 
-	void addPhaseEvent(const std::string& name,
-		const std::string& category,
-		char phase);
+	void addPhaseEvent(TraceStringId name,
+		TraceCategoryId category,
+		char phase,
+		uint64_t id = 0,
+		std::span<const TraceArg> args = {});
+
+	// Events are stored per recording thread so the record path takes no lock.
+	// Each thread appends to its own chain of fixed-size chunks; the exporter
+	// walks the chains using the published per-chunk counts.
+	struct EventChunk;
+	struct ScopeStats;
+	struct ThreadBuffer;
+	struct StreamState;
+	struct MonitorState;
+	struct RotationState;
+	struct ProfileMerge;
+	struct MappedFile;
+	struct CrashDump;
+	struct PerfCounters;
+	struct Symbolizer;
+	class StringTable;
+
+	// Registers the calling thread's buffer with the tracer on first use
+	struct ThreadSlot
+	{
+		ThreadBuffer* buffer = nullptr;
+		~ThreadSlot();
+	};
+
+	ThreadBuffer* localBuffer();
+	ThreadBuffer* registerThread();
+	void record(const TraceEvent& ev, std::span<const TraceArg> args = {});
+
+	std::vector<ThreadBuffer*> buffers() const;
+	template <typename Fn>
+	void forEachChunk(Fn&& fn) const;
+	void startStreaming(std::unique_ptr<TraceExporter> live);
+	void stopStreaming(StreamState& stream);
+	void streamLoop(StreamState& stream);
+	void monitorLoop();
+	void stopMonitor();
+	void exportRotated(RotationState& rotation);
+	void finishRotation();
+	void eraseExitedBuffers(uint64_t keepSession);
+	bool openMapped(size_t bytes);
+	void armCrashDump(const std::string& filepath);
+	void addFunctionEvent(const void* function, char phase);
+	void resolveFunctionNames(std::span<TraceEvent> events, std::vector<std::string_view>& names) const;
+	void setCategoryFilter(const std::vector<std::string>& categories);
+	void updateCategoryFlag(TraceCategoryId id, std::string_view category);
+	void updateCategoryFlagLocked(TraceCategoryId id, std::string_view category);
+	TraceSessionInfo sessionInfo() const;
+	TraceOverheadInfo overheadInfo(const StreamState* stream, uint64_t session) const;
+	void calibrateRecordTicks();
+	void finishExport(TraceExporter& exporter, const TraceOverheadInfo& overhead) const;
+	bool writeToFile(const std::string& filepath, Ticks sinceTicks) const;
+	bool exportParallel(TraceExporter& exporter, std::ostream& out, const TraceSessionInfo& info, Ticks sinceTicks) const;
+	std::vector<TraceScopeStats> mergeProfile() const;
+	bool writeProfile(const std::string& filepath) const;
 
-	void writeToFile() const;
+	static thread_local ThreadSlot s_threadSlot;
+	static std::atomic<bool> s_instrumenting;    // a session is active; outlives the tracer
+	static std::atomic<bool> s_countingPerf;     // the active session reads perf counters
 
-	std::mutex m_mutex;
-	std::vector<TraceEvent> m_events;
-	time_point m_startTime;
+	std::mutex m_mutex;                          // serializes session control
+	mutable std::mutex m_buffersMutex;           // guards m_buffers
+	std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+	uint32_t m_nextThreadIndex = 0;
+	std::unique_ptr<StringTable> m_names;
+	std::unique_ptr<StringTable> m_categories;  // IDs from kTraceCalibrationCategory on unused
+	std::mutex m_categoryMutex;                  // guards m_categoryFilter and flag updates
+	std::vector<std::string> m_categoryFilter;   // empty = all
+	std::unique_ptr<std::atomic<bool>[]> m_categoryEnabled; // indexed by TraceCategoryId
+	std::atomic<uint64_t> m_session{ 0 };
+	std::atomic<bool> m_active{ false };
+	Ticks m_startTicks = 0;
+	std::chrono::steady_clock::time_point m_startTime;   // taken together with m_startTicks
+	int64_t m_clockAnchorNs = 0;                 // system clock at m_startTicks, ns since the epoch
+	uint32_t m_pid = 0;
+	std::string m_processName;
+	std::string m_hostName;
+	double m_nsPerTick = 1.0;                    // calibrated at beginSession
+	std::atomic<Ticks> m_ticksPerSecond{ 0 };
+	mutable std::mutex m_samplersMutex;          // guards m_samplers
+	std::vector<TraceSampler*> m_samplers;
+	size_t m_ringChunks = 0;                     // per-thread ring size, 0 = unbounded
+	size_t m_streamChunks = 0;                   // per-thread stream limit, 0 = not streaming
+	bool m_aggregate = false;
+	std::unique_ptr<StreamState> m_stream;
+	std::atomic<StreamState*> m_wakeStream{ nullptr };   // m_stream as record() sees it, see rotateSession()
+	std::unique_ptr<MonitorState> m_monitor;     // resource sampler, only while it runs
+	std::unique_ptr<RotationState> m_rotation;   // export of the last rotated-out session
+	std::atomic<uint64_t> m_rotatedSession{ 0 };
+	std::unique_ptr<MappedFile> m_mapped;        // mapped mode, kept until the next session begins
+	std::unique_ptr<MappedFile> m_previousMapped;
+	std::mutex m_mappedMutex;                    // guards m_mapped for setThreadName()
+	std::unique_ptr<CrashDump> m_crash;          // allocated by the first session with a crash dump
+	TraceCategoryId m_instrumentCategory = 0;
+	std::vector<TraceAddressRange> m_instrumentAllow;
+	std::vector<TraceAddressRange> m_instrumentDeny;
+	std::unique_ptr<Symbolizer> m_symbolizer;
+	std::function<std::unique_ptr<TraceExporter>()> m_makeExporter;
+	TraceCompression m_compression = TraceCompression::None;
+	TracePerfCounter m_perfCounters[kMaxPerfCounters] = {};
+	TraceStringId m_perfKeys[kMaxPerfCounters] = {};     // argument names of m_perfCounters
+	size_t m_perfCounterCount = 0;
+	double m_recordTicks[kTraceEventKinds] = {}; // calibrated cost of one event, by TraceEventKind
+	bool m_subtractOverhead = false;
+	Ticks m_lockWaitBase = 0;                    // string table lock waits before the session
 	std::string m_filepath;
-	bool m_active = false;
 };
 
 // ============================================================================
@@ -83,29 +662,345 @@ private:
 class ScopeTrace
 {
 public:
-	ScopeTrace(const std::string& name, const std::string& category = "function");
-	~ScopeTrace();
+	// Inline, so a scope that is not recorded costs the caller a compare and
+	// one that is a clock read; only recording the event is a call
+	ScopeTrace(TraceStringId name, TraceCategoryId category)
+		: m_name(name), m_category(category)
+	{
+		if (m_name != kTraceNoName)
+			start();
+	}
+	ScopeTrace(std::string_view name, std::string_view category = "function");
+
+	explicit ScopeTrace(const TraceScopeSite& site)
+		: ScopeTrace(site.category.enabled->load(std::memory_order_relaxed) ? site.name : kTraceNoName, site.category.id)
+	{
+	}
+
+	// Only calls name() — and reads the clock — if the category is enabled
+	template <typename NameFn>
+	ScopeTrace(const TraceCategorySite& category, NameFn&& name)
+		: ScopeTrace(category.enabled->load(std::memory_order_relaxed) ? name() : kTraceNoName, category.id)
+	{
+	}
+
+	// As above; args(*this) attaches arguments before the clock is read
+	template <typename NameFn, typename ArgsFn>
+	ScopeTrace(const TraceCategorySite& category, NameFn&& name, ArgsFn&& args)
+		: m_name(category.enabled->load(std::memory_order_relaxed) ? name() : kTraceNoName)
+		, m_category(category.id)
+	{
+		if (m_name == kTraceNoName)
+			return;
+		args(*this);
+		start();
+	}
+
+	~ScopeTrace()
+	{
+		if (m_name != kTraceNoName)
+			finish(ChromeTracer::now());
+	}
 
 	ScopeTrace(const ScopeTrace&) = delete;
 	ScopeTrace& operator=(const ScopeTrace&) = delete;
 
+	// Written with the event when the scope closes; ignored past kMaxArgs or
+	// when the scope is not recorded
+	void addArg(const TraceArg& arg)
+	{
+		if (m_name != kTraceNoName && m_argCount < kMaxArgs)
+			m_args[m_argCount++] = arg;
+	}
+
+	static constexpr size_t kMaxArgs = 8;
+
+private:
+	// Perf counters are read before the clock here and after it in finish(),
+	// so the duration leaves out the reads
+	void start()
+	{
+		if (ChromeTracer::isCountingPerf()) [[unlikely]]
+			m_perfCount = static_cast<uint8_t>(ChromeTracer::instance().readPerfCounters(m_perf));
+		m_start = ChromeTracer::now();
+	}
+
+	void finish(ChromeTracer::Ticks end);
+
+	TraceStringId m_name;                        // kTraceNoName when sampled out
+	TraceCategoryId m_category;
+	uint8_t m_argCount = 0;
+	uint8_t m_perfCount = 0;                     // perf counters read at entry
+	ChromeTracer::Ticks m_start = 0;
+	TraceArg m_args[kMaxArgs];                   // left uninitialized past m_argCount
+	uint64_t m_perf[ChromeTracer::kMaxPerfCounters];   // left uninitialized past m_perfCount
+};
+
+// ============================================================================
+// Span token — manual begin/end recorded as one complete event
+// ============================================================================
+
+// Returned by TRACE_SPAN_BEGIN and closed with TRACE_SPAN_END, for spans
+// that do not follow a C++ scope. Nothing is recorded at the begin; the end
+// writes a single 'X' event, so a span costs half the events of
+// TRACE_BEGIN/TRACE_END and its name cannot mismatch. End spans on the
+// thread that began them, innermost first (debug builds assert this); a
+// span that is never ended is not recorded.
+struct TraceSpan
+{
+	TraceStringId name = kTraceNoName;           // kTraceNoName when not recorded
+	TraceCategoryId category = 0;
+	ChromeTracer::Ticks start = 0;
+};
+
+// ============================================================================
+// Call-site sampling — shared state of one *_SAMPLED / *_RATE_LIMITED site
+// ============================================================================
+
+class TraceSampler
+{
+public:
+	TraceSampler(uint32_t interval, uint32_t maxPerSecond)
+		: m_interval(interval), m_maxPerSecond(maxPerSecond)
+	{
+	}
+
+	uint32_t interval() const { return m_interval; }
+	uint32_t maxPerSecond() const { return m_maxPerSecond; }
+
+	// Rate limit: true while this one-second window still has budget
+	bool admit();
+
+	// Called for every recorded event; registers the site on the first one
+	void noteRecorded(TraceStringId name);
+
+	// First name recorded at the site and, for rate-limited sites, the call
+	// and admission totals so far
+	TraceStringId name() const { return m_name; }
+	uint64_t calls() const;
+	uint64_t recorded() const;
+
 private:
-	std::string m_name;
-	std::string m_category;
-	ChromeTracer::TimePoint m_start;
+	const uint32_t m_interval;                   // 1 in interval calls, per thread
+	const uint32_t m_maxPerSecond;               // 0 = no rate limit
+	std::atomic<ChromeTracer::Ticks> m_windowStart{ 0 };
+	std::atomic<uint64_t> m_windowCalls{ 0 };
+	std::atomic<uint64_t> m_pastCalls{ 0 };      // totals of finished windows
+	std::atomic<uint64_t> m_pastRecorded{ 0 };
+	std::atomic<bool> m_registered{ false };
+	TraceStringId m_name = kTraceNoName;
 };
 
+// ============================================================================
+// Call-site interning used by the macros below
+// ============================================================================
+
+namespace tracer_detail
+{
+	// Only a string literal (or __FUNCTION__) may keep its ID in a static.
+	// The macros pass Literal = true when the argument's spelling starts with
+	// a string literal token, see TRACE_IS_LITERAL. Any other argument is
+	// interned on every call. That includes arrays, which may be refilled
+	// between calls (snprintf into a local buffer, even a const one).
+	template <bool Literal, typename T>
+	inline constexpr bool isStaticString = Literal && std::is_array_v<std::remove_cvref_t<T>>;
+
+	// Site is a unique lambda type per macro expansion, so each call site gets
+	// its own static ID and a literal is interned exactly once
+	template <typename Site, bool Literal, typename T>
+	TraceStringId nameId(Site, std::bool_constant<Literal>, const T& name)
+	{
+		if constexpr (isStaticString<Literal, T>)
+		{
+			static const TraceStringId s_id = ChromeTracer::instance().internName(name);
+			return s_id;
+		}
+		else
+		{
+			return ChromeTracer::instance().internName(name);
+		}
+	}
+
+	template <typename Site, bool Literal, typename T>
+	TraceCategoryId categoryId(Site, std::bool_constant<Literal>, const T& category)
+	{
+		if constexpr (isStaticString<Literal, T>)
+		{
+			static const TraceCategoryId s_id = ChromeTracer::instance().internCategory(category);
+			return s_id;
+		}
+		else
+		{
+			return ChromeTracer::instance().internCategory(category);
+		}
+	}
+
+	template <typename Site, bool Literal, typename T>
+	TraceCategorySite categorySite(Site, std::bool_constant<Literal>, const T& category)
+	{
+		if constexpr (isStaticString<Literal, T>)
+		{
+			static const TraceCategorySite s_site = ChromeTracer::instance().categorySite(category);
+			return s_site;
+		}
+		else
+		{
+			return ChromeTracer::instance().categorySite(category);
+		}
+	}
+
+	// TRACE_SCOPE / TRACE_FUNCTION: literal names share one static descriptor
+	// with the category; other names are interned per call, and only while
+	// the category is enabled. Returned as a prvalue, so no copy is made.
+	template <typename Site, bool Literal, typename T, size_t N>
+	ScopeTrace scope(Site, std::bool_constant<Literal>, const T& name, const char (&category)[N])
+	{
+		if constexpr (isStaticString<Literal, T>)
+		{
+			static const TraceScopeSite s_site{ ChromeTracer::instance().categorySite(category),
+				ChromeTracer::instance().internName(name) };
+			return ScopeTrace(s_site);
+		}
+		else
+		{
+			static const TraceCategorySite s_category = ChromeTracer::instance().categorySite(category);
+			return ScopeTrace(s_category, [&] { return ChromeTracer::instance().internName(name); });
+		}
+	}
+
+	// Runs fn(categoryId) only if the site's category is enabled
+	template <typename Fn>
+	void ifEnabled(const TraceCategorySite& category, Fn&& fn)
+	{
+		if (category.enabled->load(std::memory_order_relaxed))
+			fn(category.id);
+	}
+
+#if !defined(NDEBUG)
+	// Spans begun on this thread and not yet ended, innermost last
+	inline thread_local std::vector<TraceSpan> t_openSpans;
+#endif
+
+	// TRACE_SPAN_BEGIN / TRACE_SPAN_END
+	template <typename NameFn>
+	TraceSpan beginSpan(const TraceCategorySite& category, NameFn&& name)
+	{
+		if (!category.enabled->load(std::memory_order_relaxed))
+			return {};
+		const TraceSpan span{ name(), category.id, ChromeTracer::now() };
+#if !defined(NDEBUG)
+		t_openSpans.push_back(span);
+#endif
+		return span;
+	}
+
+	inline void endSpan(const TraceSpan& span)
+	{
+		if (span.name == kTraceNoName)
+			return;
+		const ChromeTracer::Ticks end = ChromeTracer::now();
+#if !defined(NDEBUG)
+		assert(!t_openSpans.empty() && t_openSpans.back().start == span.start && t_openSpans.back().name == span.name
+			&& "TRACE_SPAN_END: spans end innermost first, on the thread that began them");
+		if (!t_openSpans.empty())
+			t_openSpans.pop_back();
+#endif
+		ChromeTracer::instance().addDurationEvent(span.name, span.category, span.start, end);
+	}
+}
+
+// Two-step paste so __COUNTER__ expands first; unique even on one line
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b)       TRACE_CONCAT_INNER(a, b)
+#define TRACE_UNIQUE_NAME(prefix) TRACE_CONCAT(prefix, __COUNTER__)
+
+// std::true_type if the argument is spelled as a string literal. Decided on
+// the tokens, so a buffer is runtime however it is declared.
+#define TRACE_IS_LITERAL(x)    std::bool_constant<(#x)[0] == '"'>{}
+
+#define TRACE_NAME_ID(name)    ::tracer_detail::nameId([] {}, TRACE_IS_LITERAL(name), (name))
+#define TRACE_CATEGORY_ID(cat) ::tracer_detail::categoryId([] {}, TRACE_IS_LITERAL(cat), (cat))
+#define TRACE_CATEGORY_SITE(cat) ::tracer_detail::categorySite([] {}, TRACE_IS_LITERAL(cat), (cat))
+
+// TRACE_ARG("batch", n): typed argument with a call-site interned key
+#define TRACE_ARG(key, value)  TraceArg(TRACE_NAME_ID(key), (value))
+
+namespace tracer_detail
+{
+	// Called once the category is known to be enabled. Decides whether this
+	// call is recorded before the name is built or the clock is read, and
+	// returns kTraceNoName if not. The 1-in-N counter is per thread, so hot
+	// sites do not share a cache line.
+	template <typename Site, typename NameFn>
+	TraceStringId sampledNameId(Site, uint32_t interval, uint32_t maxPerSecond, NameFn&& name)
+	{
+		static TraceSampler s_sampler(interval, maxPerSecond);
+		static thread_local uint32_t t_calls = 0;
+
+		if (interval > 1 && t_calls++ % interval != 0)
+			return kTraceNoName;
+		if (maxPerSecond > 0 && !s_sampler.admit())
+			return kTraceNoName;
+
+		const TraceStringId id = name();
+		s_sampler.noteRecorded(id);
+		return id;
+	}
+}
+
+// Lambdas handed to ScopeTrace so the name is only built for enabled
+// categories. __FUNCTION__ is bound outside the lambda, which would
+// otherwise name operator().
+#define TRACE_NAME_FN(name) [&] { return TRACE_NAME_ID(name); }
+#define TRACE_FUNCTION_NAME_FN() [&_trace_fn = __FUNCTION__] { return ::tracer_detail::nameId([] {}, std::true_type{}, _trace_fn); }
+#define TRACE_SAMPLED_NAME_FN(nameFn, interval, perSecond) \
+	[&, _trace_name = nameFn] { return ::tracer_detail::sampledNameId([] {}, (interval), (perSecond), _trace_name); }
+
 // ============================================================================
 // Convenience macros — compile out when TRACER_DISABLED is defined
 // ============================================================================
 
 #ifndef TRACER_DISABLED
 
-#define TRACE_FUNCTION()       ScopeTrace _trace_##__LINE__(__FUNCTION__)
-#define TRACE_SCOPE(name)      ScopeTrace _trace_##__LINE__((name))
-#define TRACE_BEGIN(name, cat)  ChromeTracer::instance().addBeginEvent((name), (cat))
-#define TRACE_END(name, cat)   ChromeTracer::instance().addEndEvent((name), (cat))
-#define TRACE_INSTANT(name, cat) ChromeTracer::instance().addInstantEvent((name), (cat))
+// Argument lambdas for the *_ARGS macros: ScopeTrace calls them only when
+// the scope is recorded; phase events build a local array
+#define TRACE_SCOPE_ARGS_FN(...) [&](ScopeTrace& _trace_scope) { for (const TraceArg& _trace_arg : { __VA_ARGS__ }) _trace_scope.addArg(_trace_arg); }
+
+#define TRACE_FUNCTION()       ScopeTrace TRACE_UNIQUE_NAME(_trace_) = ::tracer_detail::scope([] {}, std::true_type{}, __FUNCTION__, "function")
+#define TRACE_SCOPE(name)      ScopeTrace TRACE_UNIQUE_NAME(_trace_) = ::tracer_detail::scope([] {}, TRACE_IS_LITERAL(name), (name), "function")
+#define TRACE_BEGIN(name, cat)  ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addBeginEvent(TRACE_NAME_ID(name), _trace_cat); })
+#define TRACE_END(name, cat)   ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addEndEvent(TRACE_NAME_ID(name), _trace_cat); })
+#define TRACE_INSTANT(name, cat) ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addInstantEvent(TRACE_NAME_ID(name), _trace_cat); })
+
+// Manual span as one 'X' event: auto span = TRACE_SPAN_BEGIN("load", "io"); ... TRACE_SPAN_END(span);
+#define TRACE_SPAN_BEGIN(name, cat)       ::tracer_detail::beginSpan(TRACE_CATEGORY_SITE(cat), TRACE_NAME_FN(name))
+#define TRACE_SPAN_END(span)              ::tracer_detail::endSpan(span)
+
+// Same as above with arguments, e.g. TRACE_SCOPE_ARGS("load", TRACE_ARG("file", path))
+#define TRACE_FUNCTION_ARGS(...)          ScopeTrace TRACE_UNIQUE_NAME(_trace_)(TRACE_CATEGORY_SITE("function"), TRACE_FUNCTION_NAME_FN(), TRACE_SCOPE_ARGS_FN(__VA_ARGS__))
+#define TRACE_SCOPE_ARGS(name, ...)       ScopeTrace TRACE_UNIQUE_NAME(_trace_)(TRACE_CATEGORY_SITE("function"), TRACE_NAME_FN(name), TRACE_SCOPE_ARGS_FN(__VA_ARGS__))
+#define TRACE_BEGIN_ARGS(name, cat, ...)  ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { const TraceArg _trace_args[] = { __VA_ARGS__ }; ChromeTracer::instance().addBeginEvent(TRACE_NAME_ID(name), _trace_cat, _trace_args); })
+#define TRACE_INSTANT_ARGS(name, cat, ...) ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { const TraceArg _trace_args[] = { __VA_ARGS__ }; ChromeTracer::instance().addInstantEvent(TRACE_NAME_ID(name), _trace_cat, _trace_args); })
+
+// Counter sample in the "counter" category, e.g. TRACE_COUNTER("queue", depth)
+#define TRACE_COUNTER(name, value)        ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE("counter"), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addCounterEvent(TRACE_NAME_ID(name), _trace_cat, static_cast<double>(value)); })
+
+// Async spans and flows across threads; ids come from TRACE_NEW_ID()
+#define TRACE_NEW_ID()                    ChromeTracer::instance().newAsyncId()
+#define TRACE_ASYNC_BEGIN(name, cat, id)  ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addAsyncBeginEvent(TRACE_NAME_ID(name), _trace_cat, (id)); })
+#define TRACE_ASYNC_END(name, cat, id)    ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addAsyncEndEvent(TRACE_NAME_ID(name), _trace_cat, (id)); })
+#define TRACE_ASYNC_INSTANT(name, cat, id) ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addAsyncInstantEvent(TRACE_NAME_ID(name), _trace_cat, (id)); })
+#define TRACE_FLOW_START(name, cat, id)   ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addFlowStartEvent(TRACE_NAME_ID(name), _trace_cat, (id)); })
+#define TRACE_FLOW_STEP(name, cat, id)    ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addFlowStepEvent(TRACE_NAME_ID(name), _trace_cat, (id)); })
+#define TRACE_FLOW_END(name, cat, id)     ::tracer_detail::ifEnabled(TRACE_CATEGORY_SITE(cat), [&](TraceCategoryId _trace_cat) { ChromeTracer::instance().addFlowEndEvent(TRACE_NAME_ID(name), _trace_cat, (id)); })
+
+// Record 1 in interval calls (per thread) or at most perSecond calls per second
+// (per site). The rates are written to the trace metadata so durations can be
+// scaled back up.
+#define TRACE_FUNCTION_SAMPLED(interval)            ScopeTrace TRACE_UNIQUE_NAME(_trace_)(TRACE_CATEGORY_SITE("function"), TRACE_SAMPLED_NAME_FN(TRACE_FUNCTION_NAME_FN(), (interval), 0))
+#define TRACE_SCOPE_SAMPLED(name, interval)         ScopeTrace TRACE_UNIQUE_NAME(_trace_)(TRACE_CATEGORY_SITE("function"), TRACE_SAMPLED_NAME_FN(TRACE_NAME_FN(name), (interval), 0))
+#define TRACE_FUNCTION_RATE_LIMITED(perSecond)      ScopeTrace TRACE_UNIQUE_NAME(_trace_)(TRACE_CATEGORY_SITE("function"), TRACE_SAMPLED_NAME_FN(TRACE_FUNCTION_NAME_FN(), 1, (perSecond)))
+#define TRACE_SCOPE_RATE_LIMITED(name, perSecond)   ScopeTrace TRACE_UNIQUE_NAME(_trace_)(TRACE_CATEGORY_SITE("function"), TRACE_SAMPLED_NAME_FN(TRACE_NAME_FN(name), 1, (perSecond)))
 
 #else
 
@@ -114,5 +1009,23 @@ private:
 #define TRACE_BEGIN(name, cat)  ((void)0)
 #define TRACE_END(name, cat)   ((void)0)
 #define TRACE_INSTANT(name, cat) ((void)0)
+#define TRACE_SPAN_BEGIN(name, cat)       (TraceSpan{})
+#define TRACE_SPAN_END(span)              ((void)sizeof(span))
+#define TRACE_FUNCTION_ARGS(...)          ((void)0)
+#define TRACE_SCOPE_ARGS(name, ...)       ((void)0)
+#define TRACE_BEGIN_ARGS(name, cat, ...)  ((void)0)
+#define TRACE_INSTANT_ARGS(name, cat, ...) ((void)0)
+#define TRACE_COUNTER(name, value)        ((void)0)
+#define TRACE_NEW_ID()                    (uint64_t(0))
+#define TRACE_ASYNC_BEGIN(name, cat, id)  ((void)0)
+#define TRACE_ASYNC_END(name, cat, id)    ((void)0)
+#define TRACE_ASYNC_INSTANT(name, cat, id) ((void)0)
+#define TRACE_FLOW_START(name, cat, id)   ((void)0)
+#define TRACE_FLOW_STEP(name, cat, id)    ((void)0)
+#define TRACE_FLOW_END(name, cat, id)     ((void)0)
+#define TRACE_FUNCTION_SAMPLED(interval)            ((void)0)
+#define TRACE_SCOPE_SAMPLED(name, interval)         ((void)0)
+#define TRACE_FUNCTION_RATE_LIMITED(perSecond)      ((void)0)
+#define TRACE_SCOPE_RATE_LIMITED(name, perSecond)   ((void)0)
 
 #endif
@@ -0,0 +1,1650 @@
+// tracer_analyze.cpp : Summarizes traces too large to open in a viewer.
+//
+//   tracer_analyze trace.json
+//   tracer_analyze -n 50 -j 16 session.tmap
+//
+// Prints the scopes with the most self time, how busy each thread was, the
+// critical path through fork/join regions (a scope during which other
+// threads started and finished, like ParallelSection in test.cpp) and
+// latency percentiles per name.
+//
+// Reads Chrome JSON as written by makeJsonExporter() or tracer_merge, and
+// mapped files and crash dumps (tracer_mapped.h). The input is mapped into
+// memory and cut into pieces that several threads scan at once: chunks for
+// mapped files, byte ranges of the event array for JSON. Each piece keeps
+// only per-name statistics and the scopes whose parent it has not seen, so
+// memory use does not grow with trace size. Perfetto protobuf is not read.
+//
+// Complete ('X') and begin/end ('B' 'E') events are measured. Nesting
+// follows the order the tracer writes them: per thread, as each scope ends.
+// A mapped file's chunks are put back in that order by the latest start
+// they hold, since a wrapped ring may have written them rotated. JSON with
+// a thread's events out of that order is rejected, unless its overhead was
+// subtracted (TraceOptions::subtractOverhead), which shortens scopes and
+// leaves nothing to check against.
+
+#include "tracer.h"
+#include "tracer_mapped.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr size_t kCandidates = 32;           // longest scopes kept per thread
+	constexpr size_t kMaxFinished = 1 << 16;     // unclaimed scopes per thread before merging
+
+	// ========================================================================
+	// Input mapping
+	// ========================================================================
+
+	// Read-only view of a whole file
+	class MappedInput
+	{
+	public:
+		MappedInput() = default;
+		MappedInput(const MappedInput&) = delete;
+		MappedInput& operator=(const MappedInput&) = delete;
+
+		~MappedInput()
+		{
+#if defined(_WIN32)
+			if (m_data)
+				UnmapViewOfFile(m_data);
+			if (m_mapping)
+				CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE)
+				CloseHandle(m_file);
+#else
+			if (m_data)
+				munmap(const_cast<char*>(m_data), m_size);
+#endif
+		}
+
+		bool open(const std::string& path)
+		{
+#if defined(_WIN32)
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+				OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size))
+				return false;
+			m_size = static_cast<size_t>(size.QuadPart);
+			if (m_size == 0)
+				return true;
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_mapping)
+				return false;
+			m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			return m_data != nullptr;
+#else
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0)
+			{
+				::close(fd);
+				return false;
+			}
+			m_size = static_cast<size_t>(st.st_size);
+			if (m_size == 0)
+			{
+				::close(fd);
+				return true;
+			}
+			void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (view == MAP_FAILED)
+				return false;
+			madvise(view, m_size, MADV_SEQUENTIAL);    // each piece is read front to back
+			m_data = static_cast<const char*>(view);
+			return true;
+#endif
+		}
+
+		const char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+	private:
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+#if defined(_WIN32)
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#endif
+	};
+
+	// ========================================================================
+	// Statistics
+	// ========================================================================
+
+	// Log-linear histogram of durations like the one behind profile(), holding
+	// only the range of buckets in use
+	class Histogram
+	{
+	public:
+		static constexpr unsigned kSubBits = 3;
+		static constexpr size_t kSubBuckets = size_t(1) << kSubBits;
+
+		void add(uint64_t value)
+		{
+			const size_t index = bucketIndex(value);
+			if (index >= m_low && index - m_low < m_counts.size())
+				++m_counts[index - m_low];
+			else
+				addBucket(index, 1);
+		}
+
+		void merge(const Histogram& other)
+		{
+			for (size_t i = 0; i < other.m_counts.size(); ++i)
+			{
+				if (other.m_counts[i] > 0)
+					addBucket(other.m_low + i, other.m_counts[i]);
+			}
+		}
+
+		// Midpoint of the bucket holding the value of rank q * count
+		double quantile(double q, uint64_t count) const
+		{
+			const auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+			uint64_t seen = 0;
+			for (size_t i = 0; i < m_counts.size(); ++i)
+			{
+				seen += m_counts[i];
+				if (seen > rank)
+					return bucketValue(m_low + i);
+			}
+			return m_counts.empty() ? 0.0 : bucketValue(m_low + m_counts.size() - 1);
+		}
+
+	private:
+		static size_t bucketIndex(uint64_t value)
+		{
+			if (value < kSubBuckets)
+				return static_cast<size_t>(value);
+			const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - kSubBits;
+			return (shift + 1) * kSubBuckets + static_cast<size_t>((value >> shift) & (kSubBuckets - 1));
+		}
+
+		static double bucketValue(size_t index)
+		{
+			if (index < kSubBuckets)
+				return static_cast<double>(index);
+			const unsigned shift = static_cast<unsigned>(index / kSubBuckets) - 1;
+			const double low = static_cast<double>((kSubBuckets + index % kSubBuckets) << shift);
+			return low + static_cast<double>(uint64_t(1) << shift) / 2.0;
+		}
+
+		void addBucket(size_t index, uint64_t n)
+		{
+			if (m_counts.empty())
+			{
+				m_low = index;
+				m_counts.push_back(0);
+			}
+			else if (index < m_low)
+			{
+				m_counts.insert(m_counts.begin(), m_low - index, 0);
+				m_low = index;
+			}
+			else if (index - m_low >= m_counts.size())
+				m_counts.resize(index - m_low + 1, 0);
+			m_counts[index - m_low] += n;
+		}
+
+		size_t m_low = 0;
+		std::vector<uint64_t> m_counts;
+	};
+
+	// Durations are in ticks for mapped files and nanoseconds for JSON
+	struct NameStats
+	{
+		uint64_t count = 0;
+		uint64_t total = 0;
+		int64_t self = 0;                        // total minus direct children; signed while
+		                                         // pieces are joined
+		uint64_t min = UINT64_MAX;
+		uint64_t max = 0;
+		Histogram durations;
+
+		void add(uint64_t duration, int64_t selfTime)
+		{
+			++count;
+			total += duration;
+			self += selfTime;
+			min = std::min(min, duration);
+			max = std::max(max, duration);
+			durations.add(duration);
+		}
+
+		void merge(const NameStats& other)
+		{
+			count += other.count;
+			total += other.total;
+			self += other.self;
+			min = std::min(min, other.min);
+			max = std::max(max, other.max);
+			durations.merge(other.durations);
+		}
+	};
+
+	struct TextHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+	};
+
+	// Names seen by one worker, numbered locally and joined by their text
+	class Names
+	{
+	public:
+		// A string table entry with a null data pointer is missing from the
+		// file and shown as "#<id>"
+		uint32_t fromId(TraceStringId id, std::span<const std::string_view> strings)
+		{
+			if (id < m_byId.size() && m_byId[id] != kNone)
+				return m_byId[id];
+			if (id >= m_byId.size())
+				m_byId.resize(size_t(id) + 1, kNone);
+			const std::string_view text = id < strings.size() ? strings[id] : std::string_view();
+			m_byId[id] = text.data() ? fromText(text) : fromText("#" + std::to_string(id));
+			return m_byId[id];
+		}
+
+		// Function instrumentation events are named by their address
+		uint32_t fromAddress(uint64_t address)
+		{
+			auto [it, added] = m_byAddress.try_emplace(address, 0);
+			if (added)
+			{
+				char hex[2 + 16] = { '0', 'x' };
+				const auto result = std::to_chars(hex + 2, hex + sizeof(hex), address, 16);
+				it->second = fromText(std::string_view(hex, static_cast<size_t>(result.ptr - hex)));
+			}
+			return it->second;
+		}
+
+		uint32_t fromText(std::string_view text)
+		{
+			if (const auto it = m_byText.find(text); it != m_byText.end())
+				return it->second;
+			const auto id = static_cast<uint32_t>(m_texts.size());
+			m_texts.emplace_back(text);
+			m_byText.emplace(m_texts.back(), id);
+			return id;
+		}
+
+		const std::string& text(uint32_t id) const { return m_texts[id]; }
+		size_t size() const { return m_texts.size(); }
+
+	private:
+		static constexpr uint32_t kNone = UINT32_MAX;
+
+		std::vector<uint32_t> m_byId;
+		std::unordered_map<uint64_t, uint32_t> m_byAddress;
+		std::unordered_map<std::string, uint32_t, TextHash, std::equal_to<>> m_byText;
+		std::vector<std::string> m_texts;
+	};
+
+	// ========================================================================
+	// Segments
+	// ========================================================================
+
+	// A scope on a thread that no parent has claimed yet, or a run of such
+	// neighbours merged to bound memory (busy < end - start)
+	struct Finished
+	{
+		int64_t start;
+		int64_t end;
+		uint64_t busy;
+	};
+
+	// A 'B' event still waiting for its 'E'
+	struct Open
+	{
+		int64_t start;
+		uint32_t name;
+	};
+
+	// One of the longest scopes on a thread, a possible fork/join region
+	struct Candidate
+	{
+		int64_t start;
+		int64_t end;
+		uint32_t name;
+	};
+
+	// What a segment could not resolve by itself, replayed in order on top of
+	// the thread's earlier segments by joinThreads()
+	struct Boundary
+	{
+		enum Kind : uint32_t
+		{
+			Claim,                               // a scope that may enclose earlier segments' scopes
+			End,                                 // an 'E' whose 'B' came in an earlier segment
+		};
+
+		Kind kind;
+		uint32_t name;                           // Claim: the scope, in worker names
+		int64_t start;                           // Claim: scope start; End: first claimed start
+		int64_t end;                             // End: last claimed end
+		int64_t time;                            // End: 'E' timestamp
+		uint64_t claimed;                        // End: busy time claimed within the segment
+	};
+
+	// Claims the finished scopes a parent starting at start encloses;
+	// returns their busy time
+	uint64_t claim(std::vector<Finished>& finished, int64_t start)
+	{
+		uint64_t claimed = 0;
+		while (!finished.empty() && finished.back().start >= start)
+		{
+			claimed += finished.back().busy;
+			finished.pop_back();
+		}
+		return claimed;
+	}
+
+	// Once full, neighbours in the older half are merged pairwise. A parent
+	// that starts inside such a run then counts that part of it as self time.
+	void pushFinished(std::vector<Finished>& finished, const Finished& scope)
+	{
+		if (finished.size() >= kMaxFinished)
+		{
+			const size_t half = finished.size() / 2;
+			size_t out = 0;
+			for (size_t i = 0; i + 1 < half; i += 2)
+				finished[out++] = { finished[i].start, finished[i + 1].end, finished[i].busy + finished[i + 1].busy };
+			if (half % 2 != 0)
+				finished[out++] = finished[half - 1];
+			for (size_t i = half; i < finished.size(); ++i)
+				finished[out++] = finished[i];
+			finished.resize(out);
+		}
+		finished.push_back(scope);
+	}
+
+	// Min-heap on duration, holding the kCandidates longest
+	void addCandidate(std::vector<Candidate>& heap, const Candidate& scope)
+	{
+		const auto longer = [](const Candidate& a, const Candidate& b) {
+			return a.end - a.start > b.end - b.start;
+		};
+		if (heap.size() < kCandidates)
+		{
+			heap.push_back(scope);
+			std::push_heap(heap.begin(), heap.end(), longer);
+		}
+		else if (scope.end - scope.start > heap.front().end - heap.front().start)
+		{
+			std::pop_heap(heap.begin(), heap.end(), longer);
+			heap.back() = scope;
+			std::push_heap(heap.begin(), heap.end(), longer);
+		}
+	}
+
+	struct Worker;
+
+	// Consecutive events of one thread, scanned by one worker. Nesting is
+	// resolved as far as the segment reaches; what depends on earlier events
+	// is left in its boundaries, finished scopes and open 'B' events.
+	class Segment
+	{
+	public:
+		Segment(uint64_t thread, uint64_t order)
+			: thread(thread), order(order)
+		{
+		}
+
+		void complete(Worker& worker, int64_t start, int64_t end, uint32_t name)
+		{
+			note(start, end);
+			finish(worker, start, end, name);
+		}
+
+		void begin(int64_t time, uint32_t name)
+		{
+			note(time, time);
+			open.push_back({ time, name });
+		}
+
+		void end(Worker& worker, int64_t time)
+		{
+			note(time, time);
+			if (!open.empty())
+			{
+				const Open scope = open.back();
+				open.pop_back();
+				finish(worker, scope.start, time, scope.name);
+				return;
+			}
+
+			// Began before the segment, so it encloses all scopes finished here
+			Boundary boundary{ Boundary::End, 0, time, time, time, 0 };
+			if (!finished.empty())
+			{
+				boundary.start = finished.front().start;
+				boundary.end = finished.back().end;
+			}
+			for (const Finished& scope : finished)
+				boundary.claimed += scope.busy;
+			finished.clear();
+			boundaries.push_back(boundary);
+		}
+
+		int64_t firstEnd() const { return m_firstEnd; }
+
+		uint64_t thread;                         // pid << 32 | tid
+		uint64_t order;                          // position among the thread's segments
+		uint64_t events = 0;
+		int64_t first = 0;                       // earliest start
+		int64_t last = 0;                        // latest end
+		int64_t written = INT64_MIN;             // JSON: when the latest event was written, see JsonTrace
+		std::vector<Boundary> boundaries;
+		std::vector<Finished> finished;
+		std::vector<Open> open;
+		std::vector<Candidate> candidates;
+
+	private:
+		void note(int64_t start, int64_t end)
+		{
+			if (events++ == 0)
+			{
+				first = start;
+				last = end;
+				m_firstEnd = end;
+				return;
+			}
+			first = std::min(first, start);
+			last = std::max(last, end);
+		}
+
+		void finish(Worker& worker, int64_t start, int64_t end, uint32_t name);
+
+		// Scopes of earlier segments all ended by the time this one's first
+		// event was recorded, so only scopes starting before then can claim them
+		int64_t m_firstEnd = 0;
+	};
+
+	struct Worker
+	{
+		Names names;
+		std::vector<NameStats> stats;            // by worker name
+		std::vector<Segment> segments;
+		std::unordered_map<uint64_t, std::pair<uint64_t, std::string>> threadNames;   // thread: (order, name)
+
+		NameStats& statsFor(uint32_t name)
+		{
+			if (name >= stats.size())
+				stats.resize(size_t(name) + 1);
+			return stats[name];
+		}
+	};
+
+	void Segment::finish(Worker& worker, int64_t start, int64_t end, uint32_t name)
+	{
+		const uint64_t duration = static_cast<uint64_t>(std::max<int64_t>(end - start, 0));
+		const uint64_t claimed = claim(finished, start);
+		worker.statsFor(name).add(duration, static_cast<int64_t>(duration - claimed));
+		if (finished.empty() && start <= m_firstEnd)
+			boundaries.push_back({ Boundary::Claim, name, start, 0, 0, 0 });
+		pushFinished(finished, { start, end, duration });
+		addCandidate(candidates, { start, end, name });
+	}
+
+	// Hands out body(index, worker) calls for [0, count) to all workers
+	template <typename Body>
+	void parallelFor(size_t count, std::vector<Worker>& workers, Body body)
+	{
+		std::atomic<size_t> next{ 0 };
+		const auto run = [&](Worker& worker) {
+			for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+				body(i, worker);
+		};
+		std::vector<std::thread> threads;
+		for (size_t w = 1; w < workers.size(); ++w)
+			threads.emplace_back(run, std::ref(workers[w]));
+		run(workers[0]);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// ========================================================================
+	// Mapped files
+	// ========================================================================
+
+	class MappedTrace
+	{
+	public:
+		bool open(const MappedInput& input, std::string& error)
+		{
+			m_data = input.data();
+			m_size = input.size();
+			if (m_size < sizeof(m_header))
+			{
+				error = "truncated header";
+				return false;
+			}
+			std::memcpy(&m_header, m_data, sizeof(m_header));
+			if (m_header.version != TraceMappedHeader::kVersion
+				|| m_header.eventBytes != sizeof(TraceEvent) || m_header.argBytes != sizeof(TraceArg)
+				|| (m_header.countBytes != 4 && m_header.countBytes != 8))
+			{
+				error = "written by an incompatible tracer version or architecture";
+				return false;
+			}
+			const size_t eventsEnd = m_header.eventsOffset + size_t(m_header.chunkEvents) * sizeof(TraceEvent);
+			if (eventsEnd > m_header.chunkBytes || m_header.countOffset + m_header.countBytes > m_header.chunkBytes)
+			{
+				error = "invalid chunk layout";
+				return false;
+			}
+			if (m_header.threadsOffset + m_header.threadCapacity * sizeof(TraceMappedThread) > m_size)
+			{
+				error = "truncated thread table";
+				return false;
+			}
+			m_threads.resize(m_header.threadCapacity);
+			std::memcpy(m_threads.data(), m_data + m_header.threadsOffset, m_threads.size() * sizeof(TraceMappedThread));
+
+			const uint64_t stringsUsed = std::min(m_header.stringsUsed, m_header.stringsBytes);
+			if (m_header.stringsOffset + stringsUsed > m_size)
+			{
+				error = "truncated string table";
+				return false;
+			}
+			const char* strings = m_data + m_header.stringsOffset;
+			for (size_t offset = 0; offset + sizeof(TraceMappedString) <= stringsUsed; )
+			{
+				TraceMappedString entry;
+				std::memcpy(&entry, strings + offset, sizeof(entry));
+				const size_t end = offset + sizeof(entry) + entry.length;
+				if (end > stringsUsed)
+					break;
+				if (entry.table == TraceMappedString::Name)
+				{
+					if (entry.id >= m_names.size())
+						m_names.resize(size_t(entry.id) + 1);
+					m_names[entry.id] = std::string_view(strings + offset + sizeof(entry), entry.length);
+				}
+				offset = (end + 3) & ~size_t(3);
+			}
+
+			// Chunks cut off by the end of the file (a crash dump still being written) are left out
+			const uint64_t available = m_size > m_header.chunksOffset ? (m_size - m_header.chunksOffset) / m_header.chunkBytes : 0;
+			m_chunks = std::min({ m_header.chunksUsed, m_header.chunkCapacity, available });
+			return true;
+		}
+
+		double nsPerTick() const { return m_header.nsPerTick; }
+		bool closed() const { return m_header.state == TraceMappedHeader::Closed; }
+
+		std::unordered_map<uint64_t, std::string> threadNames() const
+		{
+			std::unordered_map<uint64_t, std::string> names;
+			for (size_t i = 0; i < m_threads.size(); ++i)
+			{
+				if (!(m_threads[i].flags & TraceMappedThread::kNamed))
+					continue;
+				const TraceStringId name = m_threads[i].name;
+				names[threadKey(static_cast<uint32_t>(i))] = name < m_names.size() && m_names[name].data()
+					? std::string(m_names[name]) : "#" + std::to_string(name);
+			}
+			return names;
+		}
+
+		// One pass to find each chunk's thread and latest start, then runs of
+		// a thread's chunks (in the order the thread filled them) as segments.
+		// Starts are never shortened like durations, and a later chunk holds
+		// a later start unless all its scopes enclose the earlier one's.
+		void scan(std::vector<Worker>& workers)
+		{
+			constexpr uint32_t kEmpty = UINT32_MAX;
+			std::vector<uint32_t> owners(m_chunks);
+			std::vector<uint64_t> latest(m_chunks);
+			constexpr size_t kBlock = 4096;
+			parallelFor((m_chunks + kBlock - 1) / kBlock, workers, [&](size_t block, Worker&) {
+				const uint64_t end = std::min<uint64_t>((block + 1) * kBlock, m_chunks);
+				for (uint64_t i = block * kBlock; i < end; ++i)
+				{
+					const uint64_t count = eventCount(i);
+					owners[i] = kEmpty;
+					for (uint64_t e = 0; e < count; ++e)
+					{
+						TraceEvent ev;
+						std::memcpy(&ev, chunk(i) + m_header.eventsOffset + e * sizeof(TraceEvent), sizeof(ev));
+						owners[i] = ev.thread;
+						latest[i] = std::max(latest[i], ev.timestamp);
+					}
+				}
+			});
+
+			std::unordered_map<uint32_t, std::vector<uint64_t>> byThread;
+			uint64_t used = 0;
+			for (uint64_t i = 0; i < m_chunks; ++i)
+			{
+				if (owners[i] == kEmpty)
+					continue;
+				byThread[owners[i]].push_back(i);
+				++used;
+			}
+			for (auto& [thread, chunks] : byThread)
+			{
+				std::stable_sort(chunks.begin(), chunks.end(), [&](uint64_t a, uint64_t b) {
+					return latest[a] < latest[b];
+				});
+			}
+
+			struct Task
+			{
+				uint32_t thread;
+				uint64_t order;
+				std::span<const uint64_t> chunks;
+			};
+			std::vector<Task> tasks;
+			const size_t piece = std::max<size_t>(16, used / (workers.size() * 8) + 1);
+			for (const auto& [thread, chunks] : byThread)
+			{
+				for (size_t first = 0; first < chunks.size(); first += piece)
+				{
+					const size_t count = std::min(piece, chunks.size() - first);
+					tasks.push_back({ thread, first, std::span<const uint64_t>(chunks).subspan(first, count) });
+				}
+			}
+
+			parallelFor(tasks.size(), workers, [&](size_t index, Worker& worker) {
+				const Task& task = tasks[index];
+				Segment& segment = worker.segments.emplace_back(threadKey(task.thread), task.order);
+				for (const uint64_t i : task.chunks)
+					scanChunk(worker, segment, i);
+			});
+		}
+
+	private:
+		uint64_t threadKey(uint32_t thread) const
+		{
+			return uint64_t(m_header.pid) << 32 | thread;
+		}
+
+		const char* chunk(uint64_t index) const
+		{
+			return m_data + m_header.chunksOffset + index * m_header.chunkBytes;
+		}
+
+		uint64_t eventCount(uint64_t index) const
+		{
+			const char* count = chunk(index) + m_header.countOffset;
+			uint64_t value;
+			if (m_header.countBytes == 4)
+			{
+				uint32_t narrow;
+				std::memcpy(&narrow, count, sizeof(narrow));
+				value = narrow;
+			}
+			else
+				std::memcpy(&value, count, sizeof(value));
+			return std::min<uint64_t>(value, m_header.chunkEvents);
+		}
+
+		void scanChunk(Worker& worker, Segment& segment, uint64_t index) const
+		{
+			const char* events = chunk(index) + m_header.eventsOffset;
+			const uint64_t count = eventCount(index);
+			for (uint64_t e = 0; e < count; ++e)
+			{
+				TraceEvent ev;
+				std::memcpy(&ev, events + e * sizeof(TraceEvent), sizeof(ev));
+				const auto time = static_cast<int64_t>(ev.timestamp - m_header.startTicks);
+				switch (ev.phase)
+				{
+				case 'X':
+					segment.complete(worker, time, time + static_cast<int64_t>(ev.duration), name(worker, ev));
+					break;
+				case 'B':
+					segment.begin(time, name(worker, ev));
+					break;
+				case 'E':
+					segment.end(worker, time);
+					break;
+				}
+			}
+		}
+
+		uint32_t name(Worker& worker, const TraceEvent& ev) const
+		{
+			if (ev.name == kTraceAddressName)
+				return worker.names.fromAddress(ev.id);
+			return worker.names.fromId(ev.name, m_names);
+		}
+
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+		TraceMappedHeader m_header{};
+		std::vector<TraceMappedThread> m_threads;
+		std::vector<std::string_view> m_names;   // views into the file
+		uint64_t m_chunks = 0;
+	};
+
+	// ========================================================================
+	// Chrome JSON
+	// ========================================================================
+
+	struct JsonEvent
+	{
+		std::string_view name;                   // escaped as in the file
+		std::string_view argName;                // args.name, for metadata events
+		char phase = 0;
+		int64_t ts = 0;                          // nanoseconds
+		int64_t dur = 0;
+		int64_t pid = 0;
+		int64_t tid = 0;
+	};
+
+	// Just enough of a parser for one trace event at a time
+	class JsonCursor
+	{
+	public:
+		JsonCursor(const char* pos, const char* end)
+			: m_pos(pos), m_end(end)
+		{
+		}
+
+		const char* pos() const { return m_pos; }
+
+		void skipSpace()
+		{
+			while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+				++m_pos;
+		}
+
+		bool consume(char c)
+		{
+			if (m_pos < m_end && *m_pos == c)
+			{
+				++m_pos;
+				return true;
+			}
+			return false;
+		}
+
+		bool readEvent(JsonEvent& ev)
+		{
+			ev = {};
+			if (!consume('{'))
+				return false;
+			skipSpace();
+			if (consume('}'))
+				return true;
+			for (;;)
+			{
+				std::string_view key;
+				skipSpace();
+				if (!readString(key))
+					return false;
+				skipSpace();
+				if (!consume(':'))
+					return false;
+				skipSpace();
+
+				bool ok = true;
+				if (key == "name")
+					ok = readString(ev.name);
+				else if (key == "ph")
+				{
+					std::string_view phase;
+					ok = readString(phase);
+					ev.phase = phase.empty() ? '\0' : phase[0];
+				}
+				else if (key == "ts")
+					ok = readMicros(ev.ts);
+				else if (key == "dur")
+					ok = readMicros(ev.dur);
+				else if (key == "pid")
+					ok = readId(ev.pid);
+				else if (key == "tid")
+					ok = readId(ev.tid);
+				else if (key == "args")
+					ok = readArgs(ev.argName);
+				else
+					ok = skipValue();
+				if (!ok)
+					return false;
+
+				skipSpace();
+				if (consume(','))
+					continue;
+				return consume('}');
+			}
+		}
+
+	private:
+		// The raw text between the quotes, escapes left in
+		bool readString(std::string_view& text)
+		{
+			if (!consume('"'))
+				return false;
+			const char* begin = m_pos;
+			while (m_pos < m_end)
+			{
+				if (*m_pos == '"')
+				{
+					text = std::string_view(begin, static_cast<size_t>(m_pos - begin));
+					++m_pos;
+					return true;
+				}
+				m_pos += *m_pos == '\\' ? 2 : 1;
+			}
+			return false;
+		}
+
+		std::string_view readToken()
+		{
+			const char* begin = m_pos;
+			while (m_pos < m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']'
+				&& *m_pos != ' ' && *m_pos != '\n' && *m_pos != '\r' && *m_pos != '\t')
+				++m_pos;
+			return std::string_view(begin, static_cast<size_t>(m_pos - begin));
+		}
+
+		// Microseconds with a fraction, as the exporter writes them
+		bool readMicros(int64_t& ns)
+		{
+			const std::string_view text = readToken();
+			if (text.find_first_of("eE") != std::string_view::npos)
+			{
+				double micros = 0.0;
+				if (std::from_chars(text.data(), text.data() + text.size(), micros).ec != std::errc())
+					return false;
+				ns = std::llround(micros * 1000.0);
+				return true;
+			}
+
+			size_t i = 0;
+			const bool negative = !text.empty() && text[0] == '-';
+			if (negative)
+				++i;
+			int64_t value = 0;
+			const size_t digits = i;
+			for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i)
+				value = value * 10 + (text[i] - '0');
+			if (i == digits)
+				return false;
+			int fraction = 0;
+			if (i < text.size() && text[i] == '.')
+			{
+				for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i)
+				{
+					if (fraction++ < 3)
+						value = value * 10 + (text[i] - '0');
+				}
+			}
+			if (i != text.size())
+				return false;
+			for (; fraction < 3; ++fraction)
+				value *= 10;
+			ns = negative ? -value : value;
+			return true;
+		}
+
+		// Numbers as written by the tracer; other tools' string IDs are hashed
+		bool readId(int64_t& id)
+		{
+			if (m_pos < m_end && *m_pos == '"')
+			{
+				std::string_view text;
+				if (!readString(text))
+					return false;
+				id = static_cast<int64_t>(std::hash<std::string_view>{}(text) & 0x7fffffff);
+				return true;
+			}
+			const std::string_view text = readToken();
+			return std::from_chars(text.data(), text.data() + text.size(), id).ec == std::errc();
+		}
+
+		bool readArgs(std::string_view& name)
+		{
+			if (!consume('{'))
+				return skipValue();
+			skipSpace();
+			if (consume('}'))
+				return true;
+			for (;;)
+			{
+				std::string_view key;
+				skipSpace();
+				if (!readString(key))
+					return false;
+				skipSpace();
+				if (!consume(':'))
+					return false;
+				skipSpace();
+				const bool ok = key == "name" && m_pos < m_end && *m_pos == '"' ? readString(name) : skipValue();
+				if (!ok)
+					return false;
+				skipSpace();
+				if (consume(','))
+					continue;
+				return consume('}');
+			}
+		}
+
+		bool skipValue()
+		{
+			if (m_pos >= m_end)
+				return false;
+			std::string_view ignored;
+			switch (*m_pos)
+			{
+			case '"':
+				return readString(ignored);
+			case '{':
+			case '[':
+			{
+				const char close = *m_pos == '{' ? '}' : ']';
+				++m_pos;
+				skipSpace();
+				if (consume(close))
+					return true;
+				for (;;)
+				{
+					skipSpace();
+					if (close == '}')
+					{
+						if (!readString(ignored))
+							return false;
+						skipSpace();
+						if (!consume(':'))
+							return false;
+						skipSpace();
+					}
+					if (!skipValue())
+						return false;
+					skipSpace();
+					if (consume(','))
+						continue;
+					return consume(close);
+				}
+			}
+			default:
+				return !readToken().empty();
+			}
+		}
+
+		const char* m_pos;
+		const char* m_end;
+	};
+
+	// The "traceEvents" array is cut into byte ranges at event boundaries,
+	// one segment per range and thread
+	class JsonTrace
+	{
+	public:
+		bool open(const MappedInput& input, std::string& error)
+		{
+			m_text = std::string_view(input.data(), input.size());
+			const size_t key = m_text.find("\"traceEvents\"");
+			const size_t array = key == std::string_view::npos ? key : m_text.find('[', key);
+			if (array == std::string_view::npos)
+			{
+				error = "no \"traceEvents\" array";
+				return false;
+			}
+
+			// The members after the array may hold arrays of their own
+			size_t end = std::string_view::npos;
+			const size_t metadata = m_text.rfind("\"metadata\"");
+			if (metadata != std::string_view::npos && metadata > array)
+				end = m_text.find_last_not_of(", \n\r\t", metadata - 1);
+			if (end == std::string_view::npos || m_text[end] != ']')
+				end = m_text.rfind(']');
+			if (end == std::string_view::npos || end <= array)
+			{
+				error = "unterminated \"traceEvents\" array";
+				return false;
+			}
+			m_begin = m_text.find_first_not_of(" \n\r\t", array + 1);
+			m_end = end;
+			m_checkOrder = m_text.find("\"subtracted\":true", m_end) == std::string_view::npos;
+			return true;
+		}
+
+		// Fails if a cut landed inside a string that looked like an event boundary
+		bool scan(std::vector<Worker>& workers, std::string& error)
+		{
+			const size_t pieces = workers.size() == 1 ? 1 : workers.size() * 8;
+			std::vector<size_t> cuts{ m_begin };
+			for (size_t i = 1; i < pieces; ++i)
+				cuts.push_back(nextEvent(std::max(cuts.back(), m_begin + (m_end - m_begin) / pieces * i)));
+			cuts.push_back(m_end);
+
+			std::vector<size_t> failed(pieces, SIZE_MAX);
+			std::vector<size_t> disordered(pieces, SIZE_MAX);
+			parallelFor(pieces, workers, [&](size_t index, Worker& worker) {
+				failed[index] = scanRange(worker, index, cuts[index], cuts[index + 1], disordered[index]);
+			});
+			for (const size_t offset : failed)
+			{
+				if (offset == SIZE_MAX)
+					continue;
+				error = "malformed event at byte " + std::to_string(offset);
+				if (pieces > 1)
+					error += "; if the file is valid JSON, retry with -j 1";
+				return false;
+			}
+			for (const size_t offset : disordered)
+			{
+				if (offset == SIZE_MAX)
+					continue;
+				error = "event at byte " + std::to_string(offset) + " was written before the one ahead of it on its thread";
+				return false;
+			}
+			if (!inOrder(workers))
+			{
+				error = "events of a thread are out of the order they were written in";
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		// Start of the first event after offset, given the exporter's "},{"
+		// (or "},\n{" from tracer_merge) between events
+		size_t nextEvent(size_t offset) const
+		{
+			while ((offset = m_text.find('}', offset)) < m_end)
+			{
+				size_t next = m_text.find_first_not_of(" \n\r\t", offset + 1);
+				if (next < m_end && m_text[next] == ',')
+				{
+					next = m_text.find_first_not_of(" \n\r\t", next + 1);
+					if (next < m_end && m_text[next] == '{')
+					{
+						const size_t quote = m_text.find_first_not_of(" \n\r\t", next + 1);
+						if (quote < m_end && m_text[quote] == '"')
+							return next;
+					}
+				}
+				++offset;
+			}
+			return m_end;
+		}
+
+		// Each thread's events are written as their time comes: a complete
+		// event at its end, 'B' and 'E' at their timestamp. The exporter
+		// rounds ts and dur to nanoseconds each.
+		static constexpr int64_t kRoundingSlack = 2;
+
+		static int64_t writeTime(const JsonEvent& ev)
+		{
+			return ev.phase == 'X' ? ev.ts + ev.dur : ev.ts;
+		}
+
+		// Each range's segments start no earlier than the thread's segments
+		// before them ended
+		bool inOrder(const std::vector<Worker>& workers) const
+		{
+			if (!m_checkOrder)
+				return true;
+			std::vector<const Segment*> segments;
+			for (const Worker& worker : workers)
+			{
+				for (const Segment& segment : worker.segments)
+					segments.push_back(&segment);
+			}
+			std::sort(segments.begin(), segments.end(), [](const Segment* a, const Segment* b) {
+				return a->thread != b->thread ? a->thread < b->thread : a->order < b->order;
+			});
+			for (size_t i = 1; i < segments.size(); ++i)
+			{
+				if (segments[i]->thread == segments[i - 1]->thread
+					&& segments[i]->firstEnd() + kRoundingSlack < segments[i - 1]->written)
+					return false;
+			}
+			return true;
+		}
+
+		// Returns SIZE_MAX, or the offset where parsing failed. Sets disorder
+		// to the offset of an event written before its predecessor, if any.
+		size_t scanRange(Worker& worker, size_t index, size_t begin, size_t end, size_t& disorder)
+		{
+			std::unordered_map<uint64_t, size_t> segments;   // thread: index in worker.segments
+			JsonCursor cursor(m_text.data() + begin, m_text.data() + m_end);
+			const char* const stop = m_text.data() + end;
+			JsonEvent ev;
+			while (cursor.pos() < stop)
+			{
+				const char* const start = cursor.pos();
+				if (!cursor.readEvent(ev))
+					return static_cast<size_t>(cursor.pos() - m_text.data());
+				cursor.skipSpace();
+				if (cursor.consume(','))
+					cursor.skipSpace();
+				else if (cursor.pos() != m_text.data() + m_end)
+					return static_cast<size_t>(cursor.pos() - m_text.data());
+
+				const uint64_t thread = uint64_t(static_cast<uint32_t>(ev.pid)) << 32 | static_cast<uint32_t>(ev.tid);
+				if (ev.phase == 'M')
+				{
+					if (ev.name == "thread_name")
+						worker.threadNames[thread] = { index, std::string(ev.argName) };
+					continue;
+				}
+				if (ev.phase != 'X' && ev.phase != 'B' && ev.phase != 'E')
+					continue;
+
+				auto [it, added] = segments.try_emplace(thread, worker.segments.size());
+				if (added)
+					worker.segments.emplace_back(thread, index);
+				Segment& segment = worker.segments[it->second];
+				const int64_t written = writeTime(ev);
+				if (m_checkOrder && written + kRoundingSlack < segment.written && disorder == SIZE_MAX)
+					disorder = static_cast<size_t>(start - m_text.data());
+				segment.written = std::max(segment.written, written);
+				if (ev.phase == 'X')
+					segment.complete(worker, ev.ts, ev.ts + ev.dur, worker.names.fromText(ev.name));
+				else if (ev.phase == 'B')
+					segment.begin(ev.ts, worker.names.fromText(ev.name));
+				else
+					segment.end(worker, ev.ts);
+			}
+			return cursor.pos() == stop ? SIZE_MAX : static_cast<size_t>(cursor.pos() - m_text.data());
+		}
+
+		std::string_view m_text;
+		size_t m_begin = 0;                      // first event
+		size_t m_end = 0;                        // the array's closing bracket
+		bool m_checkOrder = true;                // false once overhead subtraction shortened scopes
+	};
+
+	// ========================================================================
+	// Joining
+	// ========================================================================
+
+	struct ThreadSummary
+	{
+		uint64_t thread = 0;
+		std::string name;
+		uint64_t events = 0;
+		int64_t first = INT64_MAX;
+		int64_t last = INT64_MIN;
+		uint64_t busy = 0;                       // time in top-level scopes
+		std::vector<Candidate> candidates;       // global names
+	};
+
+	struct Summary
+	{
+		std::vector<std::string> names;
+		std::vector<NameStats> stats;            // by global name
+		std::vector<ThreadSummary> threads;
+		uint64_t events = 0;
+		uint64_t unfinished = 0;                 // 'B' events without an 'E'
+		int64_t first = INT64_MAX;
+		int64_t last = INT64_MIN;
+	};
+
+	// Merges the workers' statistics by name, then replays each thread's
+	// segments in order to settle what they left open
+	Summary joinThreads(std::vector<Worker>& workers, const std::unordered_map<uint64_t, std::string>& threadNames)
+	{
+		Summary summary;
+		std::unordered_map<std::string_view, uint32_t> byText;
+		std::vector<std::vector<uint32_t>> global(workers.size());
+		for (size_t w = 0; w < workers.size(); ++w)
+		{
+			global[w].resize(workers[w].names.size());
+			for (uint32_t local = 0; local < workers[w].names.size(); ++local)
+			{
+				const std::string& text = workers[w].names.text(local);
+				auto [it, added] = byText.try_emplace(text, static_cast<uint32_t>(summary.names.size()));
+				if (added)
+					summary.names.push_back(text);
+				global[w][local] = it->second;
+			}
+		}
+		summary.stats.resize(summary.names.size());
+		for (size_t w = 0; w < workers.size(); ++w)
+		{
+			for (size_t local = 0; local < workers[w].stats.size(); ++local)
+				summary.stats[global[w][local]].merge(workers[w].stats[local]);
+		}
+
+		struct Piece
+		{
+			Segment* segment;
+			size_t worker;
+		};
+		std::vector<Piece> pieces;
+		for (size_t w = 0; w < workers.size(); ++w)
+		{
+			for (Segment& segment : workers[w].segments)
+				pieces.push_back({ &segment, w });
+		}
+		std::sort(pieces.begin(), pieces.end(), [](const Piece& a, const Piece& b) {
+			return a.segment->thread != b.segment->thread ? a.segment->thread < b.segment->thread
+				: a.segment->order < b.segment->order;
+		});
+
+		std::vector<Finished> finished;
+		std::vector<Open> open;
+		for (size_t p = 0; p < pieces.size(); )
+		{
+			ThreadSummary& thread = summary.threads.emplace_back();
+			thread.thread = pieces[p].segment->thread;
+			if (const auto it = threadNames.find(thread.thread); it != threadNames.end())
+				thread.name = it->second;
+			finished.clear();
+			open.clear();
+
+			for (; p < pieces.size() && pieces[p].segment->thread == thread.thread; ++p)
+			{
+				const Segment& segment = *pieces[p].segment;
+				const std::vector<uint32_t>& names = global[pieces[p].worker];
+				for (const Boundary& boundary : segment.boundaries)
+				{
+					if (boundary.kind == Boundary::Claim)
+					{
+						summary.stats[names[boundary.name]].self -= static_cast<int64_t>(claim(finished, boundary.start));
+						continue;
+					}
+					if (open.empty())
+					{
+						// The 'B' is not in the trace; keep what it enclosed as busy time
+						if (boundary.claimed > 0)
+							pushFinished(finished, { boundary.start, boundary.end, boundary.claimed });
+						continue;
+					}
+					const Open scope = open.back();
+					open.pop_back();
+					const uint64_t claimed = claim(finished, scope.start);
+					const uint64_t duration = static_cast<uint64_t>(std::max<int64_t>(boundary.time - scope.start, 0));
+					summary.stats[scope.name].add(duration, static_cast<int64_t>(duration - boundary.claimed - claimed));
+					pushFinished(finished, { scope.start, boundary.time, duration });
+					addCandidate(thread.candidates, { scope.start, boundary.time, scope.name });
+				}
+				for (const Finished& scope : segment.finished)
+					pushFinished(finished, scope);
+				for (const Open& scope : segment.open)
+					open.push_back({ scope.start, names[scope.name] });
+				for (const Candidate& scope : segment.candidates)
+					addCandidate(thread.candidates, { scope.start, scope.end, names[scope.name] });
+				thread.events += segment.events;
+				thread.first = std::min(thread.first, segment.first);
+				thread.last = std::max(thread.last, segment.last);
+			}
+
+			for (const Finished& scope : finished)
+				thread.busy += scope.busy;
+			summary.unfinished += open.size();
+			summary.events += thread.events;
+			summary.first = std::min(summary.first, thread.first);
+			summary.last = std::max(summary.last, thread.last);
+		}
+		return summary;
+	}
+
+	// ========================================================================
+	// Report
+	// ========================================================================
+
+	// A scope during which other threads of its process started and finished
+	struct Region
+	{
+		const ThreadSummary* owner;
+		Candidate scope;
+		std::vector<const ThreadSummary*> threads;
+	};
+
+	// Each thread belongs to the shortest candidate that covers all of its
+	// events. Threads no other thread covers are owners first, then the
+	// threads they took, and so on, so that workers overlapping in time are
+	// not taken for each other's children.
+	std::vector<Region> findRegions(const Summary& summary)
+	{
+		const auto covering = [&](const ThreadSummary& thread, const ThreadSummary& other) -> const Candidate* {
+			if (&other == &thread || (other.thread >> 32) != (thread.thread >> 32))
+				return nullptr;
+			const Candidate* best = nullptr;
+			for (const Candidate& scope : other.candidates)
+			{
+				if (scope.start <= thread.first && scope.end >= thread.last
+					&& (!best || scope.end - scope.start < best->end - best->start))
+					best = &scope;
+			}
+			return best;
+		};
+
+		std::vector<const ThreadSummary*> owners;
+		std::vector<const ThreadSummary*> unowned;
+		for (const ThreadSummary& thread : summary.threads)
+		{
+			const bool covered = std::any_of(summary.threads.begin(), summary.threads.end(), [&](const ThreadSummary& other) {
+				return covering(thread, other) != nullptr;
+			});
+			(covered ? unowned : owners).push_back(&thread);
+		}
+
+		std::vector<Region> regions;
+		while (!owners.empty() && !unowned.empty())
+		{
+			std::vector<const ThreadSummary*> taken;
+			std::erase_if(unowned, [&](const ThreadSummary* thread) {
+				const ThreadSummary* owner = nullptr;
+				const Candidate* best = nullptr;
+				for (const ThreadSummary* other : owners)
+				{
+					const Candidate* scope = covering(*thread, *other);
+					if (scope && (!best || scope->end - scope->start < best->end - best->start))
+					{
+						owner = other;
+						best = scope;
+					}
+				}
+				if (!best)
+					return false;
+				const auto it = std::find_if(regions.begin(), regions.end(), [&](const Region& region) {
+					return region.owner == owner && region.scope.start == best->start && region.scope.end == best->end;
+				});
+				if (it != regions.end())
+					it->threads.push_back(thread);
+				else
+					regions.push_back({ owner, *best, { thread } });
+				taken.push_back(thread);
+				return true;
+			});
+			owners = std::move(taken);
+		}
+		std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) {
+			return a.scope.end - a.scope.start > b.scope.end - b.scope.start;
+		});
+		return regions;
+	}
+
+	class Report
+	{
+	public:
+		Report(const Summary& summary, double nsPerTick, size_t rows)
+			: m_summary(summary), m_msPerTick(nsPerTick / 1e6), m_rows(rows)
+		{
+			for (const ThreadSummary& thread : summary.threads)
+				m_multiProcess |= (thread.thread >> 32) != (summary.threads.front().thread >> 32);
+		}
+
+		void print() const
+		{
+			const double span = m_summary.events > 0 ? ms(m_summary.last - m_summary.first) : 0.0;
+			std::printf("%llu events on %zu threads over %.3f ms\n",
+				static_cast<unsigned long long>(m_summary.events), m_summary.threads.size(), span);
+			if (m_summary.unfinished > 0)
+			{
+				std::printf("%llu scopes had not ended when the trace stopped\n",
+					static_cast<unsigned long long>(m_summary.unfinished));
+			}
+			printSelfTime();
+			printThreads();
+			printRegions();
+			printLatency();
+		}
+
+	private:
+		double ms(int64_t ticks) const { return static_cast<double>(ticks) * m_msPerTick; }
+		double ms(uint64_t ticks) const { return static_cast<double>(ticks) * m_msPerTick; }
+
+		std::string label(const ThreadSummary& thread) const
+		{
+			std::string label = thread.name.empty() ? "thread " + std::to_string(thread.thread & 0xffffffffu) : thread.name;
+			if (m_multiProcess)
+				label = std::to_string(thread.thread >> 32) + "/" + label;
+			return label;
+		}
+
+		// Most total time first
+		std::vector<uint32_t> byTotal() const
+		{
+			std::vector<uint32_t> order;
+			for (uint32_t i = 0; i < m_summary.stats.size(); ++i)
+			{
+				if (m_summary.stats[i].count > 0)
+					order.push_back(i);
+			}
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				return m_summary.stats[a].total > m_summary.stats[b].total;
+			});
+			return order;
+		}
+
+		void printSelfTime() const
+		{
+			std::vector<uint32_t> order = byTotal();
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				return m_summary.stats[a].self > m_summary.stats[b].self;
+			});
+			int64_t totalSelf = 0;
+			for (const uint32_t name : order)
+				totalSelf += m_summary.stats[name].self;
+
+			std::printf("\nTop scopes by self time\n%12s %7s %12s %12s  %s\n", "self ms", "self%", "total ms", "count", "name");
+			for (size_t i = 0; i < std::min(m_rows, order.size()); ++i)
+			{
+				const NameStats& stats = m_summary.stats[order[i]];
+				const double share = totalSelf > 0 ? 100.0 * static_cast<double>(stats.self) / static_cast<double>(totalSelf) : 0.0;
+				std::printf("%12.3f %6.1f%% %12.3f %12llu  %s\n", ms(stats.self), share, ms(stats.total),
+					static_cast<unsigned long long>(stats.count), m_summary.names[order[i]].c_str());
+			}
+		}
+
+		void printThreads() const
+		{
+			std::vector<const ThreadSummary*> order;
+			for (const ThreadSummary& thread : m_summary.threads)
+				order.push_back(&thread);
+			std::sort(order.begin(), order.end(), [](const ThreadSummary* a, const ThreadSummary* b) {
+				return a->busy > b->busy;
+			});
+
+			std::printf("\nThread utilization (busy: inside a top-level scope)\n%12s %12s %12s %7s  %s\n",
+				"events", "busy ms", "span ms", "busy%", "thread");
+			for (size_t i = 0; i < std::min(m_rows, order.size()); ++i)
+			{
+				const ThreadSummary& thread = *order[i];
+				const int64_t span = thread.last - thread.first;
+				const double share = span > 0 ? 100.0 * static_cast<double>(thread.busy) / static_cast<double>(span) : 0.0;
+				std::printf("%12llu %12.3f %12.3f %6.1f%%  %s\n", static_cast<unsigned long long>(thread.events),
+					ms(thread.busy), ms(span), share, label(thread).c_str());
+			}
+			if (order.size() > m_rows)
+				std::printf("%12s  (%zu more threads)\n", "", order.size() - m_rows);
+		}
+
+		// The path through a region runs from its start to the first thread it
+		// forks, through the thread that finishes last, to the region's end
+		void printRegions() const
+		{
+			const std::vector<Region> regions = findRegions(m_summary);
+			if (regions.empty())
+				return;
+			std::printf("\nFork/join regions, longest first\n");
+			for (size_t i = 0; i < std::min(m_rows, regions.size()); ++i)
+			{
+				const Region& region = regions[i];
+				const ThreadSummary* critical = region.threads.front();
+				int64_t forked = INT64_MAX;
+				uint64_t busy = 0;
+				for (const ThreadSummary* thread : region.threads)
+				{
+					if (thread->last > critical->last)
+						critical = thread;
+					forked = std::min(forked, thread->first);
+					busy += thread->busy;
+				}
+				const int64_t duration = region.scope.end - region.scope.start;
+				const double parallelism = duration > 0 ? static_cast<double>(busy) / static_cast<double>(duration) : 0.0;
+				std::printf("  %s on %s at %.3f ms: %.3f ms, %zu threads, parallelism %.2f\n",
+					m_summary.names[region.scope.name].c_str(), label(*region.owner).c_str(),
+					ms(region.scope.start - m_summary.first), ms(duration), region.threads.size(), parallelism);
+				std::printf("    critical path: fork %.3f ms, %s %.3f ms (busy %.3f ms), join %.3f ms\n",
+					ms(forked - region.scope.start), label(*critical).c_str(), ms(critical->last - critical->first),
+					ms(critical->busy), ms(region.scope.end - critical->last));
+			}
+		}
+
+		void printLatency() const
+		{
+			const std::vector<uint32_t> order = byTotal();
+			const double usPerTick = m_msPerTick * 1e3;
+			std::printf("\nLatency per name, most total time first\n%12s %12s %12s %12s %12s  %s\n",
+				"count", "p50 us", "p90 us", "p99 us", "max us", "name");
+			for (size_t i = 0; i < std::min(m_rows, order.size()); ++i)
+			{
+				const NameStats& stats = m_summary.stats[order[i]];
+				const auto percentile = [&](double q) {
+					const double value = stats.durations.quantile(q, stats.count);
+					return std::clamp(value, static_cast<double>(stats.min), static_cast<double>(stats.max)) * usPerTick;
+				};
+				std::printf("%12llu %12.3f %12.3f %12.3f %12.3f  %s\n", static_cast<unsigned long long>(stats.count),
+					percentile(0.50), percentile(0.90), percentile(0.99), static_cast<double>(stats.max) * usPerTick,
+					m_summary.names[order[i]].c_str());
+			}
+		}
+
+		const Summary& m_summary;
+		double m_msPerTick;
+		size_t m_rows;
+		bool m_multiProcess = false;
+	};
+
+	void printUsage()
+	{
+		std::cerr << "usage: tracer_analyze [-n rows] [-j threads] <input>\n"
+			"Summarizes a Chrome JSON trace, a file recorded with\n"
+			"TraceOptions::mappedBytes or a crash dump: scopes by self time,\n"
+			"thread utilization, fork/join critical paths and latency\n"
+			"percentiles per name. Shows 20 rows per table by default and\n"
+			"scans with one thread per core.\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string inputPath;
+	size_t rows = 20;
+	size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if ((arg == "-n" || arg == "-j") && i + 1 < argc)
+		{
+			const std::string_view value = argv[++i];
+			size_t number = 0;
+			if (std::from_chars(value.data(), value.data() + value.size(), number).ec != std::errc() || number == 0)
+			{
+				printUsage();
+				return 1;
+			}
+			(arg == "-n" ? rows : jobs) = number;
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			printUsage();
+			return 0;
+		}
+		else
+			inputPath = arg;
+	}
+	if (inputPath.empty())
+	{
+		printUsage();
+		return 1;
+	}
+
+	MappedInput input;
+	if (!input.open(inputPath))
+	{
+		std::cerr << inputPath << ": cannot open\n";
+		return 1;
+	}
+
+	const auto started = std::chrono::steady_clock::now();
+	std::vector<Worker> workers(jobs);
+	std::unordered_map<uint64_t, std::string> threadNames;
+	double nsPerTick = 1.0;
+	std::string error;
+	const std::string_view text(input.data(), input.size());
+	if (text.size() >= sizeof(TraceMappedHeader::kMagic)
+		&& std::memcmp(text.data(), TraceMappedHeader::kMagic, sizeof(TraceMappedHeader::kMagic)) == 0)
+	{
+		MappedTrace trace;
+		if (!trace.open(input, error))
+		{
+			std::cerr << inputPath << ": " << error << "\n";
+			return 1;
+		}
+		trace.scan(workers);
+		threadNames = trace.threadNames();
+		nsPerTick = trace.nsPerTick();
+		if (!trace.closed())
+			std::cerr << "The session did not end; the trace stops at the last complete event\n";
+	}
+	else if (const size_t first = text.find_first_not_of(" \n\r\t"); first != std::string_view::npos && text[first] == '{')
+	{
+		JsonTrace trace;
+		if (!trace.open(input, error) || !trace.scan(workers, error))
+		{
+			std::cerr << inputPath << ": " << error << "\n";
+			return 1;
+		}
+		std::unordered_map<uint64_t, uint64_t> latest;
+		for (const Worker& worker : workers)
+		{
+			for (const auto& [thread, name] : worker.threadNames)
+			{
+				auto [it, added] = latest.try_emplace(thread, name.first);
+				if (added || name.first >= it->second)
+				{
+					it->second = name.first;
+					threadNames[thread] = name.second;
+				}
+			}
+		}
+	}
+	else
+	{
+		std::cerr << inputPath << ": neither Chrome JSON nor a mapped trace file\n";
+		return 1;
+	}
+
+	const Summary summary = joinThreads(workers, threadNames);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+	std::cerr << "Scanned " << summary.events << " events in " << elapsed.count() << " s using " << jobs
+		<< (jobs == 1 ? " thread\n" : " threads\n");
+	Report(summary, nsPerTick, rows).print();
+	return 0;
+}
@@ -0,0 +1,503 @@
+// tracer_collect.cpp : Forwards a live session (TraceOptions::liveName) to
+// a viewer while it records.
+//
+//   tracer_collect -f perfetto -p 9001 myservice      serve one TCP client
+//   tracer_collect -o trace.json myservice            write a file
+//
+// Waits for the segment to appear, drains its ring as the session records,
+// and exits once the session has ended (or its process is gone) and
+// everything published has been forwarded. Perfetto output is usable while
+// it streams; JSON only gets its closing bracket at the end.
+
+#include "tracer_live.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <winsock2.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr auto kPollInterval = std::chrono::milliseconds(10);
+	constexpr auto kAttachInterval = std::chrono::milliseconds(100);
+
+	class LiveReader
+	{
+	public:
+		LiveReader() = default;
+		LiveReader(const LiveReader&) = delete;
+		LiveReader& operator=(const LiveReader&) = delete;
+
+		~LiveReader()
+		{
+			if (!m_base)
+				return;
+#if defined(_WIN32)
+			UnmapViewOfFile(m_base);
+			CloseHandle(m_mapping);
+#else
+			munmap(m_base, m_bytes);
+#endif
+		}
+
+		// False while the segment does not exist or its writer has not filled
+		// in the header yet
+		bool open(const std::string& name)
+		{
+#if defined(_WIN32)
+			m_mapping = OpenFileMappingA(FILE_MAP_WRITE, FALSE, ("Local\\" + name).c_str());
+			if (!m_mapping)
+				return false;
+			void* view = MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0);
+			MEMORY_BASIC_INFORMATION region{};
+			if (!view || !VirtualQuery(view, &region, sizeof(region)))
+			{
+				if (view)
+					UnmapViewOfFile(view);
+				CloseHandle(m_mapping);
+				return false;
+			}
+			m_bytes = region.RegionSize;
+#else
+			const int fd = shm_open(("/" + name).c_str(), O_RDWR, 0);
+			if (fd < 0)
+				return false;
+			struct stat info{};
+			if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(TraceLiveHeader))
+			{
+				::close(fd);
+				return false;
+			}
+			m_bytes = static_cast<size_t>(info.st_size);
+			void* view = mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (view == MAP_FAILED)
+				return false;
+#endif
+			m_base = static_cast<std::byte*>(view);
+			m_header = reinterpret_cast<TraceLiveHeader*>(m_base);
+			return ready();
+		}
+
+		// Checks the header once the writer has published it
+		bool ready() const
+		{
+			char magic[sizeof(TraceLiveHeader::kMagic)];
+			std::memcpy(magic, m_header->magic, sizeof(magic));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return std::memcmp(magic, TraceLiveHeader::kMagic, sizeof(magic)) == 0;
+		}
+
+		bool compatible() const
+		{
+			const TraceLiveHeader& h = *m_header;
+			return h.version == TraceLiveHeader::kVersion
+				&& h.eventBytes == sizeof(TraceEvent) && h.argBytes == sizeof(TraceArg)
+				&& h.stringsOffset + h.stringsBytes <= m_bytes
+				&& h.slotsOffset + h.slotCount * h.slotBytes <= m_bytes
+				&& sizeof(TraceLiveSlot) + size_t(h.slotEvents) * sizeof(TraceEvent) <= h.argsOffset
+				&& h.argsOffset + size_t(h.slotArgs) * sizeof(TraceArg) <= h.slotBytes;
+		}
+
+		TraceSessionInfo sessionInfo() const
+		{
+			TraceSessionInfo info;
+			info.startTicks = m_header->startTicks;
+			info.nsPerTick = m_header->nsPerTick;
+			info.pid = m_header->pid;
+			info.processName = m_header->processName;
+			info.hostName = m_header->hostName;
+			info.clockAnchorNs = m_header->clockAnchorNs;
+			return info;
+		}
+
+		bool closed() const
+		{
+			return std::atomic_ref<uint32_t>(m_header->state).load(std::memory_order_acquire) == TraceLiveHeader::Closed;
+		}
+
+		uint64_t dropped() const
+		{
+			return std::atomic_ref<uint64_t>(m_header->droppedEvents).load(std::memory_order_relaxed);
+		}
+
+		// A process that died never marks its segment closed
+		bool writerAlive() const
+		{
+#if defined(_WIN32)
+			const HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, m_header->pid);
+			if (!process)
+				return false;
+			const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+			CloseHandle(process);
+			return alive;
+#else
+			return kill(static_cast<pid_t>(m_header->pid), 0) == 0 || errno == EPERM;
+#endif
+		}
+
+		// Hands every published slot to the exporter and frees it; returns the
+		// number of events forwarded
+		uint64_t drain(TraceExporter& exporter)
+		{
+			std::atomic_ref<uint64_t> readIndex(m_header->readIndex);
+			const uint64_t end = std::atomic_ref<uint64_t>(m_header->writeIndex).load(std::memory_order_acquire);
+			uint64_t index = readIndex.load(std::memory_order_relaxed);
+			if (index == end)
+				return 0;
+			readStrings();
+
+			const TraceLiveHeader& h = *m_header;
+			m_events.resize(h.slotEvents);
+			m_args.resize(h.slotArgs);
+			uint64_t forwarded = 0;
+			for (; index < end; ++index)
+			{
+				const std::byte* slot = m_base + h.slotsOffset + (index % h.slotCount) * h.slotBytes;
+				TraceLiveSlot header;
+				std::memcpy(&header, slot, sizeof(header));
+				const size_t count = std::min<size_t>(header.count, h.slotEvents);
+				const size_t argCount = std::min<size_t>(header.argCount, h.slotArgs);
+				std::memcpy(m_events.data(), slot + sizeof(TraceLiveSlot), count * sizeof(TraceEvent));
+				std::memcpy(m_args.data(), slot + h.argsOffset, argCount * sizeof(TraceArg));
+				readIndex.store(index + 1, std::memory_order_release);
+
+				for (size_t e = 0; e < count; ++e)
+				{
+					TraceEvent& ev = m_events[e];
+					if (ev.argIndex + size_t(ev.argCount) > argCount)
+						ev.argCount = 0;
+					if (ev.name == kTraceAddressName)
+					{
+						ev.name = addressName(ev.id);
+						ev.id = 0;
+					}
+					reserveString(m_names, ev.name);
+					reserveString(m_categories, ev.category);
+					for (size_t a = ev.argIndex; a < ev.argIndex + size_t(ev.argCount); ++a)
+					{
+						reserveString(m_names, m_args[a].key);
+						if (m_args[a].type == TraceArg::Type::String)
+							reserveString(m_names, m_args[a].stringValue);
+					}
+				}
+
+				TraceThreadInfo thread{ header.thread, {}, std::nullopt };
+				if (const auto it = m_threadNames.find(header.thread); it != m_threadNames.end())
+					thread.name = it->second;
+				if (header.flags & TraceLiveSlot::kSorted)
+					thread.sortIndex = static_cast<int32_t>(header.sortIndex);
+				exporter.writeEvents({ m_names.views, m_categories.views }, thread,
+					{ m_events.data(), count }, { m_args.data(), argCount });
+				forwarded += count;
+			}
+			return forwarded;
+		}
+
+	private:
+		struct Strings
+		{
+			std::deque<std::string> storage;     // stable addresses for the views
+			std::vector<std::string_view> views;
+		};
+
+		// Records published since the last call
+		void readStrings()
+		{
+			const TraceLiveHeader& h = *m_header;
+			const uint64_t used = std::min(std::atomic_ref<uint64_t>(m_header->stringsUsed).load(std::memory_order_acquire), h.stringsBytes);
+			const std::byte* strings = m_base + h.stringsOffset;
+			while (m_stringsRead + sizeof(TraceMappedString) <= used)
+			{
+				TraceMappedString entry;
+				std::memcpy(&entry, strings + m_stringsRead, sizeof(entry));
+				const uint64_t end = m_stringsRead + sizeof(entry) + entry.length;
+				if (end > used)
+					break;
+				const std::string_view str(reinterpret_cast<const char*>(strings + m_stringsRead + sizeof(entry)), entry.length);
+				if (entry.table == TraceMappedString::Name)
+					setString(m_names, entry.id, str);
+				else if (entry.table == TraceMappedString::Category)
+					setString(m_categories, entry.id, str);
+				else if (entry.table == TraceMappedString::Thread)
+					m_threadNames[entry.id] = m_names.storage.emplace_back(str);
+				m_stringsRead = (end + 3) & ~uint64_t(3);
+			}
+		}
+
+		static void setString(Strings& strings, TraceStringId id, std::string_view str)
+		{
+			reserveString(strings, id);
+			strings.views[id] = strings.storage.emplace_back(str);
+		}
+
+		// IDs whose string did not fit into the segment are shown as "#<id>"
+		static void reserveString(Strings& strings, TraceStringId id)
+		{
+			if (id == kTraceNoName)
+				return;
+			while (strings.views.size() <= id)
+			{
+				const size_t missing = strings.views.size();
+				strings.views.push_back(strings.storage.emplace_back("#" + std::to_string(missing)));
+			}
+		}
+
+		// Function instrumentation events the writer could not symbolize
+		TraceStringId addressName(uint64_t address)
+		{
+			auto [it, added] = m_addressNames.try_emplace(address, 0);
+			if (added)
+			{
+				char hex[2 + 16] = { '0', 'x' };
+				const auto result = std::to_chars(hex + 2, hex + sizeof(hex), address, 16);
+				it->second = static_cast<TraceStringId>(m_names.views.size());
+				m_names.views.push_back(m_names.storage.emplace_back(hex, result.ptr));
+			}
+			return it->second;
+		}
+
+		std::byte* m_base = nullptr;
+		size_t m_bytes = 0;
+		TraceLiveHeader* m_header = nullptr;
+#if defined(_WIN32)
+		HANDLE m_mapping = nullptr;
+#endif
+		uint64_t m_stringsRead = 0;
+		Strings m_names;
+		Strings m_categories;
+		std::unordered_map<uint32_t, std::string_view> m_threadNames;
+		std::unordered_map<uint64_t, TraceStringId> m_addressNames;
+		std::vector<TraceEvent> m_events;
+		std::vector<TraceArg> m_args;
+	};
+
+	// ========================================================================
+	// TCP output
+	// ========================================================================
+
+#if defined(_WIN32)
+	using Socket = SOCKET;
+	constexpr Socket kNoSocket = INVALID_SOCKET;
+	void closeSocket(Socket s) { closesocket(s); }
+#else
+	using Socket = int;
+	constexpr Socket kNoSocket = -1;
+	void closeSocket(Socket s) { ::close(s); }
+#endif
+
+	// Listens on port and waits for one viewer to connect
+	Socket acceptClient(uint16_t port)
+	{
+		const Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+		if (listener == kNoSocket)
+			return kNoSocket;
+		const int reuse = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(port);
+		if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0)
+		{
+			closeSocket(listener);
+			return kNoSocket;
+		}
+		const Socket client = accept(listener, nullptr, nullptr);
+		closeSocket(listener);
+		return client;
+	}
+
+	class SocketBuf final : public std::streambuf
+	{
+	public:
+		explicit SocketBuf(Socket socket)
+			: m_socket(socket)
+		{
+			setp(m_buffer, m_buffer + sizeof(m_buffer));
+		}
+
+		~SocketBuf() override
+		{
+			sync();
+			closeSocket(m_socket);
+		}
+
+	protected:
+		int_type overflow(int_type ch) override
+		{
+			if (sync() != 0)
+				return traits_type::eof();
+			if (!traits_type::eq_int_type(ch, traits_type::eof()))
+			{
+				*pptr() = traits_type::to_char_type(ch);
+				pbump(1);
+			}
+			return traits_type::not_eof(ch);
+		}
+
+		int sync() override
+		{
+			const char* data = pbase();
+			while (data < pptr())
+			{
+				const auto sent = send(m_socket, data, static_cast<int>(pptr() - data), 0);
+				if (sent <= 0)
+					return -1;
+				data += sent;
+			}
+			setp(m_buffer, m_buffer + sizeof(m_buffer));
+			return 0;
+		}
+
+	private:
+		Socket m_socket;
+		char m_buffer[1 << 16];
+	};
+
+	void printUsage()
+	{
+		std::cerr << "usage: tracer_collect [-f json|perfetto] (-o <output> | -p <port>) <name>\n"
+			"Forwards the live session recorded with TraceOptions::liveName = <name>\n"
+			"to a file or to one TCP client, as Chrome JSON (default) or Perfetto\n"
+			"protobuf, until the session ends.\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string outputPath;
+	std::string name;
+	std::string_view format = "json";
+	int port = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (arg == "-p" && i + 1 < argc)
+			port = std::atoi(argv[++i]);
+		else if (arg == "-f" && i + 1 < argc)
+			format = argv[++i];
+		else if (arg == "-h" || arg == "--help")
+		{
+			printUsage();
+			return 0;
+		}
+		else
+			name = arg;
+	}
+	if (name.empty() || outputPath.empty() == (port == 0) || port < 0 || port > 65535
+		|| (format != "json" && format != "perfetto"))
+	{
+		printUsage();
+		return 1;
+	}
+
+	LiveReader reader;
+	std::cerr << "Waiting for " << name << "\n";
+	while (!reader.open(name))
+		std::this_thread::sleep_for(kAttachInterval);
+	while (!reader.ready())
+		std::this_thread::sleep_for(kPollInterval);
+	if (!reader.compatible())
+	{
+		std::cerr << name << ": written by an incompatible tracer version or architecture\n";
+		return 1;
+	}
+
+	std::unique_ptr<std::streambuf> socketBuf;
+	std::ofstream file;
+	std::ostream out(nullptr);
+	if (port != 0)
+	{
+#if defined(_WIN32)
+		WSADATA wsa;
+		WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+		signal(SIGPIPE, SIG_IGN);            // a viewer going away ends the loop below instead
+#endif
+		std::cerr << "Waiting for a viewer on port " << port << "\n";
+		const Socket client = acceptClient(static_cast<uint16_t>(port));
+		if (client == kNoSocket)
+		{
+			std::cerr << "port " << port << ": cannot listen\n";
+			return 1;
+		}
+		socketBuf = std::make_unique<SocketBuf>(client);
+		out.rdbuf(socketBuf.get());
+	}
+	else
+	{
+		file.open(outputPath, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << outputPath << ": cannot open\n";
+			return 1;
+		}
+		out.rdbuf(file.rdbuf());
+	}
+
+	const std::unique_ptr<TraceExporter> exporter = format == "perfetto" ? makePerfettoExporter() : makeJsonExporter();
+	exporter->begin(out, reader.sessionInfo());
+	uint64_t events = 0;
+	for (;;)
+	{
+		// Read before draining, so the slots published last are included
+		const bool finished = reader.closed() || !reader.writerAlive();
+		const uint64_t forwarded = reader.drain(*exporter);
+		events += forwarded;
+		if (forwarded > 0)
+		{
+			exporter->flush();
+			out.flush();
+		}
+		if (!out)
+		{
+			std::cerr << "The output failed; stopping\n";
+			break;
+		}
+		if (forwarded == 0)
+		{
+			if (finished)
+				break;
+			std::this_thread::sleep_for(kPollInterval);
+		}
+	}
+	exporter->end({});
+	out.flush();
+
+	std::cerr << "Forwarded " << events << " events\n";
+	if (!reader.closed())
+		std::cerr << "The recording process exited without ending the session\n";
+	if (const uint64_t dropped = reader.dropped())
+		std::cerr << "Dropped " << dropped << " events while the collector was behind\n";
+	return 0;
+}
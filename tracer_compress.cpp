@@ -0,0 +1,375 @@
+#include "tracer_compress.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#if defined(TRACER_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(TRACER_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+// ============================================================================
+// Compressors
+// ============================================================================
+
+namespace
+{
+	constexpr size_t kBlockBytes = size_t(1) << 20;
+	constexpr size_t kMaxQueuedBlocks = 4;           // the exporter waits beyond this
+	constexpr size_t kOutputStep = size_t(1) << 16;
+
+	// Fast levels: JSON traces compress well anyway, and the worker should
+	// keep up with the exporter
+	[[maybe_unused]] constexpr int kGzipLevel = 3;
+	[[maybe_unused]] constexpr int kZstdLevel = 3;
+
+	// One continuous compressed stream, fed a block at a time
+	class Compressor
+	{
+	public:
+		virtual ~Compressor() = default;
+
+		// Appends the compressed form of data to out; finish ends the stream
+		virtual bool compress(std::span<const char> data, bool finish, std::vector<char>& out) = 0;
+	};
+
+#if defined(TRACER_HAVE_ZLIB)
+	// gzip framing (windowBits + 16), so the file is a regular .gz
+	class GzipCompressor final : public Compressor
+	{
+	public:
+		GzipCompressor()
+		{
+			m_ok = deflateInit2(&m_stream, kGzipLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+		}
+
+		~GzipCompressor() override
+		{
+			if (m_ok)
+				deflateEnd(&m_stream);
+		}
+
+		bool compress(std::span<const char> data, bool finish, std::vector<char>& out) override
+		{
+			if (!m_ok)
+				return false;
+
+			m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+			m_stream.avail_in = static_cast<uInt>(data.size());
+			for (;;)
+			{
+				const size_t used = out.size();
+				out.resize(used + kOutputStep);
+				m_stream.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+				m_stream.avail_out = static_cast<uInt>(kOutputStep);
+				const int result = deflate(&m_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+				out.resize(used + kOutputStep - m_stream.avail_out);
+				if (result == Z_STREAM_ERROR)
+					return false;
+				if (finish ? result == Z_STREAM_END : m_stream.avail_in == 0 && m_stream.avail_out > 0)
+					return true;
+			}
+		}
+
+	private:
+		z_stream m_stream{};
+		bool m_ok = false;
+	};
+#endif
+
+#if defined(TRACER_HAVE_ZSTD)
+	class ZstdCompressor final : public Compressor
+	{
+	public:
+		ZstdCompressor()
+			: m_context(ZSTD_createCCtx())
+		{
+			if (m_context)
+				ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, kZstdLevel);
+		}
+
+		~ZstdCompressor() override
+		{
+			ZSTD_freeCCtx(m_context);
+		}
+
+		bool compress(std::span<const char> data, bool finish, std::vector<char>& out) override
+		{
+			if (!m_context)
+				return false;
+
+			ZSTD_inBuffer input{ data.data(), data.size(), 0 };
+			for (;;)
+			{
+				const size_t used = out.size();
+				out.resize(used + kOutputStep);
+				ZSTD_outBuffer output{ out.data() + used, kOutputStep, 0 };
+				const size_t remaining = ZSTD_compressStream2(m_context, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+				out.resize(used + output.pos);
+				if (ZSTD_isError(remaining))
+					return false;
+				if (finish ? remaining == 0 : input.pos == input.size)
+					return true;
+			}
+		}
+
+	private:
+		ZSTD_CCtx* m_context;
+	};
+#endif
+
+	TraceCompression available(TraceCompression compression)
+	{
+		if (compression == TraceCompression::Zstd && !TraceOutputFile::supports(TraceCompression::Zstd))
+			compression = TraceCompression::Gzip;
+		if (compression == TraceCompression::Gzip && !TraceOutputFile::supports(TraceCompression::Gzip))
+			compression = TraceCompression::None;
+		return compression;
+	}
+
+	std::unique_ptr<Compressor> makeCompressor(TraceCompression compression)
+	{
+		switch (available(compression))
+		{
+#if defined(TRACER_HAVE_ZSTD)
+		case TraceCompression::Zstd:
+			return std::make_unique<ZstdCompressor>();
+#endif
+#if defined(TRACER_HAVE_ZLIB)
+		case TraceCompression::Gzip:
+			return std::make_unique<GzipCompressor>();
+#endif
+		default:
+			return nullptr;
+		}
+	}
+}
+
+// ============================================================================
+// TraceOutputFile
+// ============================================================================
+
+// Doubles as the stream buffer of compressed output: the exporter fills
+// block, and full (or flushed) blocks are queued for the worker
+class TraceOutputFile::Impl : public std::streambuf
+{
+public:
+	std::ofstream file;
+	std::ostream out{ this };                    // rebound to file's buffer when uncompressed
+	std::unique_ptr<Compressor> compressor;
+	std::thread worker;
+
+	~Impl() override
+	{
+		finish();
+	}
+
+	void start()
+	{
+		block.resize(kBlockBytes);
+		setp(block.data(), block.data() + block.size());
+		worker = std::thread(&Impl::run, this);
+	}
+
+	// Queues the last block and waits for the worker to end the stream
+	void finish()
+	{
+		if (!worker.joinable())
+			return;
+		submit();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishing = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	bool failed() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return writeFailed;
+	}
+
+protected:
+	int_type overflow(int_type ch) override
+	{
+		submit();
+		if (traits_type::eq_int_type(ch, traits_type::eof()))
+			return traits_type::not_eof(ch);
+		*pptr() = traits_type::to_char_type(ch);
+		pbump(1);
+		return ch;
+	}
+
+	std::streamsize xsputn(const char* data, std::streamsize size) override
+	{
+		std::streamsize written = 0;
+		while (written < size)
+		{
+			if (pptr() == epptr())
+				submit();
+			const auto n = static_cast<size_t>(std::min<std::streamsize>(size - written, epptr() - pptr()));
+			std::memcpy(pptr(), data + written, n);
+			pbump(static_cast<int>(n));
+			written += static_cast<std::streamsize>(n);
+		}
+		return written;
+	}
+
+	int sync() override
+	{
+		submit();
+		return failed() ? -1 : 0;
+	}
+
+private:
+	void submit()
+	{
+		const auto used = static_cast<size_t>(pptr() - pbase());
+		if (used == 0)
+			return;
+		block.resize(used);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		space.wait(lock, [&] { return queue.size() < kMaxQueuedBlocks; });
+		queue.push_back(std::move(block));
+		block = {};
+		if (!spare.empty())
+		{
+			block = std::move(spare.back());
+			spare.pop_back();
+		}
+		lock.unlock();
+		wake.notify_one();
+
+		block.resize(kBlockBytes);
+		setp(block.data(), block.data() + block.size());
+	}
+
+	bool write(std::span<const char> data, bool last)
+	{
+		compressed.clear();
+		if (!compressor->compress(data, last, compressed))
+			return false;
+		file.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+		return static_cast<bool>(file);
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			wake.wait(lock, [&] { return !queue.empty() || finishing; });
+			if (queue.empty())
+				break;
+
+			std::vector<char> data = std::move(queue.front());
+			queue.pop_front();
+			const bool last = finishing && queue.empty();
+			lock.unlock();
+			space.notify_one();
+
+			const bool ok = write(data, last);
+			lock.lock();
+			writeFailed |= !ok;
+			spare.push_back(std::move(data));
+			if (last)
+				return;
+		}
+
+		// The last block went out before finish() was called
+		lock.unlock();
+		const bool ok = write({}, true);
+		lock.lock();
+		writeFailed |= !ok;
+	}
+
+	std::vector<char> block;                     // exporter side
+	std::vector<char> compressed;                // worker side
+	mutable std::mutex mutex;                    // guards the members below
+	std::condition_variable wake;                // worker: a block is queued, or finishing
+	std::condition_variable space;               // exporter: the queue has room
+	std::deque<std::vector<char>> queue;
+	std::vector<std::vector<char>> spare;        // written blocks, reused
+	bool finishing = false;
+	bool writeFailed = false;
+};
+
+TraceOutputFile::TraceOutputFile() = default;
+
+TraceOutputFile::~TraceOutputFile()
+{
+	close();
+}
+
+bool TraceOutputFile::supports(TraceCompression compression)
+{
+	switch (compression)
+	{
+	case TraceCompression::None:
+		return true;
+	case TraceCompression::Gzip:
+#if defined(TRACER_HAVE_ZLIB)
+		return true;
+#else
+		return false;
+#endif
+	case TraceCompression::Zstd:
+#if defined(TRACER_HAVE_ZSTD)
+		return true;
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+bool TraceOutputFile::open(const std::string& filepath, TraceCompression compression)
+{
+	close();
+	m_impl = std::make_unique<Impl>();
+	m_impl->file.open(filepath, std::ios::binary);
+	if (!m_impl->file)
+		return false;
+
+	m_impl->compressor = makeCompressor(compression);
+	if (m_impl->compressor)
+		m_impl->start();
+	else
+		m_impl->out.rdbuf(m_impl->file.rdbuf());
+	return true;
+}
+
+bool TraceOutputFile::isOpen() const
+{
+	return m_impl && m_impl->file.is_open();
+}
+
+std::ostream& TraceOutputFile::stream()
+{
+	return m_impl->out;
+}
+
+bool TraceOutputFile::close()
+{
+	if (!isOpen())
+		return false;
+	m_impl->out.flush();
+	const bool streamOk = static_cast<bool>(m_impl->out);
+	m_impl->finish();
+	m_impl->file.close();
+	const bool ok = streamOk && !m_impl->failed() && !m_impl->file.fail();
+	m_impl.reset();
+	return ok;
+}
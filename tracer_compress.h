@@ -0,0 +1,48 @@
+// tracer_compress.h : Output files for ChromeTracer sessions, optionally
+// compressed on a worker thread.
+
+#pragma once
+
+#include "tracer.h"
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+// ============================================================================
+// Trace output file
+// ============================================================================
+
+// Exporters write to stream(). Uncompressed output goes straight to the
+// file. Compressed output is collected in fixed-size blocks that a worker
+// thread compresses and writes while the exporter carries on; the exporter
+// only waits when the worker is several blocks behind.
+class TraceOutputFile
+{
+public:
+	TraceOutputFile();
+	~TraceOutputFile();
+	TraceOutputFile(const TraceOutputFile&) = delete;
+	TraceOutputFile& operator=(const TraceOutputFile&) = delete;
+
+	// Formats this build lacks fall back to gzip, then to none (see
+	// TraceOptions::compression). False if the file cannot be created.
+	bool open(const std::string& filepath, TraceCompression compression);
+
+	bool isOpen() const;
+
+	// Valid between open() and close(). flush() hands what has been written
+	// so far to the worker; it reaches the file once compressed.
+	std::ostream& stream();
+
+	// Finishes the compressed stream and closes the file; false if anything
+	// failed to be written
+	bool close();
+
+	// Whether this build can write the format
+	static bool supports(TraceCompression compression);
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> m_impl;
+};
@@ -0,0 +1,907 @@
+#include "tracer_export.h"
+#include <charconv>
+#include <cmath>
+#include <bit>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	// ========================================================================
+	// Output buffering
+	// ========================================================================
+
+	// Collects output in a large block and hands it to the stream in one
+	// write, so the per-event cost is a memcpy rather than a stream call
+	class BlockWriter
+	{
+	public:
+		static constexpr size_t kBlockSize = 1 << 20;
+
+		BlockWriter()
+			: m_data(std::make_unique<char[]>(kBlockSize))
+		{
+		}
+
+		void attach(std::ostream& os)
+		{
+			m_os = &os;
+		}
+
+		void write(std::string_view text)
+		{
+			if (m_size + text.size() > kBlockSize)
+			{
+				flush();
+				if (text.size() > kBlockSize)
+				{
+					m_os->write(text.data(), static_cast<std::streamsize>(text.size()));
+					return;
+				}
+			}
+			std::memcpy(m_data.get() + m_size, text.data(), text.size());
+			m_size += text.size();
+		}
+
+		void put(char c)
+		{
+			if (m_size == kBlockSize)
+				flush();
+			m_data[m_size++] = c;
+		}
+
+		// Room for n bytes written directly; finish with commit()
+		char* reserve(size_t n)
+		{
+			if (m_size + n > kBlockSize)
+				flush();
+			return m_data.get() + m_size;
+		}
+
+		void commit(const char* end)
+		{
+			m_size = static_cast<size_t>(end - m_data.get());
+		}
+
+		void flush()
+		{
+			if (m_size > 0 && m_os)
+				m_os->write(m_data.get(), static_cast<std::streamsize>(m_size));
+			m_size = 0;
+		}
+
+	private:
+		std::ostream* m_os = nullptr;
+		std::unique_ptr<char[]> m_data;
+		size_t m_size = 0;
+	};
+
+	// ========================================================================
+	// Chrome JSON
+	// ========================================================================
+
+	void appendJsonEscaped(std::string& out, std::string_view text)
+	{
+		static const char* const kHex = "0123456789abcdef";
+		for (const char c : text)
+		{
+			switch (c)
+			{
+			case '"':  out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					out += "\\u00";
+					out += kHex[(c >> 4) & 0xf];
+					out += kHex[c & 0xf];
+				}
+				else
+				{
+					out += c;
+				}
+			}
+		}
+	}
+
+	// Timestamps are written as microseconds with three fixed decimals, so
+	// nanosecond resolution survives at any offset
+	class JsonExporter final : public TraceExporter
+	{
+	public:
+		explicit JsonExporter(bool fragment = false)
+			: m_fragment(fragment)
+		{
+		}
+
+		void begin(std::ostream& out, const TraceSessionInfo& session) override
+		{
+			m_out.attach(out);
+			m_session = session;
+			m_first = !m_fragment;               // a fragment follows the process_name event below
+			m_pidField = ",\"pid\":" + std::to_string(session.pid) + ",\"tid\":";
+			if (m_fragment)
+				return;
+
+			// Ahead of the events, so tracer_merge reads it without a full pass
+			std::string processName;
+			appendJsonEscaped(processName, session.processName);
+			std::string hostName;
+			appendJsonEscaped(hostName, session.hostName);
+			m_out.write("{\"otherData\":{\"pid\":");
+			writeInteger(session.pid);
+			m_out.write(",\"processName\":\"");
+			m_out.write(processName);
+			m_out.write("\",\"hostName\":\"");
+			m_out.write(hostName);
+			m_out.write("\",\"clockAnchorNs\":");
+			writeInteger(session.clockAnchorNs);
+			m_out.write("},\"traceEvents\":[");
+
+			writeMetadataPrefix("process_name", 0);
+			m_out.write(",\"args\":{\"name\":\"");
+			m_out.write(processName);
+			m_out.write("\"}}");
+		}
+
+		void writeEvents(const TraceStrings& strings,
+			const TraceThreadInfo& thread,
+			std::span<const TraceEvent> events,
+			std::span<const TraceArg> args) override
+		{
+			m_strings = strings;
+			writeThreadMetadata(thread);
+
+			for (const TraceEvent& ev : events)
+			{
+				m_out.write(m_first ? "{\"name\":\"" : ",{\"name\":\"");
+				m_first = false;
+				m_out.write(m_names.get(strings.names, ev.name));
+				m_out.write("\",\"cat\":\"");
+				m_out.write(m_categories.get(strings.categories, ev.category));
+				m_out.write("\",\"ph\":\"");
+				m_out.put(ev.phase);
+				m_out.write("\",\"ts\":");
+				writeMicros(m_session.sinceStartNs(ev.timestamp));
+				m_out.write(m_pidField);
+				writeInteger(ev.thread);
+				switch (ev.phase)
+				{
+				case 'X':
+					m_out.write(",\"dur\":");
+					writeMicros(m_session.toNs(static_cast<int64_t>(ev.duration)));
+					break;
+				case 'f':
+					writeId(ev.id);
+					m_out.write(",\"bp\":\"e\"");       // bind to the enclosing slice
+					break;
+				case 'b': case 'e': case 'n': case 's': case 't':
+					writeId(ev.id);
+					break;
+				case 'C':
+					m_out.write(",\"args\":{\"value\":");
+					writeNumber(ev.value);
+					m_out.put('}');
+					break;
+				}
+				if (ev.argCount > 0 && ev.argIndex + ev.argCount <= args.size())
+					writeArgs(args.subspan(ev.argIndex, ev.argCount));
+				m_out.put('}');
+			}
+		}
+
+		void flush() override
+		{
+			m_out.flush();
+		}
+
+		void end(const TraceSummary& summary) override
+		{
+			if (m_fragment)
+			{
+				m_out.flush();
+				return;
+			}
+			m_out.write("],\"metadata\":{");
+			writeOverhead(summary.overhead);
+			if (!summary.sampling.empty())
+			{
+				m_out.write(",\"sampling\":[");
+				bool first = true;
+				for (const TraceSamplingInfo& site : summary.sampling)
+				{
+					std::string name;
+					appendJsonEscaped(name, site.name);
+					m_out.write(first ? "{\"name\":\"" : ",{\"name\":\"");
+					first = false;
+					m_out.write(name);
+					m_out.write("\",\"interval\":");
+					writeInteger(site.interval);
+					if (site.maxPerSecond > 0)
+					{
+						m_out.write(",\"maxPerSecond\":");
+						writeInteger(site.maxPerSecond);
+						m_out.write(",\"calls\":");
+						writeInteger(site.calls);
+						m_out.write(",\"recorded\":");
+						writeInteger(site.recorded);
+					}
+					m_out.put('}');
+				}
+				m_out.put(']');
+			}
+			m_out.write("}}");
+			m_out.flush();
+		}
+
+		std::unique_ptr<TraceExporter> makeFragment(uint32_t) const override
+		{
+			return std::make_unique<JsonExporter>(true);
+		}
+
+	private:
+		struct ThreadState
+		{
+			std::string name;                    // last written, escaped
+			std::optional<int32_t> sortIndex;
+		};
+
+		// Escaped on first use (IDs are stable), so a fragment only pays for
+		// the strings it writes
+		struct EscapedStrings
+		{
+			std::vector<std::string> strings;
+			std::vector<bool> escaped;
+
+			const std::string& get(std::span<const std::string_view> source, uint32_t id)
+			{
+				if (id >= escaped.size())
+				{
+					strings.resize(source.size());
+					escaped.resize(source.size(), false);
+				}
+				if (!escaped[id])
+				{
+					appendJsonEscaped(strings[id], source[id]);
+					escaped[id] = true;
+				}
+				return strings[id];
+			}
+		};
+
+		// 'M' events, written again if setThreadName() changes them mid-stream
+		void writeThreadMetadata(const TraceThreadInfo& thread)
+		{
+			if (thread.index >= m_threads.size())
+				m_threads.resize(thread.index + 1);
+			ThreadState& state = m_threads[thread.index];
+
+			if (!thread.name.empty())
+			{
+				std::string name;
+				appendJsonEscaped(name, thread.name);
+				if (name != state.name)
+				{
+					writeMetadataPrefix("thread_name", thread.index);
+					m_out.write(",\"args\":{\"name\":\"");
+					m_out.write(name);
+					m_out.write("\"}}");
+					state.name = std::move(name);
+				}
+			}
+			if (thread.sortIndex && thread.sortIndex != state.sortIndex)
+			{
+				writeMetadataPrefix("thread_sort_index", thread.index);
+				m_out.write(",\"args\":{\"sort_index\":");
+				writeInteger(*thread.sortIndex);
+				m_out.write("}}");
+				state.sortIndex = thread.sortIndex;
+			}
+		}
+
+		void writeOverhead(const TraceOverheadInfo& overhead)
+		{
+			static constexpr std::string_view kKinds[kTraceEventKinds] = {
+				"complete", "completeArgs", "instant", "instantArgs", "counter"
+			};
+			m_out.write("\"overhead\":{\"recordNs\":{");
+			for (size_t kind = 0; kind < kTraceEventKinds; ++kind)
+			{
+				m_out.write(kind == 0 ? "\"" : ",\"");
+				m_out.write(kKinds[kind]);
+				m_out.write("\":");
+				writeNumber(overhead.recordNs[kind]);
+			}
+			m_out.write("}");
+			m_out.write(",\"flushNs\":");
+			writeNumber(overhead.flushNs);
+			m_out.write(",\"flushes\":");
+			writeInteger(overhead.flushes);
+			m_out.write(",\"lockWaitNs\":");
+			writeNumber(overhead.lockWaitNs);
+			m_out.write(",\"droppedEvents\":");
+			writeInteger(overhead.droppedEvents);
+			m_out.write(overhead.subtracted ? ",\"subtracted\":true}" : ",\"subtracted\":false}");
+		}
+
+		void writeMetadataPrefix(std::string_view name, uint32_t thread)
+		{
+			m_out.write(m_first ? "{\"name\":\"" : ",{\"name\":\"");
+			m_first = false;
+			m_out.write(name);
+			m_out.write("\",\"ph\":\"M\"");
+			m_out.write(m_pidField);
+			writeInteger(thread);
+		}
+
+		void writeArgs(std::span<const TraceArg> args)
+		{
+			m_out.write(",\"args\":{");
+			for (size_t i = 0; i < args.size(); ++i)
+			{
+				const TraceArg& arg = args[i];
+				m_out.write(i == 0 ? "\"" : ",\"");
+				m_out.write(m_names.get(m_strings.names, arg.key));
+				m_out.write("\":");
+				switch (arg.type)
+				{
+				case TraceArg::Type::Int:
+					writeInteger(arg.intValue);
+					break;
+				case TraceArg::Type::UInt:
+					writeInteger(arg.uintValue);
+					break;
+				case TraceArg::Type::Double:
+					writeNumber(arg.doubleValue);
+					break;
+				case TraceArg::Type::Bool:
+					m_out.write(arg.boolValue ? "true" : "false");
+					break;
+				case TraceArg::Type::String:
+					m_out.put('"');
+					m_out.write(m_names.get(m_strings.names, arg.stringValue));
+					m_out.put('"');
+					break;
+				}
+			}
+			m_out.put('}');
+		}
+
+		void writeId(uint64_t id)
+		{
+			constexpr size_t kMaxHex = 16;
+			m_out.write(",\"id\":\"0x");
+			char* out = m_out.reserve(kMaxHex + 1);
+			out = std::to_chars(out, out + kMaxHex, id, 16).ptr;
+			*out++ = '"';
+			m_out.commit(out);
+		}
+
+		// JSON has no NaN or infinity
+		void writeNumber(double value)
+		{
+			constexpr size_t kMaxNumber = 32;
+			char* out = m_out.reserve(kMaxNumber);
+			m_out.commit(std::to_chars(out, out + kMaxNumber, std::isfinite(value) ? value : 0.0).ptr);
+		}
+
+		template <typename T>
+		void writeInteger(T value)
+		{
+			constexpr size_t kMaxNumber = 24;
+			char* out = m_out.reserve(kMaxNumber);
+			m_out.commit(std::to_chars(out, out + kMaxNumber, value).ptr);
+		}
+
+		void writeMicros(int64_t ns)
+		{
+			constexpr size_t kMaxNumber = 32;
+			char* out = m_out.reserve(kMaxNumber);
+			char* const end = out + kMaxNumber;
+
+			uint64_t magnitude = static_cast<uint64_t>(ns);
+			if (ns < 0)
+			{
+				*out++ = '-';
+				magnitude = 0 - magnitude;
+			}
+			out = std::to_chars(out, end, magnitude / 1000).ptr;
+			const auto fraction = static_cast<unsigned>(magnitude % 1000);
+			out[0] = '.';
+			out[1] = static_cast<char>('0' + fraction / 100);
+			out[2] = static_cast<char>('0' + fraction / 10 % 10);
+			out[3] = static_cast<char>('0' + fraction % 10);
+			m_out.commit(out + 4);
+		}
+
+		BlockWriter m_out;
+		TraceSessionInfo m_session;
+		std::string m_pidField;                  // ,"pid":N,"tid":
+		bool m_fragment;
+		bool m_first = true;
+		TraceStrings m_strings;                  // of the current batch
+		EscapedStrings m_names;
+		EscapedStrings m_categories;
+		std::vector<ThreadState> m_threads;      // indexed by thread index
+	};
+
+	// ========================================================================
+	// Perfetto protobuf
+	// ========================================================================
+
+	// Field numbers from perfetto/protos/perfetto/trace/
+	namespace pb
+	{
+		constexpr uint32_t kTracePacket = 1;                      // Trace.packet
+
+		constexpr uint32_t kPacketClockSnapshot = 6;              // TracePacket
+		constexpr uint32_t kPacketTimestamp = 8;
+		constexpr uint32_t kPacketSequenceId = 10;
+		constexpr uint32_t kPacketTrackEvent = 11;
+		constexpr uint32_t kPacketInternedData = 12;
+		constexpr uint32_t kPacketSequenceFlags = 13;
+		constexpr uint32_t kPacketTrackDescriptor = 60;
+
+		constexpr uint32_t kSeqIncrementalStateCleared = 1;       // TracePacket.SequenceFlags
+		constexpr uint32_t kSeqNeedsIncrementalState = 2;
+
+		constexpr uint32_t kEventCategoryIids = 3;                // TrackEvent
+		constexpr uint32_t kEventDebugAnnotations = 4;
+		constexpr uint32_t kEventType = 9;
+		constexpr uint32_t kEventNameIid = 10;
+		constexpr uint32_t kEventTrackUuid = 11;
+		constexpr uint32_t kEventFlowIds = 47;                    // fixed64
+		constexpr uint32_t kEventTerminatingFlowIds = 48;         // fixed64
+		constexpr uint32_t kEventDoubleCounterValue = 44;         // double
+
+		constexpr uint32_t kTypeSliceBegin = 1;                   // TrackEvent.Type
+		constexpr uint32_t kTypeSliceEnd = 2;
+		constexpr uint32_t kTypeInstant = 3;
+		constexpr uint32_t kTypeCounter = 4;
+
+		constexpr uint32_t kInternedEventCategories = 1;          // InternedData
+		constexpr uint32_t kInternedEventNames = 2;
+		constexpr uint32_t kInternedIid = 1;                      // EventCategory / EventName
+		constexpr uint32_t kInternedName = 2;
+
+		constexpr uint32_t kAnnotationBool = 2;                   // DebugAnnotation
+		constexpr uint32_t kAnnotationUInt = 3;
+		constexpr uint32_t kAnnotationInt = 4;
+		constexpr uint32_t kAnnotationDouble = 5;                 // double
+		constexpr uint32_t kAnnotationString = 6;
+		constexpr uint32_t kAnnotationName = 10;
+
+		constexpr uint32_t kTrackUuid = 1;                        // TrackDescriptor
+		constexpr uint32_t kTrackName = 2;
+		constexpr uint32_t kTrackProcess = 3;                     // ProcessDescriptor
+		constexpr uint32_t kTrackParentUuid = 5;
+		constexpr uint32_t kTrackCounter = 8;                     // CounterDescriptor
+
+		constexpr uint32_t kProcessPid = 1;                       // ProcessDescriptor
+		constexpr uint32_t kProcessName = 6;
+
+		constexpr uint32_t kSnapshotClocks = 1;                   // ClockSnapshot
+		constexpr uint32_t kClockId = 1;                          // ClockSnapshot.Clock
+		constexpr uint32_t kClockTimestamp = 2;
+		constexpr uint32_t kClockRealtime = 1;                    // BuiltinClock
+		constexpr uint32_t kClockBoottime = 6;
+	}
+
+	// Minimal protobuf encoder; nested messages are built separately and
+	// appended with their exact length
+	class ProtoWriter
+	{
+	public:
+		void clear()
+		{
+			m_data.clear();
+		}
+
+		bool empty() const
+		{
+			return m_data.empty();
+		}
+
+		std::string_view view() const
+		{
+			return m_data;
+		}
+
+		void varint(uint32_t field, uint64_t value)
+		{
+			key(field, 0);
+			rawVarint(value);
+		}
+
+		void fixed64(uint32_t field, uint64_t value)
+		{
+			key(field, 1);
+			for (int i = 0; i < 8; ++i)
+				m_data.push_back(static_cast<char>(value >> (8 * i)));
+		}
+
+		void bytes(uint32_t field, std::string_view value)
+		{
+			key(field, 2);
+			rawVarint(value.size());
+			m_data.append(value);
+		}
+
+		void message(uint32_t field, const ProtoWriter& nested)
+		{
+			bytes(field, nested.view());
+		}
+
+	private:
+		void key(uint32_t field, uint32_t wireType)
+		{
+			rawVarint((static_cast<uint64_t>(field) << 3) | wireType);
+		}
+
+		void rawVarint(uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				m_data.push_back(static_cast<char>(value | 0x80));
+				value >>= 7;
+			}
+			m_data.push_back(static_cast<char>(value));
+		}
+
+		std::string m_data;
+	};
+
+	// The session opens with a ClockSnapshot pairing timestamp 0 with the
+	// clock anchor, then a process track that every other track hangs off.
+	// Every event is its own TracePacket on a single sequence. Names and
+	// categories are interned: the first packet that uses a string carries it
+	// in InternedData, later ones only reference its iid. 'X' events become a
+	// SLICE_BEGIN/SLICE_END pair; each thread gets its own track. Async spans
+	// get a track per id; flow events become instants carrying flow ids;
+	// counters get a counter track per name. Fragments (parallel export)
+	// each intern on a sequence of their own and describe the tracks they
+	// use again.
+	class PerfettoExporter final : public TraceExporter
+	{
+	public:
+		explicit PerfettoExporter(uint32_t sequenceId = kSequenceId)
+			: m_sequenceId(sequenceId)
+		{
+		}
+
+		void begin(std::ostream& out, const TraceSessionInfo& session) override
+		{
+			m_out.attach(out);
+			m_session = session;
+
+			m_packet.clear();
+			m_packet.varint(pb::kPacketSequenceId, m_sequenceId);
+			m_packet.varint(pb::kPacketSequenceFlags, pb::kSeqIncrementalStateCleared);
+			writePacket();
+			if (m_sequenceId != kSequenceId)
+				return;
+
+			// Event timestamps are on the default (boot time) clock domain
+			ProtoWriter clock;
+			ProtoWriter snapshot;
+			clock.varint(pb::kClockId, pb::kClockBoottime);
+			clock.varint(pb::kClockTimestamp, 0);
+			snapshot.message(pb::kSnapshotClocks, clock);
+			clock.clear();
+			clock.varint(pb::kClockId, pb::kClockRealtime);
+			clock.varint(pb::kClockTimestamp, static_cast<uint64_t>(session.clockAnchorNs));
+			snapshot.message(pb::kSnapshotClocks, clock);
+			m_packet.clear();
+			m_packet.message(pb::kPacketClockSnapshot, snapshot);
+			writePacket();
+
+			ProtoWriter process;
+			ProtoWriter track;
+			process.varint(pb::kProcessPid, session.pid);
+			process.bytes(pb::kProcessName, session.processName);
+			track.varint(pb::kTrackUuid, kProcessTrack);
+			track.message(pb::kTrackProcess, process);
+			m_packet.clear();
+			m_packet.varint(pb::kPacketSequenceId, m_sequenceId);
+			m_packet.message(pb::kPacketTrackDescriptor, track);
+			writePacket();
+		}
+
+		void writeEvents(const TraceStrings& strings,
+			const TraceThreadInfo& thread,
+			std::span<const TraceEvent> events,
+			std::span<const TraceArg> args) override
+		{
+			// Described again when setThreadName() renames the thread
+			const uint64_t track = kThreadTrackBase + thread.index;
+			if (thread.index >= m_trackNames.size())
+				m_trackNames.resize(thread.index + 1);
+			const std::string name = thread.name.empty()
+				? "Thread " + std::to_string(thread.index)
+				: std::string(thread.name);
+			if (name != m_trackNames[thread.index])
+			{
+				writeTrackDescriptor(track, name);
+				m_trackNames[thread.index] = name;
+			}
+
+			m_namesWritten.resize(strings.names.size(), false);
+			m_categoriesWritten.resize(strings.categories.size(), false);
+
+			for (const TraceEvent& ev : events)
+			{
+				const uint64_t ts = timestampNs(ev.timestamp);
+				if (ev.phase == 'C')
+				{
+					m_interned.clear();
+					m_event.clear();
+					m_event.varint(pb::kEventType, pb::kTypeCounter);
+					m_event.varint(pb::kEventTrackUuid, counterTrack(strings, ev.name));
+					m_event.fixed64(pb::kEventDoubleCounterValue, std::bit_cast<uint64_t>(ev.value));
+					writeEventPacket(ts, false);
+					continue;
+				}
+
+				const bool isEnd = ev.phase == 'E' || ev.phase == 'e';
+				uint64_t eventTrack = track;
+				if (ev.phase == 'b' || ev.phase == 'e' || ev.phase == 'n')
+					eventTrack = asyncTrack(strings, ev);
+
+				m_interned.clear();
+				m_event.clear();
+
+				switch (ev.phase)
+				{
+				case 'E': case 'e':
+					m_event.varint(pb::kEventType, pb::kTypeSliceEnd);
+					break;
+				case 'I': case 'n':
+					m_event.varint(pb::kEventType, pb::kTypeInstant);
+					break;
+				case 's': case 't':
+					m_event.varint(pb::kEventType, pb::kTypeInstant);
+					m_event.fixed64(pb::kEventFlowIds, ev.id);
+					break;
+				case 'f':
+					m_event.varint(pb::kEventType, pb::kTypeInstant);
+					m_event.fixed64(pb::kEventTerminatingFlowIds, ev.id);
+					break;
+				default:
+					m_event.varint(pb::kEventType, pb::kTypeSliceBegin);
+					break;
+				}
+				if (!isEnd)
+				{
+					internName(strings, ev.name);
+					internCategory(strings, ev.category);
+					m_event.varint(pb::kEventNameIid, ev.name + 1ull);
+					m_event.varint(pb::kEventCategoryIids, ev.category + 1ull);
+				}
+				if (ev.argCount > 0 && ev.argIndex + ev.argCount <= args.size())
+					writeAnnotations(strings, args.subspan(ev.argIndex, ev.argCount));
+				m_event.varint(pb::kEventTrackUuid, eventTrack);
+				writeEventPacket(ts, !isEnd);
+
+				if (ev.phase == 'X')
+				{
+					m_interned.clear();
+					m_event.clear();
+					m_event.varint(pb::kEventType, pb::kTypeSliceEnd);
+					m_event.varint(pb::kEventTrackUuid, track);
+					writeEventPacket(ts + static_cast<uint64_t>(m_session.toNs(static_cast<int64_t>(ev.duration))), false);
+				}
+			}
+		}
+
+		void flush() override
+		{
+			m_out.flush();
+		}
+
+		// Perfetto has no generic metadata packet; sampling rates and the
+		// overhead totals are only recorded in the JSON output (the tracer's
+		// counter tracks are regular events)
+		void end(const TraceSummary&) override
+		{
+			m_out.flush();
+		}
+
+		std::unique_ptr<TraceExporter> makeFragment(uint32_t index) const override
+		{
+			return std::make_unique<PerfettoExporter>(kSequenceId + 1 + index);
+		}
+
+	private:
+		static constexpr uint32_t kSequenceId = 1;
+		static constexpr uint64_t kProcessTrack = 1;
+		static constexpr uint64_t kThreadTrackBase = 1000;
+		static constexpr uint64_t kAsyncTrackBase = uint64_t(1) << 63;   // xor'ed with the id
+		static constexpr uint64_t kCounterTrackBase = uint64_t(1) << 62; // plus the name ID
+
+		// Nanoseconds since session start; Perfetto timestamps are unsigned
+		uint64_t timestampNs(ChromeTracer::Ticks ticks) const
+		{
+			const int64_t ns = m_session.sinceStartNs(ticks);
+			return ns > 0 ? static_cast<uint64_t>(ns) : 0;
+		}
+
+		void internName(const TraceStrings& strings, TraceStringId id)
+		{
+			if (m_namesWritten[id])
+				return;
+			m_entry.clear();
+			m_entry.varint(pb::kInternedIid, id + 1ull);
+			m_entry.bytes(pb::kInternedName, strings.names[id]);
+			m_interned.message(pb::kInternedEventNames, m_entry);
+			m_namesWritten[id] = true;
+		}
+
+		void internCategory(const TraceStrings& strings, TraceCategoryId id)
+		{
+			if (m_categoriesWritten[id])
+				return;
+			m_entry.clear();
+			m_entry.varint(pb::kInternedIid, id + 1ull);
+			m_entry.bytes(pb::kInternedName, strings.categories[id]);
+			m_interned.message(pb::kInternedEventCategories, m_entry);
+			m_categoriesWritten[id] = true;
+		}
+
+		// Arguments become debug annotations named inline
+		void writeAnnotations(const TraceStrings& strings, std::span<const TraceArg> args)
+		{
+			for (const TraceArg& arg : args)
+			{
+				m_entry.clear();
+				m_entry.bytes(pb::kAnnotationName, strings.names[arg.key]);
+				switch (arg.type)
+				{
+				case TraceArg::Type::Int:
+					m_entry.varint(pb::kAnnotationInt, static_cast<uint64_t>(arg.intValue));
+					break;
+				case TraceArg::Type::UInt:
+					m_entry.varint(pb::kAnnotationUInt, arg.uintValue);
+					break;
+				case TraceArg::Type::Double:
+					m_entry.fixed64(pb::kAnnotationDouble, std::bit_cast<uint64_t>(arg.doubleValue));
+					break;
+				case TraceArg::Type::Bool:
+					m_entry.varint(pb::kAnnotationBool, arg.boolValue ? 1 : 0);
+					break;
+				case TraceArg::Type::String:
+					m_entry.bytes(pb::kAnnotationString, strings.names[arg.stringValue]);
+					break;
+				}
+				m_event.message(pb::kEventDebugAnnotations, m_entry);
+			}
+		}
+
+		// Counter track of a name, described the first time the name is seen
+		uint64_t counterTrack(const TraceStrings& strings, TraceStringId name)
+		{
+			const uint64_t track = kCounterTrackBase + name;
+			if (name >= m_counterTracks.size())
+				m_counterTracks.resize(name + 1, false);
+			if (!m_counterTracks[name])
+			{
+				writeTrackDescriptor(track, strings.names[name], true);
+				m_counterTracks[name] = true;
+			}
+			return track;
+		}
+
+		// Track of an async id, described the first time the id is seen
+		uint64_t asyncTrack(const TraceStrings& strings, const TraceEvent& ev)
+		{
+			const uint64_t track = kAsyncTrackBase ^ ev.id;
+			if (m_asyncTracks.insert(ev.id).second)
+				writeTrackDescriptor(track, strings.names[ev.name]);
+			return track;
+		}
+
+		void writeTrackDescriptor(uint64_t track, std::string_view name, bool counter = false)
+		{
+			m_entry.clear();
+			m_entry.varint(pb::kTrackUuid, track);
+			m_entry.bytes(pb::kTrackName, name);
+			m_entry.varint(pb::kTrackParentUuid, kProcessTrack);
+			if (counter)
+				m_entry.bytes(pb::kTrackCounter, {});     // empty CounterDescriptor
+
+			m_packet.clear();
+			m_packet.varint(pb::kPacketSequenceId, m_sequenceId);
+			m_packet.message(pb::kPacketTrackDescriptor, m_entry);
+			writePacket();
+		}
+
+		// Slice ends reference no interned strings and skip the sequence flag
+		void writeEventPacket(uint64_t ts, bool usesInterned)
+		{
+			m_packet.clear();
+			m_packet.varint(pb::kPacketTimestamp, ts);
+			m_packet.varint(pb::kPacketSequenceId, m_sequenceId);
+			if (usesInterned)
+				m_packet.varint(pb::kPacketSequenceFlags, pb::kSeqNeedsIncrementalState);
+			if (!m_interned.empty())
+				m_packet.message(pb::kPacketInternedData, m_interned);
+			m_packet.message(pb::kPacketTrackEvent, m_event);
+			writePacket();
+		}
+
+		void writePacket()
+		{
+			m_frame.clear();
+			m_frame.message(pb::kTracePacket, m_packet);
+			m_out.write(m_frame.view());
+		}
+
+		BlockWriter m_out;
+		TraceSessionInfo m_session;
+		uint32_t m_sequenceId;
+		std::vector<bool> m_namesWritten;
+		std::vector<bool> m_categoriesWritten;
+		std::vector<std::string> m_trackNames;    // last described name per thread index
+		std::unordered_set<uint64_t> m_asyncTracks;
+		std::vector<bool> m_counterTracks;
+
+		// Scratch messages, reused so steady-state export does not allocate
+		ProtoWriter m_event;
+		ProtoWriter m_interned;
+		ProtoWriter m_entry;
+		ProtoWriter m_packet;
+		ProtoWriter m_frame;
+	};
+}
+
+void writeProfileJson(std::ostream& out, std::span<const TraceScopeStats> profile)
+{
+	BlockWriter writer;
+	writer.attach(out);
+
+	const auto writeMicros = [&](const char* key, double ns) {
+		constexpr size_t kMaxNumber = 32;
+		writer.write(key);
+		char* start = writer.reserve(kMaxNumber);
+		writer.commit(std::to_chars(start, start + kMaxNumber, ns / 1000.0, std::chars_format::fixed, 3).ptr);
+	};
+
+	std::string text;
+	writer.write("{\"profile\":[");
+	for (size_t i = 0; i < profile.size(); ++i)
+	{
+		const TraceScopeStats& scope = profile[i];
+		text.assign(i == 0 ? "\n{\"name\":\"" : ",\n{\"name\":\"");
+		appendJsonEscaped(text, scope.name);
+		text += "\",\"cat\":\"";
+		appendJsonEscaped(text, scope.category);
+		text += "\",\"count\":";
+		text += std::to_string(scope.count);
+		writer.write(text);
+
+		writeMicros(",\"totalUs\":", scope.totalNs);
+		writeMicros(",\"minUs\":", scope.minNs);
+		writeMicros(",\"maxUs\":", scope.maxNs);
+		writeMicros(",\"p50Us\":", scope.p50Ns);
+		writeMicros(",\"p90Us\":", scope.p90Ns);
+		writeMicros(",\"p99Us\":", scope.p99Ns);
+		writer.put('}');
+	}
+	writer.write("\n]}");
+	writer.flush();
+}
+
+std::unique_ptr<TraceExporter> makeJsonExporter()
+{
+	return std::make_unique<JsonExporter>();
+}
+
+std::unique_ptr<TraceExporter> makePerfettoExporter()
+{
+	return std::make_unique<PerfettoExporter>();
+}
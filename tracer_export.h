@@ -0,0 +1,133 @@
+// tracer_export.h : Output formats for ChromeTracer sessions.
+
+#pragma once
+
+#include "tracer.h"
+
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+// ============================================================================
+// Exporter interface — one instance writes one output file
+// ============================================================================
+
+// Session-wide values an exporter needs to interpret the records
+struct TraceSessionInfo
+{
+	ChromeTracer::Ticks startTicks = 0;      // timestamps are written relative to this
+	double nsPerTick = 1.0;                  // see ChromeTracer::now()
+
+	// Identify the recording process, so traces from several processes or
+	// machines can be merged (see tracer_merge.cpp). The anchor is the
+	// system clock at startTicks; aligning by it assumes the machines'
+	// clocks are synchronized (NTP/PTP).
+	uint32_t pid = 0;
+	std::string_view processName;
+	std::string_view hostName;
+	int64_t clockAnchorNs = 0;               // ns since the Unix epoch
+
+	// Clock ticks → integer nanoseconds
+	int64_t toNs(int64_t ticks) const
+	{
+		return static_cast<int64_t>(static_cast<double>(ticks) * nsPerTick);
+	}
+
+	// Nanoseconds since session start
+	int64_t sinceStartNs(ChromeTracer::Ticks ticks) const
+	{
+		return toNs(static_cast<int64_t>(ticks - startTicks));
+	}
+};
+
+// Sampling applied at one call site (see TRACE_SCOPE_SAMPLED). Durations
+// from the site stand for interval × calls / recorded events.
+struct TraceSamplingInfo
+{
+	std::string_view name;                   // first name recorded at the site
+	uint32_t interval;                       // 1 in interval calls per thread
+	uint32_t maxPerSecond;                   // 0 = no rate limit
+	uint64_t calls;                          // rate-limited sites: calls that passed the interval
+	uint64_t recorded;                       // rate-limited sites: calls admitted
+};
+
+// The tracer's own cost during the session, so timings can be judged
+// against it (see TraceOptions::subtractOverhead)
+struct TraceOverheadInfo
+{
+	double recordNs[kTraceEventKinds] = {};  // one event by TraceEventKind, calibrated at beginSession()
+	double flushNs = 0.0;                    // stream writer passes while recording
+	uint64_t flushes = 0;
+	double lockWaitNs = 0.0;                 // acquiring the string tables' locks on cache misses
+	uint64_t droppedEvents = 0;              // full stream buffers or mapped file
+	bool subtracted = false;                 // recordNs was taken out of enclosing durations
+};
+
+// Session data that is only complete once recording stops
+struct TraceSummary
+{
+	std::span<const TraceSamplingInfo> sampling;
+	TraceOverheadInfo overhead;
+};
+
+// Recording thread a batch of events belongs to
+struct TraceThreadInfo
+{
+	uint32_t index;                          // dense, in registration order; same as TraceEvent::thread
+	std::string_view name;                   // from setThreadName(), empty if unset
+	std::optional<int32_t> sortIndex;
+};
+
+// ID → string tables. They only grow, so an ID stays valid once seen.
+// Argument keys and string values are names.
+struct TraceStrings
+{
+	std::span<const std::string_view> names;
+	std::span<const std::string_view> categories;
+};
+
+class TraceExporter
+{
+public:
+	virtual ~TraceExporter() = default;
+
+	// Called once before any events; out must stay valid until end()
+	virtual void begin(std::ostream& out, const TraceSessionInfo& session) = 0;
+
+	// Called any number of times. In streaming mode batches keep arriving
+	// while the session is recording. An event's arguments are
+	// args[argIndex, argIndex + argCount).
+	virtual void writeEvents(const TraceStrings& strings,
+		const TraceThreadInfo& thread,
+		std::span<const TraceEvent> events,
+		std::span<const TraceArg> args) = 0;
+
+	// Hand everything buffered so far to the stream
+	virtual void flush() = 0;
+
+	// Called once after the last batch; flushes
+	virtual void end(const TraceSummary& summary) = 0;
+
+	// Parallel export: an exporter for one fragment of this output, whose
+	// begin() and end() write no file framing. Fragments are independent of
+	// each other and of this exporter, so they can be written on separate
+	// threads; their output goes between this exporter's writeEvents() calls
+	// and its end(), in index order. Called from any thread once begin() has
+	// run. nullptr (the default) exports on one thread.
+	virtual std::unique_ptr<TraceExporter> makeFragment(uint32_t index) const
+	{
+		(void)index;
+		return nullptr;
+	}
+};
+
+// Aggregation mode report: {"profile":[{"name":..,"cat":..,"count":..,
+// "totalUs":..,"minUs":..,"maxUs":..,"p50Us":..,"p90Us":..,"p99Us":..}]}
+void writeProfileJson(std::ostream& out, std::span<const TraceScopeStats> profile);
+
+// Chrome JSON ("traceEvents" array), loadable in chrome://tracing and Perfetto
+std::unique_ptr<TraceExporter> makeJsonExporter();
+
+// Perfetto TracePacket protobuf with interned strings, loadable in ui.perfetto.dev
+std::unique_ptr<TraceExporter> makePerfettoExporter();
@@ -0,0 +1,46 @@
+// tracer_instrument.cpp : Hooks for -finstrument-functions, built when
+// TRACER_INSTRUMENT_FUNCTIONS is on (see CMakeLists.txt).
+//
+// Code compiled with -finstrument-functions calls these on every function
+// entry and exit. Outside a session they cost one load; inside one, an
+// event with the function's address and the clock. Names are looked up
+// when the trace is written, so code addresses need a symbol to show up
+// by name: link executables with -rdynamic (CMake ENABLE_EXPORTS), or look
+// up the "module+0xoffset" names with addr2line.
+
+#include "tracer.h"
+
+#if defined(__GNUC__)
+#define TRACER_NO_INSTRUMENT __attribute__((no_instrument_function))
+#else
+#define TRACER_NO_INSTRUMENT
+#endif
+
+namespace
+{
+	// Anything the tracer calls that is itself instrumented lands here again
+	thread_local bool t_inHook = false;
+}
+
+extern "C"
+{
+	TRACER_NO_INSTRUMENT void __cyg_profile_func_enter(void* function, void* callSite)
+	{
+		(void)callSite;
+		if (!ChromeTracer::isInstrumenting() || t_inHook)
+			return;
+		t_inHook = true;
+		ChromeTracer::instance().addFunctionEnter(function);
+		t_inHook = false;
+	}
+
+	TRACER_NO_INSTRUMENT void __cyg_profile_func_exit(void* function, void* callSite)
+	{
+		(void)callSite;
+		if (!ChromeTracer::isInstrumenting() || t_inHook)
+			return;
+		t_inHook = true;
+		ChromeTracer::instance().addFunctionExit(function);
+		t_inHook = false;
+	}
+}
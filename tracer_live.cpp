@@ -0,0 +1,253 @@
+#include "tracer_live.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t kSlotEvents = 1024;       // one stream chunk per slot
+	constexpr uint32_t kSlotArgs = 512;
+	constexpr size_t kLiveAlign = 64;
+	constexpr size_t kMinStrings = size_t(64) << 10;
+
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void copyTruncated(char (&target)[128], std::string_view source)
+	{
+		const size_t length = std::min(source.size(), sizeof(target) - 1);
+		std::memcpy(target, source.data(), length);
+		target[length] = '\0';
+	}
+
+	class LiveExporter final : public TraceExporter
+	{
+	public:
+		LiveExporter() = default;
+		LiveExporter(const LiveExporter&) = delete;
+		LiveExporter& operator=(const LiveExporter&) = delete;
+
+		~LiveExporter() override
+		{
+			if (!m_base)
+				return;
+			removeName();
+#if defined(_WIN32)
+			UnmapViewOfFile(m_base);
+			CloseHandle(m_mapping);
+#else
+			munmap(m_base, m_bytes);
+#endif
+		}
+
+		// The header stays without its magic until begin() has filled it in
+		bool open(const std::string& name, size_t bytes)
+		{
+			const size_t argsOffset = alignUp(sizeof(TraceLiveSlot) + kSlotEvents * sizeof(TraceEvent), alignof(TraceArg));
+			const size_t slotBytes = alignUp(argsOffset + kSlotArgs * sizeof(TraceArg), kLiveAlign);
+			const size_t stringsOffset = alignUp(sizeof(TraceLiveHeader), kLiveAlign);
+			const size_t stringsBytes = alignUp(std::max(bytes / 16, kMinStrings), kLiveAlign);
+			const size_t slotsOffset = alignUp(stringsOffset + stringsBytes, kLiveAlign);
+			if (bytes < slotsOffset + slotBytes)
+				return false;
+
+#if defined(_WIN32)
+			m_name = "Local\\" + name;
+			const DWORD high = static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32);
+			const DWORD low = static_cast<DWORD>(bytes & 0xffffffffu);
+			m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, high, low, m_name.c_str());
+			if (!m_mapping)
+				return false;
+			void* view = MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, bytes);
+			if (!view)
+			{
+				CloseHandle(m_mapping);
+				return false;
+			}
+			std::memset(view, 0, sizeof(TraceLiveHeader));    // the mapping may have existed
+#else
+			m_name = "/" + name;
+			shm_unlink(m_name.c_str());              // a segment left by a crashed process
+			const int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd < 0)
+				return false;
+			if (ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+			{
+				::close(fd);
+				shm_unlink(m_name.c_str());
+				return false;
+			}
+			void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (view == MAP_FAILED)
+			{
+				shm_unlink(m_name.c_str());
+				return false;
+			}
+#endif
+
+			m_base = static_cast<std::byte*>(view);
+			m_bytes = bytes;
+			m_header = new (m_base) TraceLiveHeader{};
+			m_header->version = TraceLiveHeader::kVersion;
+			m_header->state = TraceLiveHeader::Recording;
+			m_header->eventBytes = sizeof(TraceEvent);
+			m_header->argBytes = sizeof(TraceArg);
+			m_header->slotBytes = static_cast<uint32_t>(slotBytes);
+			m_header->slotEvents = kSlotEvents;
+			m_header->slotArgs = kSlotArgs;
+			m_header->argsOffset = static_cast<uint32_t>(argsOffset);
+			m_header->stringsOffset = stringsOffset;
+			m_header->stringsBytes = stringsBytes;
+			m_header->slotsOffset = slotsOffset;
+			m_header->slotCount = (bytes - slotsOffset) / slotBytes;
+			return true;
+		}
+
+		void begin(std::ostream&, const TraceSessionInfo& session) override
+		{
+			m_header->startTicks = session.startTicks;
+			m_header->nsPerTick = session.nsPerTick;
+			m_header->clockAnchorNs = session.clockAnchorNs;
+			m_header->pid = session.pid;
+			copyTruncated(m_header->processName, session.processName);
+			copyTruncated(m_header->hostName, session.hostName);
+			std::atomic_thread_fence(std::memory_order_release);
+			std::memcpy(m_header->magic, TraceLiveHeader::kMagic, sizeof(m_header->magic));
+		}
+
+		void writeEvents(const TraceStrings& strings,
+			const TraceThreadInfo& thread,
+			std::span<const TraceEvent> events,
+			std::span<const TraceArg> args) override
+		{
+			publishStrings(TraceMappedString::Name, strings.names, m_namesPublished);
+			publishStrings(TraceMappedString::Category, strings.categories, m_categoriesPublished);
+			publishThread(thread);
+			for (size_t first = 0; first < events.size(); first += kSlotEvents)
+				publish(thread, events.subspan(first, std::min<size_t>(kSlotEvents, events.size() - first)), args);
+		}
+
+		// Slots are visible as soon as they are published
+		void flush() override
+		{
+		}
+
+		void end(const TraceSummary&) override
+		{
+			std::atomic_ref<uint32_t>(m_header->state).store(TraceLiveHeader::Closed, std::memory_order_release);
+			removeName();
+		}
+
+	private:
+		// Strings that no longer fit are left out; the collector shows their IDs
+		void publishString(TraceMappedString::Table table, uint32_t id, std::string_view str)
+		{
+			std::atomic_ref<uint64_t> used(m_header->stringsUsed);
+			const uint64_t offset = used.load(std::memory_order_relaxed);
+			const size_t recordBytes = alignUp(sizeof(TraceMappedString) + str.size(), 4);
+			if (offset + recordBytes > m_header->stringsBytes)
+				return;
+
+			std::byte* record = m_base + m_header->stringsOffset + offset;
+			const TraceMappedString entry{ table, id, static_cast<uint32_t>(str.size()) };
+			std::memcpy(record, &entry, sizeof(entry));
+			std::memcpy(record + sizeof(entry), str.data(), str.size());
+			used.store(offset + recordBytes, std::memory_order_release);
+		}
+
+		void publishStrings(TraceMappedString::Table table, std::span<const std::string_view> source, size_t& published)
+		{
+			for (; published < source.size(); ++published)
+				publishString(table, static_cast<uint32_t>(published), source[published]);
+		}
+
+		void publishThread(const TraceThreadInfo& thread)
+		{
+			if (thread.name.empty())
+				return;
+			if (thread.index >= m_threadNames.size())
+				m_threadNames.resize(thread.index + 1);
+			if (m_threadNames[thread.index] == thread.name)
+				return;
+			m_threadNames[thread.index] = thread.name;
+			publishString(TraceMappedString::Thread, thread.index, thread.name);
+		}
+
+		// Arguments that do not fit into the slot are dropped with their events'
+		// references to them
+		void publish(const TraceThreadInfo& thread, std::span<const TraceEvent> events, std::span<const TraceArg> args)
+		{
+			std::atomic_ref<uint64_t> writeIndex(m_header->writeIndex);
+			const uint64_t index = writeIndex.load(std::memory_order_relaxed);
+			const uint64_t read = std::atomic_ref<uint64_t>(m_header->readIndex).load(std::memory_order_acquire);
+			if (index - read >= m_header->slotCount)
+			{
+				std::atomic_ref<uint64_t>(m_header->droppedEvents).fetch_add(events.size(), std::memory_order_relaxed);
+				return;
+			}
+
+			std::byte* slot = m_base + m_header->slotsOffset + (index % m_header->slotCount) * m_header->slotBytes;
+			const size_t argCount = std::min<size_t>(args.size(), kSlotArgs);
+			const TraceLiveSlot header{ thread.index, static_cast<uint32_t>(events.size()), static_cast<uint32_t>(argCount),
+				thread.sortIndex ? TraceLiveSlot::kSorted : 0u, thread.sortIndex.value_or(0) };
+			std::memcpy(slot, &header, sizeof(header));
+			auto* slotEvents = reinterpret_cast<TraceEvent*>(slot + sizeof(TraceLiveSlot));
+			std::memcpy(slotEvents, events.data(), events.size_bytes());
+			std::memcpy(slot + m_header->argsOffset, args.data(), argCount * sizeof(TraceArg));
+			if (argCount < args.size())
+			{
+				for (size_t i = 0; i < events.size(); ++i)
+				{
+					if (slotEvents[i].argIndex + size_t(slotEvents[i].argCount) > argCount)
+						slotEvents[i].argCount = 0;
+				}
+			}
+			writeIndex.store(index + 1, std::memory_order_release);
+		}
+
+		// New collectors cannot attach once the session has ended
+		void removeName()
+		{
+#if !defined(_WIN32)
+			if (!m_name.empty())
+				shm_unlink(m_name.c_str());
+#endif
+			m_name.clear();
+		}
+
+		std::byte* m_base = nullptr;
+		size_t m_bytes = 0;
+		TraceLiveHeader* m_header = nullptr;
+#if defined(_WIN32)
+		HANDLE m_mapping = nullptr;                  // the segment lives while a handle is open
+#endif
+		std::string m_name;
+		size_t m_namesPublished = 0;
+		size_t m_categoriesPublished = 0;
+		std::vector<std::string> m_threadNames;      // last published, by thread index
+	};
+}
+
+std::unique_ptr<TraceExporter> makeLiveExporter(const std::string& name, size_t bytes)
+{
+	auto exporter = std::make_unique<LiveExporter>();
+	if (!exporter->open(name, bytes))
+		return nullptr;
+	return exporter;
+}
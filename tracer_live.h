@@ -0,0 +1,91 @@
+// tracer_live.h : Shared-memory layout of live mode (TraceOptions::liveName).
+
+#pragma once
+
+#include "tracer_export.h"
+#include "tracer_mapped.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// ============================================================================
+// Live trace segment
+// ============================================================================
+
+// The session's stream writer publishes each batch of events into a
+// single-producer, single-consumer ring of slots in a named shared-memory
+// segment, and tracer_collect.cpp drains it and forwards a regular trace.
+// Recording threads never touch the segment. When the collector falls
+// behind (or none is attached), the ring fills and batches are dropped and
+// counted rather than waited for. As in tracer_mapped.h, values are native
+// endian.
+//
+//   [header][string records][slots]
+//
+// The writer publishes strings before the slots using them, then bumps
+// writeIndex (release); the collector copies slots out, then bumps
+// readIndex (release). A slot is free again once readIndex has passed it.
+struct TraceLiveHeader
+{
+	static constexpr char kMagic[8] = { 'T', 'R', 'C', 'L', 'I', 'V', 'E', '\0' };
+	static constexpr uint32_t kVersion = 1;
+
+	enum State : uint32_t
+	{
+		Recording = 0,                       // still recording, or the process died
+		Closed = 1,                          // the session ended
+	};
+
+	char magic[8];
+	uint32_t version;
+	uint32_t state;
+
+	// Session, see TraceSessionInfo
+	uint64_t startTicks;
+	double nsPerTick;
+	int64_t clockAnchorNs;
+	uint32_t pid;
+	uint32_t reserved;
+	char processName[128];                   // truncated, NUL-terminated
+	char hostName[128];
+
+	uint32_t eventBytes;                     // sizeof(TraceEvent)
+	uint32_t argBytes;                       // sizeof(TraceArg)
+	uint32_t slotBytes;                      // stride between slots
+	uint32_t slotEvents;                     // capacity of one slot
+	uint32_t slotArgs;
+	uint32_t argsOffset;                     // within a slot; events follow TraceLiveSlot
+
+	uint64_t stringsOffset;                  // TraceMappedString records, append only
+	uint64_t stringsBytes;
+	uint64_t stringsUsed;
+	uint64_t slotsOffset;
+	uint64_t slotCount;
+	uint64_t writeIndex;                     // slots published, bumped by the tracer
+	uint64_t readIndex;                      // slots consumed, bumped by the collector
+	uint64_t droppedEvents;                  // found the ring full
+};
+
+// Start of each slot: one batch of one thread's events, followed by
+// TraceEvent[count], and TraceArg[argCount] at TraceLiveHeader::argsOffset.
+// Thread names travel as TraceMappedString::Thread records.
+struct TraceLiveSlot
+{
+	static constexpr uint32_t kSorted = 1;
+
+	uint32_t thread;                         // see TraceEvent::thread
+	uint32_t count;
+	uint32_t argCount;
+	uint32_t flags;
+	int64_t sortIndex;                       // if kSorted
+};
+
+static_assert(sizeof(TraceLiveSlot) == 24);
+
+// The exporter behind live mode: creates the segment (replacing one left
+// with the same name) and ignores the stream passed to begin(). end() marks
+// the segment closed and removes its name; a collector that has it open
+// keeps reading until it has drained the last slots. nullptr if the segment
+// cannot be created or bytes is too small for one slot.
+std::unique_ptr<TraceExporter> makeLiveExporter(const std::string& name, size_t bytes);
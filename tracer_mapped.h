@@ -0,0 +1,100 @@
+// tracer_mapped.h : File layout of mapped mode (TraceOptions::mappedBytes).
+
+#pragma once
+
+#include <cstdint>
+
+// ============================================================================
+// Mapped trace file
+// ============================================================================
+
+// Recording threads write their chunks straight into a shared mapping of the
+// file, so whatever was recorded is in the page cache even if the process
+// dies, and tracer_recover.cpp turns it into a regular trace afterwards.
+// Crash dumps (TraceOptions::crashDumpPath) use the same layout, written
+// all at once by the crash handler. Values are native endian; the file is
+// only meant to be read on the architecture that wrote it.
+//
+//   [header][thread table][string records][chunks]
+//
+// Counters the recorder bumps while running (chunksUsed, stringsUsed, state,
+// thread flags) are updated atomically, and everything they cover is written
+// before them.
+struct TraceMappedHeader
+{
+	static constexpr char kMagic[8] = { 'T', 'R', 'C', 'M', 'A', 'P', '\0', '\0' };
+	static constexpr uint32_t kVersion = 1;
+
+	enum State : uint32_t
+	{
+		Recording = 0,                       // still recording, or the process died
+		Closed = 1,                          // endSession() ran
+	};
+
+	char magic[8];
+	uint32_t version;
+	uint32_t state;
+
+	// Session, see TraceSessionInfo. nsPerTick is refined at endSession().
+	uint64_t startTicks;
+	double nsPerTick;
+	int64_t clockAnchorNs;
+	uint32_t pid;
+	uint32_t reserved;
+	char processName[128];                   // truncated, NUL-terminated
+	char hostName[128];
+
+	// Record layout, so a reader built from different sources can tell
+	uint32_t eventBytes;                     // sizeof(TraceEvent)
+	uint32_t argBytes;                       // sizeof(TraceArg)
+
+	// Chunk geometry: each chunk holds up to chunkEvents events at eventsOffset
+	// and chunkArgs arguments at argsOffset. The published event and argument
+	// counts are countBytes wide.
+	uint32_t chunkBytes;                     // stride between chunks
+	uint32_t chunkEvents;
+	uint32_t chunkArgs;
+	uint32_t eventsOffset;
+	uint32_t argsOffset;
+	uint32_t countOffset;
+	uint32_t argCountOffset;
+	uint32_t countBytes;
+
+	uint64_t threadsOffset;                  // TraceMappedThread[threadCapacity]
+	uint64_t threadCapacity;
+	uint64_t stringsOffset;                  // TraceMappedString records
+	uint64_t stringsBytes;
+	uint64_t stringsUsed;
+	uint64_t chunksOffset;
+	uint64_t chunkCapacity;
+	uint64_t chunksUsed;                     // may exceed chunkCapacity once full
+};
+
+// Indexed by TraceEvent::thread; threads past the table's end stay unnamed
+struct TraceMappedThread
+{
+	static constexpr uint32_t kNamed = 1;
+	static constexpr uint32_t kSorted = 2;
+
+	uint32_t flags;
+	uint32_t name;                           // name ID, see setThreadName()
+	int64_t sortIndex;
+};
+
+// An interned string, followed by length bytes and padding to 4 bytes
+struct TraceMappedString
+{
+	enum Table : uint32_t
+	{
+		Name = 1,
+		Category = 2,
+		Thread = 3,                          // live segments: id is the thread index, latest wins
+	};
+
+	uint32_t table;
+	uint32_t id;
+	uint32_t length;
+};
+
+static_assert(sizeof(TraceMappedThread) == 16);
+static_assert(sizeof(TraceMappedString) == 12);
@@ -0,0 +1,1077 @@
+// tracer_merge.cpp : Merges traces recorded by several processes, possibly on
+// different machines, into one file.
+//
+//   tracer_merge -o merged.json server.json worker1.json worker2.json
+//
+// Each session records the system clock at its start (see TraceSessionInfo),
+// so every input is shifted by how much later than the earliest one it
+// started. Processes that share a pid (e.g. the same service on two hosts)
+// get fresh pids in the output. Inputs are streamed one event at a time, so
+// memory use does not grow with trace size.
+//
+// All inputs must be in the same format: Chrome JSON as written by
+// makeJsonExporter(), or Perfetto protobuf as written by makePerfettoExporter().
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// ========================================================================
+	// Buffered file I/O
+	// ========================================================================
+
+	class InputFile
+	{
+	public:
+		static constexpr size_t kBufferSize = 1 << 20;
+
+		InputFile()
+			: m_buffer(std::make_unique<char[]>(kBufferSize))
+		{
+		}
+
+		bool open(const std::string& path)
+		{
+			m_file.open(path, std::ios::binary);
+			return m_file.is_open();
+		}
+
+		void rewind()
+		{
+			m_file.clear();
+			m_file.seekg(0);
+			m_pos = 0;
+			m_size = 0;
+		}
+
+		int get()
+		{
+			if (m_pos == m_size && !refill())
+				return EOF;
+			return static_cast<unsigned char>(m_buffer[m_pos++]);
+		}
+
+		int peek()
+		{
+			if (m_pos == m_size && !refill())
+				return EOF;
+			return static_cast<unsigned char>(m_buffer[m_pos]);
+		}
+
+		// Appends exactly n bytes; false at end of file
+		bool read(size_t n, std::string& out)
+		{
+			while (n > 0)
+			{
+				if (m_pos == m_size && !refill())
+					return false;
+				const size_t count = std::min(n, m_size - m_pos);
+				out.append(m_buffer.get() + m_pos, count);
+				m_pos += count;
+				n -= count;
+			}
+			return true;
+		}
+
+	private:
+		bool refill()
+		{
+			m_file.read(m_buffer.get(), kBufferSize);
+			m_size = static_cast<size_t>(m_file.gcount());
+			m_pos = 0;
+			return m_size > 0;
+		}
+
+		std::ifstream m_file;
+		std::unique_ptr<char[]> m_buffer;
+		size_t m_pos = 0;
+		size_t m_size = 0;
+	};
+
+	class OutputFile
+	{
+	public:
+		static constexpr size_t kFlushSize = 1 << 20;
+
+		bool open(const std::string& path)
+		{
+			m_file.open(path, std::ios::binary);
+			return m_file.is_open();
+		}
+
+		void write(std::string_view text)
+		{
+			m_buffer.append(text);
+			if (m_buffer.size() >= kFlushSize)
+				flush();
+		}
+
+		bool close()
+		{
+			flush();
+			m_file.close();
+			return !m_file.fail();
+		}
+
+	private:
+		void flush()
+		{
+			m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+			m_buffer.clear();
+		}
+
+		std::ofstream m_file;
+		std::string m_buffer;
+	};
+
+	// One input trace
+	struct Source
+	{
+		std::string path;
+		InputFile file;
+		std::optional<int64_t> clockAnchorNs;   // absent in traces from older versions
+		std::optional<int64_t> pid;
+		int64_t outputPid = 0;
+		int64_t shiftNs = 0;                     // added to every timestamp
+		std::string processName;                 // JSON: raw string literal
+		std::string hostName;
+	};
+
+	// Gives each process a pid no other input uses
+	void assignPids(std::vector<std::unique_ptr<Source>>& sources)
+	{
+		std::set<int64_t> used;
+		int64_t next = 0;
+		for (const auto& source : sources)
+		{
+			if (source->pid)
+				next = std::max(next, *source->pid + 1);
+		}
+		for (const auto& source : sources)
+		{
+			if (!source->pid)
+				continue;
+			source->outputPid = used.count(*source->pid) ? next++ : *source->pid;
+			used.insert(source->outputPid);
+		}
+	}
+
+	// Inputs without an anchor are assumed to start with the earliest one
+	int64_t alignClocks(std::vector<std::unique_ptr<Source>>& sources)
+	{
+		std::optional<int64_t> earliest;
+		for (const auto& source : sources)
+		{
+			if (source->clockAnchorNs && (!earliest || *source->clockAnchorNs < *earliest))
+				earliest = source->clockAnchorNs;
+		}
+		for (const auto& source : sources)
+		{
+			if (source->clockAnchorNs)
+				source->shiftNs = *source->clockAnchorNs - *earliest;
+			else
+				std::cerr << source->path << ": no clock anchor, timestamps left as they are\n";
+		}
+		return earliest.value_or(0);
+	}
+
+	// ========================================================================
+	// Chrome JSON
+	// ========================================================================
+
+	bool isJsonSpace(int c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	void skipSpace(InputFile& in)
+	{
+		while (isJsonSpace(in.peek()))
+			in.get();
+	}
+
+	// Appends the raw text of the next value (string, object, array or
+	// scalar). Strings keep their escapes, so values pass through unchanged.
+	bool readValue(InputFile& in, std::string& out)
+	{
+		skipSpace(in);
+		int depth = 0;
+		bool inString = false;
+		for (;;)
+		{
+			const int c = in.peek();
+			if (c == EOF)
+				return !inString && depth == 0 && !out.empty();
+			if (inString)
+			{
+				out.push_back(static_cast<char>(in.get()));
+				if (c == '\\')
+				{
+					const int escaped = in.get();
+					if (escaped == EOF)
+						return false;
+					out.push_back(static_cast<char>(escaped));
+				}
+				else if (c == '"')
+				{
+					inString = false;
+					if (depth == 0)
+						return true;
+				}
+				continue;
+			}
+			if (depth == 0 && (c == ',' || c == '}' || c == ']' || isJsonSpace(c)))
+				return !out.empty();
+			out.push_back(static_cast<char>(in.get()));
+			if (c == '"')
+				inString = true;
+			else if (c == '{' || c == '[')
+				++depth;
+			else if (c == '}' || c == ']')
+			{
+				if (--depth == 0)
+					return true;
+			}
+		}
+	}
+
+	bool readKey(InputFile& in, std::string& key)
+	{
+		key.clear();
+		if (!readValue(in, key) || key.size() < 2 || key.front() != '"')
+			return false;
+		key = key.substr(1, key.size() - 2);
+		skipSpace(in);
+		return in.get() == ':';
+	}
+
+	// End of the value starting at pos in text
+	size_t skipValue(std::string_view text, size_t pos)
+	{
+		int depth = 0;
+		bool inString = false;
+		for (; pos < text.size(); ++pos)
+		{
+			const char c = text[pos];
+			if (inString)
+			{
+				if (c == '\\')
+					++pos;
+				else if (c == '"')
+				{
+					inString = false;
+					if (depth == 0)
+						return pos + 1;
+				}
+			}
+			else if (c == '"')
+				inString = true;
+			else if (c == '{' || c == '[')
+				++depth;
+			else if (c == '}' || c == ']')
+			{
+				if (depth == 0)
+					return pos;
+				if (--depth == 0)
+					return pos + 1;
+			}
+			else if (depth == 0 && (c == ',' || isJsonSpace(c)))
+				return pos;
+		}
+		return pos;
+	}
+
+	size_t skipSpace(std::string_view text, size_t pos)
+	{
+		while (pos < text.size() && isJsonSpace(text[pos]))
+			++pos;
+		return pos;
+	}
+
+	// Calls fn(key, valueBegin, valueEnd) for each member of a JSON object
+	template <typename Fn>
+	void forEachMember(std::string_view object, Fn&& fn)
+	{
+		size_t pos = skipSpace(object, 0);
+		if (pos == object.size() || object[pos] != '{')
+			return;
+		++pos;
+		for (;;)
+		{
+			pos = skipSpace(object, pos);
+			if (pos >= object.size() || object[pos] != '"')
+				return;
+			const size_t keyEnd = skipValue(object, pos);
+			const std::string_view key = object.substr(pos + 1, keyEnd - pos - 2);
+			pos = skipSpace(object, keyEnd);
+			if (pos >= object.size() || object[pos] != ':')
+				return;
+			const size_t valueBegin = skipSpace(object, pos + 1);
+			const size_t valueEnd = skipValue(object, valueBegin);
+			fn(key, valueBegin, valueEnd);
+			pos = skipSpace(object, valueEnd);
+			if (pos >= object.size() || object[pos] != ',')
+				return;
+			++pos;
+		}
+	}
+
+	std::optional<int64_t> parseInteger(std::string_view text)
+	{
+		int64_t value = 0;
+		const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (result.ec != std::errc() || result.ptr != text.data() + text.size())
+			return std::nullopt;
+		return value;
+	}
+
+	// "ts" values are microseconds; parsed exactly to nanoseconds when they
+	// have at most three decimals, as the JSON exporter writes them
+	std::optional<int64_t> parseMicrosAsNs(std::string_view text)
+	{
+		const size_t dot = text.find('.');
+		if (text.find_first_of("eE") == std::string_view::npos
+			&& (dot == std::string_view::npos || text.size() - dot - 1 <= 3))
+		{
+			const bool negative = !text.empty() && text.front() == '-';
+			const auto whole = parseInteger(text.substr(negative ? 1 : 0, dot == std::string_view::npos ? std::string_view::npos : dot - (negative ? 1 : 0)));
+			if (!whole)
+				return std::nullopt;
+			int64_t fraction = 0;
+			if (dot != std::string_view::npos)
+			{
+				const std::string_view digits = text.substr(dot + 1);
+				for (size_t i = 0; i < 3; ++i)
+				{
+					const char digit = i < digits.size() ? digits[i] : '0';
+					if (digit < '0' || digit > '9')
+						return std::nullopt;
+					fraction = fraction * 10 + (digit - '0');
+				}
+			}
+			const int64_t ns = *whole * 1000 + fraction;
+			return negative ? -ns : ns;
+		}
+		const std::string copy(text);
+		char* end = nullptr;
+		const double micros = std::strtod(copy.c_str(), &end);
+		if (end != copy.c_str() + copy.size())
+			return std::nullopt;
+		return static_cast<int64_t>(micros * 1000.0 + (micros < 0 ? -0.5 : 0.5));
+	}
+
+	void appendMicros(std::string& out, int64_t ns)
+	{
+		uint64_t magnitude = static_cast<uint64_t>(ns);
+		if (ns < 0)
+		{
+			out.push_back('-');
+			magnitude = 0 - magnitude;
+		}
+		out += std::to_string(magnitude / 1000);
+		const auto fraction = static_cast<unsigned>(magnitude % 1000);
+		out.push_back('.');
+		out.push_back(static_cast<char>('0' + fraction / 100));
+		out.push_back(static_cast<char>('0' + fraction / 10 % 10));
+		out.push_back(static_cast<char>('0' + fraction % 10));
+	}
+
+	class JsonMerger
+	{
+	public:
+		// Reads up to the "traceEvents" array; false if the input has none
+		bool readHeader(Source& source)
+		{
+			InputFile& in = source.file;
+			skipSpace(in);
+			if (in.get() != '{')
+				return false;
+			std::string key;
+			std::string value;
+			for (;;)
+			{
+				skipSpace(in);
+				if (!readKey(in, key))
+					return false;
+				if (key == "traceEvents")
+					return true;
+				value.clear();
+				if (!readValue(in, value))
+					return false;
+				topLevel(source, key, value);
+				skipSpace(in);
+				if (in.get() != ',')
+					return false;
+			}
+		}
+
+		void begin(OutputFile& out, const std::vector<std::unique_ptr<Source>>& sources, int64_t clockAnchorNs)
+		{
+			std::string header = "{\"otherData\":{\"clockAnchorNs\":" + std::to_string(clockAnchorNs) + ",\"sources\":[";
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				const Source& source = *sources[i];
+				header += i == 0 ? "{\"file\":\"" : ",{\"file\":\"";
+				for (const char c : source.path)
+				{
+					if (c == '"' || c == '\\')
+						header.push_back('\\');
+					header.push_back(c);
+				}
+				header += "\"";
+				if (source.pid)
+					header += ",\"pid\":" + std::to_string(source.outputPid);
+				if (!source.processName.empty())
+					header += ",\"processName\":" + source.processName;
+				if (!source.hostName.empty())
+					header += ",\"hostName\":" + source.hostName;
+				header += ",\"shiftNs\":" + std::to_string(source.shiftNs) + "}";
+			}
+			header += "]},\"traceEvents\":[";
+			out.write(header);
+		}
+
+		// Streams the events, then reads the members after the array
+		bool copyEvents(OutputFile& out, Source& source)
+		{
+			InputFile& in = source.file;
+			skipSpace(in);
+			if (in.get() != '[')
+				return false;
+			for (;;)
+			{
+				skipSpace(in);
+				if (in.peek() == ']')
+				{
+					in.get();
+					break;
+				}
+				m_event.clear();
+				if (!readValue(in, m_event))
+					return false;
+				rewriteEvent(source);
+				out.write(m_first ? "\n" : ",\n");
+				m_first = false;
+				out.write(m_rewritten);
+				skipSpace(in);
+				const int c = in.get();
+				if (c == ']')
+					break;
+				if (c != ',')
+					return false;
+			}
+
+			std::string key;
+			std::string value;
+			for (;;)
+			{
+				skipSpace(in);
+				const int c = in.get();
+				if (c == '}')
+					return true;
+				if (c != ',' || !readKey(in, key))
+					return false;
+				value.clear();
+				if (!readValue(in, value))
+					return false;
+				topLevel(source, key, value);
+			}
+		}
+
+		void end(OutputFile& out)
+		{
+			out.write("\n]");
+			if (!m_sampling.empty() || !m_overhead.empty())
+			{
+				out.write(",\"metadata\":{");
+				if (!m_sampling.empty())
+				{
+					out.write("\"sampling\":[");
+					out.write(m_sampling);
+					out.write(m_overhead.empty() ? "]" : "],");
+				}
+				if (!m_overhead.empty())
+				{
+					out.write("\"overhead\":[");
+					out.write(m_overhead);
+					out.write("]");
+				}
+				out.write("}");
+			}
+			out.write("}\n");
+		}
+
+	private:
+		void topLevel(Source& source, std::string_view key, std::string_view value)
+		{
+			if (key == "otherData")
+			{
+				forEachMember(value, [&](std::string_view member, size_t begin, size_t end) {
+					const std::string_view text = value.substr(begin, end - begin);
+					if (member == "pid")
+						source.pid = parseInteger(text);
+					else if (member == "clockAnchorNs")
+						source.clockAnchorNs = parseInteger(text);
+					else if (member == "processName")
+						source.processName = text;
+					else if (member == "hostName")
+						source.hostName = text;
+				});
+			}
+			else if (key == "metadata")
+			{
+				// Sampling entries and overhead totals are kept, tagged with
+				// their process
+				forEachMember(value, [&](std::string_view member, size_t begin, size_t end) {
+					if (member == "overhead" && value[begin] == '{')
+					{
+						if (!m_overhead.empty())
+							m_overhead.push_back(',');
+						m_overhead += "{\"pid\":" + std::to_string(source.outputPid) + ",";
+						m_overhead.append(value.substr(begin + 1, end - begin - 1));
+						return;
+					}
+					if (member != "sampling" || value[begin] != '[')
+						return;
+					size_t pos = begin + 1;
+					while ((pos = skipSpace(value, pos)) < end && value[pos] == '{')
+					{
+						const size_t entryEnd = skipValue(value, pos);
+						if (!m_sampling.empty())
+							m_sampling.push_back(',');
+						m_sampling += "{\"pid\":" + std::to_string(source.outputPid) + ",";
+						m_sampling.append(value.substr(pos + 1, entryEnd - pos - 1));
+						pos = skipSpace(value, entryEnd);
+						if (pos < end && value[pos] == ',')
+							++pos;
+					}
+				});
+			}
+		}
+
+		// Copies m_event to m_rewritten with "ts" shifted and "pid" mapped
+		void rewriteEvent(const Source& source)
+		{
+			m_rewritten.clear();
+			size_t copied = 0;
+			const std::string_view event = m_event;
+			forEachMember(event, [&](std::string_view key, size_t begin, size_t end) {
+				const std::string_view text = event.substr(begin, end - begin);
+				if (key == "ts" && source.shiftNs != 0)
+				{
+					if (const auto ns = parseMicrosAsNs(text))
+					{
+						m_rewritten.append(event.substr(copied, begin - copied));
+						appendMicros(m_rewritten, *ns + source.shiftNs);
+						copied = end;
+					}
+				}
+				else if (key == "pid" && source.pid && source.outputPid != *source.pid && parseInteger(text) == source.pid)
+				{
+					m_rewritten.append(event.substr(copied, begin - copied));
+					m_rewritten += std::to_string(source.outputPid);
+					copied = end;
+				}
+			});
+			m_rewritten.append(event.substr(copied));
+		}
+
+		std::string m_event;
+		std::string m_rewritten;
+		std::string m_sampling;                  // merged entries, comma-separated
+		std::string m_overhead;                  // one entry per process, comma-separated
+		bool m_first = true;
+	};
+
+	// ========================================================================
+	// Perfetto protobuf
+	// ========================================================================
+
+	// Field numbers from perfetto/protos/perfetto/trace/
+	namespace pb
+	{
+		constexpr uint32_t kTracePacket = 1;                      // Trace.packet
+
+		constexpr uint32_t kPacketClockSnapshot = 6;              // TracePacket
+		constexpr uint32_t kPacketTimestamp = 8;
+		constexpr uint32_t kPacketSequenceId = 10;
+		constexpr uint32_t kPacketTrackEvent = 11;
+		constexpr uint32_t kPacketTrackDescriptor = 60;
+
+		constexpr uint32_t kEventTrackUuid = 11;                  // TrackEvent
+
+		constexpr uint32_t kTrackUuid = 1;                        // TrackDescriptor
+		constexpr uint32_t kTrackProcess = 3;
+		constexpr uint32_t kTrackThread = 4;
+		constexpr uint32_t kTrackParentUuid = 5;
+		constexpr uint32_t kDescriptorPid = 1;                    // Process/ThreadDescriptor
+
+		constexpr uint32_t kSnapshotClocks = 1;                   // ClockSnapshot
+		constexpr uint32_t kClockId = 1;                          // ClockSnapshot.Clock
+		constexpr uint32_t kClockTimestamp = 2;
+		constexpr uint32_t kClockRealtime = 1;                    // BuiltinClock
+		constexpr uint32_t kClockBoottime = 6;
+
+		constexpr uint32_t kWireVarint = 0;
+		constexpr uint32_t kWireFixed64 = 1;
+		constexpr uint32_t kWireBytes = 2;
+		constexpr uint32_t kWireFixed32 = 5;
+	}
+
+	struct ProtoField
+	{
+		uint32_t number = 0;
+		uint32_t wireType = 0;
+		uint64_t value = 0;                      // varint and fixed fields
+		std::string_view bytes;                  // length-delimited fields
+	};
+
+	bool readVarint(std::string_view& data, uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64 && !data.empty(); shift += 7)
+		{
+			const auto byte = static_cast<uint8_t>(data.front());
+			data.remove_prefix(1);
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (byte < 0x80)
+				return true;
+		}
+		return false;
+	}
+
+	bool readVarint(InputFile& in, uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			const int byte = in.get();
+			if (byte == EOF)
+				return false;
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (byte < 0x80)
+				return true;
+		}
+		return false;
+	}
+
+	bool nextField(std::string_view& data, ProtoField& field)
+	{
+		uint64_t key = 0;
+		if (data.empty() || !readVarint(data, key))
+			return false;
+		field.number = static_cast<uint32_t>(key >> 3);
+		field.wireType = static_cast<uint32_t>(key & 7);
+		field.bytes = {};
+		switch (field.wireType)
+		{
+		case pb::kWireVarint:
+			return readVarint(data, field.value);
+		case pb::kWireFixed64:
+		case pb::kWireFixed32:
+		{
+			const size_t size = field.wireType == pb::kWireFixed64 ? 8 : 4;
+			if (data.size() < size)
+				return false;
+			field.value = 0;
+			for (size_t i = 0; i < size; ++i)
+				field.value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+			data.remove_prefix(size);
+			return true;
+		}
+		case pb::kWireBytes:
+		{
+			uint64_t size = 0;
+			if (!readVarint(data, size) || size > data.size())
+				return false;
+			field.bytes = data.substr(0, size);
+			data.remove_prefix(size);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	void writeVarint(std::string& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<char>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	void writeField(std::string& out, const ProtoField& field)
+	{
+		writeVarint(out, (static_cast<uint64_t>(field.number) << 3) | field.wireType);
+		switch (field.wireType)
+		{
+		case pb::kWireVarint:
+			writeVarint(out, field.value);
+			break;
+		case pb::kWireFixed64:
+		case pb::kWireFixed32:
+			for (int i = 0; i < (field.wireType == pb::kWireFixed64 ? 8 : 4); ++i)
+				out.push_back(static_cast<char>(field.value >> (8 * i)));
+			break;
+		case pb::kWireBytes:
+			writeVarint(out, field.bytes.size());
+			out.append(field.bytes);
+			break;
+		}
+	}
+
+	void writeMessage(std::string& out, uint32_t number, std::string_view message)
+	{
+		ProtoField field;
+		field.number = number;
+		field.wireType = pb::kWireBytes;
+		field.bytes = message;
+		writeField(out, field);
+	}
+
+	// Copies a message, letting fn replace varint fields by number
+	template <typename Fn>
+	bool rewriteVarints(std::string_view message, std::string& out, Fn&& fn)
+	{
+		ProtoField field;
+		while (nextField(message, field))
+		{
+			if (field.wireType == pb::kWireVarint)
+				field.value = fn(field.number, field.value);
+			writeField(out, field);
+		}
+		return message.empty();
+	}
+
+	class PerfettoMerger
+	{
+	public:
+		bool readPacket(InputFile& in, std::string& packet)
+		{
+			for (;;)
+			{
+				uint64_t key = 0;
+				uint64_t size = 0;
+				if (!readVarint(in, key) || (key & 7) != pb::kWireBytes || !readVarint(in, size))
+					return false;
+				packet.clear();
+				if (!in.read(size, packet))
+					return false;
+				if ((key >> 3) == pb::kTracePacket)
+					return true;
+			}
+		}
+
+		// Looks for the clock snapshot and process descriptor near the start
+		bool readHeader(Source& source)
+		{
+			constexpr int kHeaderPackets = 64;
+			std::string packet;
+			for (int i = 0; i < kHeaderPackets && !(source.clockAnchorNs && source.pid); ++i)
+			{
+				if (!readPacket(source.file, packet))
+					break;
+				std::string_view data = packet;
+				ProtoField field;
+				while (nextField(data, field))
+				{
+					if (field.number == pb::kPacketClockSnapshot)
+						readClockSnapshot(field.bytes, source);
+					else if (field.number == pb::kPacketTrackDescriptor)
+						readProcessPid(field.bytes, source);
+				}
+			}
+			source.file.rewind();
+			return true;
+		}
+
+		void begin(OutputFile& out, int64_t clockAnchorNs)
+		{
+			std::string clock;
+			std::string snapshot;
+			std::string packet;
+			ProtoField field;
+			field.wireType = pb::kWireVarint;
+			for (const auto& [id, timestamp] : { std::pair<uint64_t, int64_t>{ pb::kClockBoottime, 0 }, { pb::kClockRealtime, clockAnchorNs } })
+			{
+				clock.clear();
+				field.number = pb::kClockId;
+				field.value = id;
+				writeField(clock, field);
+				field.number = pb::kClockTimestamp;
+				field.value = static_cast<uint64_t>(timestamp);
+				writeField(clock, field);
+				writeMessage(snapshot, pb::kSnapshotClocks, clock);
+			}
+			writeMessage(packet, pb::kPacketClockSnapshot, snapshot);
+			writePacket(out, packet);
+		}
+
+		bool copyPackets(OutputFile& out, Source& source, uint64_t salt)
+		{
+			std::string packet;
+			while (readPacket(source.file, packet))
+			{
+				if (rewritePacket(packet, source, salt))
+					writePacket(out, m_rewritten);
+			}
+			return true;
+		}
+
+	private:
+		static void readClockSnapshot(std::string_view snapshot, Source& source)
+		{
+			std::optional<int64_t> realtime;
+			std::optional<int64_t> boottime;
+			ProtoField field;
+			while (nextField(snapshot, field))
+			{
+				if (field.number != pb::kSnapshotClocks)
+					continue;
+				std::string_view clock = field.bytes;
+				uint64_t id = 0;
+				uint64_t timestamp = 0;
+				ProtoField member;
+				while (nextField(clock, member))
+				{
+					if (member.number == pb::kClockId)
+						id = member.value;
+					else if (member.number == pb::kClockTimestamp)
+						timestamp = member.value;
+				}
+				if (id == pb::kClockRealtime)
+					realtime = static_cast<int64_t>(timestamp);
+				else if (id == pb::kClockBoottime)
+					boottime = static_cast<int64_t>(timestamp);
+			}
+			// Realtime at event timestamp 0
+			if (realtime && boottime)
+				source.clockAnchorNs = *realtime - *boottime;
+		}
+
+		static void readProcessPid(std::string_view track, Source& source)
+		{
+			ProtoField field;
+			while (nextField(track, field))
+			{
+				if (field.number != pb::kTrackProcess)
+					continue;
+				std::string_view process = field.bytes;
+				ProtoField member;
+				while (nextField(process, member))
+				{
+					if (member.number == pb::kDescriptorPid)
+						source.pid = static_cast<int32_t>(member.value);
+				}
+			}
+		}
+
+		// Into m_rewritten; false for packets that are dropped. Sequence IDs
+		// and track uuids are made unique per input; flow ids are kept, so
+		// flows between processes still connect.
+		bool rewritePacket(std::string_view packet, const Source& source, uint64_t salt)
+		{
+			m_rewritten.clear();
+			ProtoField field;
+			while (nextField(packet, field))
+			{
+				switch (field.number)
+				{
+				case pb::kPacketClockSnapshot:
+					return false;                // replaced by the one from begin()
+				case pb::kPacketTimestamp:
+				{
+					const int64_t ns = static_cast<int64_t>(field.value) + source.shiftNs;
+					field.value = static_cast<uint64_t>(std::max<int64_t>(ns, 0));
+					break;
+				}
+				case pb::kPacketSequenceId:
+				{
+					const auto [it, added] = m_sequences.try_emplace({ &source, field.value }, m_sequences.size() + 1);
+					field.value = it->second;
+					break;
+				}
+				case pb::kPacketTrackEvent:
+					m_message.clear();
+					rewriteVarints(field.bytes, m_message, [&](uint32_t number, uint64_t value) {
+						return number == pb::kEventTrackUuid ? value ^ salt : value;
+					});
+					field.bytes = m_message;
+					break;
+				case pb::kPacketTrackDescriptor:
+					m_message.clear();
+					rewriteTrack(field.bytes, source, salt);
+					field.bytes = m_message;
+					break;
+				}
+				writeField(m_rewritten, field);
+			}
+			return true;
+		}
+
+		void rewriteTrack(std::string_view track, const Source& source, uint64_t salt)
+		{
+			ProtoField field;
+			std::string descriptor;
+			while (nextField(track, field))
+			{
+				if (field.wireType == pb::kWireVarint && (field.number == pb::kTrackUuid || field.number == pb::kTrackParentUuid))
+					field.value ^= salt;
+				if (field.number == pb::kTrackProcess || field.number == pb::kTrackThread)
+				{
+					descriptor.clear();
+					rewriteVarints(field.bytes, descriptor, [&](uint32_t number, uint64_t value) {
+						if (number == pb::kDescriptorPid && source.pid && static_cast<int32_t>(value) == *source.pid)
+							return static_cast<uint64_t>(source.outputPid);
+						return value;
+					});
+					field.bytes = descriptor;
+				}
+				writeField(m_message, field);
+			}
+		}
+
+		static void writePacket(OutputFile& out, std::string_view packet)
+		{
+			std::string frame;
+			writeMessage(frame, pb::kTracePacket, packet);
+			out.write(frame);
+		}
+
+		struct SequenceKey
+		{
+			const Source* source;
+			uint64_t sequence;
+			bool operator==(const SequenceKey&) const = default;
+		};
+
+		struct SequenceHash
+		{
+			size_t operator()(const SequenceKey& key) const
+			{
+				return std::hash<const void*>()(key.source) ^ std::hash<uint64_t>()(key.sequence);
+			}
+		};
+
+		std::unordered_map<SequenceKey, uint64_t, SequenceHash> m_sequences;
+		std::string m_rewritten;
+		std::string m_message;
+	};
+
+	// Track uuids of input i are xor'ed with this; input 0 keeps its own
+	uint64_t trackSalt(size_t input)
+	{
+		return static_cast<uint64_t>(input) * 0x9E3779B97F4A7C15ull;
+	}
+
+	void printUsage()
+	{
+		std::cerr << "usage: tracer_merge -o <output> <input> <input>...\n"
+			"Merges Chrome JSON or Perfetto traces, aligning them by the clock\n"
+			"anchor each recording session stores.\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string outputPath;
+	std::vector<std::unique_ptr<Source>> sources;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (arg == "-h" || arg == "--help")
+		{
+			printUsage();
+			return 0;
+		}
+		else
+		{
+			sources.push_back(std::make_unique<Source>());
+			sources.back()->path = arg;
+		}
+	}
+	if (outputPath.empty() || sources.empty())
+	{
+		printUsage();
+		return 1;
+	}
+
+	// The exporters write no leading whitespace: '{' is JSON, anything else a
+	// Perfetto packet tag
+	std::optional<bool> json;
+	for (const auto& source : sources)
+	{
+		if (!source->file.open(source->path))
+		{
+			std::cerr << source->path << ": cannot open\n";
+			return 1;
+		}
+		const bool isJson = source->file.peek() == '{';
+		if (json && *json != isJson)
+		{
+			std::cerr << source->path << ": all inputs must be in the same format\n";
+			return 1;
+		}
+		json = isJson;
+	}
+
+	JsonMerger jsonMerger;
+	PerfettoMerger perfettoMerger;
+	for (const auto& source : sources)
+	{
+		const bool ok = *json ? jsonMerger.readHeader(*source) : perfettoMerger.readHeader(*source);
+		if (!ok)
+		{
+			std::cerr << source->path << ": not a trace written by the tracer\n";
+			return 1;
+		}
+	}
+	assignPids(sources);
+	const int64_t clockAnchorNs = alignClocks(sources);
+
+	OutputFile out;
+	if (!out.open(outputPath))
+	{
+		std::cerr << outputPath << ": cannot create\n";
+		return 1;
+	}
+	if (*json)
+		jsonMerger.begin(out, sources, clockAnchorNs);
+	else
+		perfettoMerger.begin(out, clockAnchorNs);
+
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		Source& source = *sources[i];
+		const bool ok = *json ? jsonMerger.copyEvents(out, source) : perfettoMerger.copyPackets(out, source, trackSalt(i));
+		if (!ok)
+			std::cerr << source.path << ": malformed input, merged up to the error\n";
+	}
+	if (*json)
+		jsonMerger.end(out);
+
+	if (!out.close())
+	{
+		std::cerr << outputPath << ": write failed\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,311 @@
+// tracer_recover.cpp : Converts the file of a mapped session
+// (TraceOptions::mappedBytes) into a regular trace.
+//
+//   tracer_recover -o trace.json session.tmap
+//   tracer_recover -f perfetto -o trace.pftrace session.tmap
+//
+// Works whether or not the session ended: a process that crashed leaves
+// every event it had completed in the file. Chunks are read one at a time,
+// so memory use does not grow with trace size. Crash dumps
+// (TraceOptions::crashDumpPath) have the same layout and convert the same way.
+
+#include "tracer_export.h"
+#include "tracer_mapped.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	class MappedReader
+	{
+	public:
+		bool open(const std::string& path)
+		{
+			m_file.open(path, std::ios::binary);
+			return m_file.is_open();
+		}
+
+		// Checks the header, then reads the thread table and strings
+		bool readHeader(std::string& error)
+		{
+			if (!readAt(0, &m_header, sizeof(m_header))
+				|| std::memcmp(m_header.magic, TraceMappedHeader::kMagic, sizeof(m_header.magic)) != 0)
+			{
+				error = "not a mapped trace file";
+				return false;
+			}
+			if (m_header.version != TraceMappedHeader::kVersion
+				|| m_header.eventBytes != sizeof(TraceEvent) || m_header.argBytes != sizeof(TraceArg)
+				|| (m_header.countBytes != 4 && m_header.countBytes != 8))
+			{
+				error = "written by an incompatible tracer version or architecture";
+				return false;
+			}
+
+			m_threads.resize(m_header.threadCapacity);
+			if (!readAt(m_header.threadsOffset, m_threads.data(), m_threads.size() * sizeof(TraceMappedThread)))
+			{
+				error = "truncated thread table";
+				return false;
+			}
+
+			std::vector<char> strings(std::min(m_header.stringsUsed, m_header.stringsBytes));
+			if (!readAt(m_header.stringsOffset, strings.data(), strings.size()))
+			{
+				error = "truncated string table";
+				return false;
+			}
+			for (size_t offset = 0; offset + sizeof(TraceMappedString) <= strings.size(); )
+			{
+				TraceMappedString entry;
+				std::memcpy(&entry, strings.data() + offset, sizeof(entry));
+				const size_t end = offset + sizeof(entry) + entry.length;
+				if (end > strings.size())
+					break;
+				const std::string_view str(strings.data() + offset + sizeof(entry), entry.length);
+				if (entry.table == TraceMappedString::Name)
+					setString(m_names, entry.id, str);
+				else if (entry.table == TraceMappedString::Category)
+					setString(m_categories, entry.id, str);
+				offset = (end + 3) & ~size_t(3);
+			}
+			return true;
+		}
+
+		const TraceMappedHeader& header() const { return m_header; }
+
+		TraceSessionInfo sessionInfo() const
+		{
+			TraceSessionInfo info;
+			info.startTicks = m_header.startTicks;
+			info.nsPerTick = m_header.nsPerTick;
+			info.pid = m_header.pid;
+			info.processName = m_header.processName;
+			info.hostName = m_header.hostName;
+			info.clockAnchorNs = m_header.clockAnchorNs;
+			return info;
+		}
+
+		// Hands each non-empty chunk to the exporter as one batch; returns the
+		// number of events written
+		uint64_t writeChunks(TraceExporter& exporter)
+		{
+			const size_t eventsEnd = m_header.eventsOffset + size_t(m_header.chunkEvents) * sizeof(TraceEvent);
+			const size_t argsEnd = m_header.argsOffset + size_t(m_header.chunkArgs) * sizeof(TraceArg);
+			if (std::max(eventsEnd, argsEnd) > m_header.chunkBytes)
+				return 0;
+
+			std::vector<char> chunk(m_header.chunkBytes);
+			std::vector<TraceEvent> events(m_header.chunkEvents);
+			std::vector<TraceArg> args(m_header.chunkArgs);
+			const uint64_t chunks = std::min(m_header.chunksUsed, m_header.chunkCapacity);
+			uint64_t written = 0;
+			for (uint64_t i = 0; i < chunks; ++i)
+			{
+				if (!readAt(m_header.chunksOffset + i * m_header.chunkBytes, chunk.data(), chunk.size()))
+					break;
+
+				const size_t count = std::min<size_t>(readCount(chunk, m_header.countOffset), events.size());
+				const size_t argCount = std::min<size_t>(readCount(chunk, m_header.argCountOffset), args.size());
+				if (count == 0)
+					continue;
+				std::memcpy(events.data(), chunk.data() + m_header.eventsOffset, count * sizeof(TraceEvent));
+				std::memcpy(args.data(), chunk.data() + m_header.argsOffset, argCount * sizeof(TraceArg));
+
+				// Strings that never made it into the file still need a slot
+				for (size_t e = 0; e < count; ++e)
+				{
+					TraceEvent& ev = events[e];
+					if (ev.argIndex + size_t(ev.argCount) > argCount)
+						ev.argCount = 0;
+					if (ev.name == kTraceAddressName)
+					{
+						ev.name = addressName(ev.id);
+						ev.id = 0;
+					}
+					reserveString(m_names, ev.name);
+					reserveString(m_categories, ev.category);
+					for (size_t a = ev.argIndex; a < ev.argIndex + size_t(ev.argCount); ++a)
+					{
+						reserveString(m_names, args[a].key);
+						if (args[a].type == TraceArg::Type::String)
+							reserveString(m_names, args[a].stringValue);
+					}
+				}
+
+				const TraceThreadInfo thread = threadInfo(events[0].thread);
+				exporter.writeEvents({ m_names.views, m_categories.views }, thread,
+					{ events.data(), count }, { args.data(), argCount });
+				written += count;
+			}
+			return written;
+		}
+
+	private:
+		struct Strings
+		{
+			std::deque<std::string> storage;     // stable addresses for the views
+			std::vector<std::string_view> views;
+		};
+
+		bool readAt(uint64_t offset, void* data, size_t size)
+		{
+			m_file.clear();
+			m_file.seekg(static_cast<std::streamoff>(offset));
+			m_file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+			return static_cast<size_t>(m_file.gcount()) == size;
+		}
+
+		uint64_t readCount(const std::vector<char>& chunk, uint32_t offset) const
+		{
+			if (m_header.countBytes == 4)
+			{
+				uint32_t value;
+				std::memcpy(&value, chunk.data() + offset, sizeof(value));
+				return value;
+			}
+			uint64_t value;
+			std::memcpy(&value, chunk.data() + offset, sizeof(value));
+			return value;
+		}
+
+		static void setString(Strings& strings, TraceStringId id, std::string_view str)
+		{
+			reserveString(strings, id);
+			strings.views[id] = strings.storage.emplace_back(str);
+		}
+
+		// IDs whose string did not fit into the file are shown as "#<id>"
+		static void reserveString(Strings& strings, TraceStringId id)
+		{
+			if (id == kTraceNoName)
+				return;
+			while (strings.views.size() <= id)
+			{
+				const size_t missing = strings.views.size();
+				strings.views.push_back(strings.storage.emplace_back("#" + std::to_string(missing)));
+			}
+		}
+
+		// Function instrumentation events carry an address that only the
+		// recording process could look up; they are named by it instead
+		TraceStringId addressName(uint64_t address)
+		{
+			auto [it, added] = m_addressNames.try_emplace(address, 0);
+			if (added)
+			{
+				char hex[2 + 16] = { '0', 'x' };
+				const auto result = std::to_chars(hex + 2, hex + sizeof(hex), address, 16);
+				it->second = static_cast<TraceStringId>(m_names.views.size());
+				m_names.views.push_back(m_names.storage.emplace_back(hex, result.ptr));
+			}
+			return it->second;
+		}
+
+		TraceThreadInfo threadInfo(uint32_t index)
+		{
+			TraceThreadInfo info{ index, {}, std::nullopt };
+			if (index >= m_threads.size())
+				return info;
+			const TraceMappedThread& thread = m_threads[index];
+			if (thread.flags & TraceMappedThread::kNamed)
+			{
+				reserveString(m_names, thread.name);
+				info.name = m_names.views[thread.name];
+			}
+			if (thread.flags & TraceMappedThread::kSorted)
+				info.sortIndex = static_cast<int32_t>(thread.sortIndex);
+			return info;
+		}
+
+		std::ifstream m_file;
+		TraceMappedHeader m_header{};
+		std::vector<TraceMappedThread> m_threads;
+		Strings m_names;
+		Strings m_categories;
+		std::unordered_map<uint64_t, TraceStringId> m_addressNames;
+	};
+
+	void printUsage()
+	{
+		std::cerr << "usage: tracer_recover [-f json|perfetto] -o <output> <input>\n"
+			"Converts a file recorded with TraceOptions::mappedBytes, or a crash\n"
+			"dump (TraceOptions::crashDumpPath), into Chrome JSON (default) or\n"
+			"Perfetto protobuf.\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string outputPath;
+	std::string inputPath;
+	std::string_view format = "json";
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (arg == "-f" && i + 1 < argc)
+			format = argv[++i];
+		else if (arg == "-h" || arg == "--help")
+		{
+			printUsage();
+			return 0;
+		}
+		else
+			inputPath = arg;
+	}
+	if (outputPath.empty() || inputPath.empty() || (format != "json" && format != "perfetto"))
+	{
+		printUsage();
+		return 1;
+	}
+
+	MappedReader reader;
+	if (!reader.open(inputPath))
+	{
+		std::cerr << inputPath << ": cannot open\n";
+		return 1;
+	}
+	std::string error;
+	if (!reader.readHeader(error))
+	{
+		std::cerr << inputPath << ": " << error << "\n";
+		return 1;
+	}
+
+	std::ofstream out(outputPath, std::ios::binary);
+	if (!out)
+	{
+		std::cerr << outputPath << ": cannot open\n";
+		return 1;
+	}
+
+	const std::unique_ptr<TraceExporter> exporter = format == "perfetto" ? makePerfettoExporter() : makeJsonExporter();
+	exporter->begin(out, reader.sessionInfo());
+	const uint64_t events = reader.writeChunks(*exporter);
+	exporter->end({});
+	out.close();
+	if (!out)
+	{
+		std::cerr << outputPath << ": write failed\n";
+		return 1;
+	}
+
+	const TraceMappedHeader& header = reader.header();
+	std::cerr << "Recovered " << events << " events\n";
+	if (header.state != TraceMappedHeader::Closed)
+		std::cerr << "The session did not end; the trace stops at the last complete event\n";
+	if (header.chunksUsed > header.chunkCapacity)
+		std::cerr << "The file filled up; later events were dropped\n";
+	return 0;
+}
@@ -0,0 +1,609 @@
+// tracer_tests.cpp : Regression checks, run by ctest. Each check prints what
+// went wrong; the exit code is the number of failed checks.
+
+#include "tracer.h"
+#include "tracer_mapped.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	int g_failures = 0;
+
+#define TEST_CHECK(expr) \
+	do { if (!(expr)) { ++g_failures; std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #expr "\n"; } } while (0)
+
+	const TraceScopeStats* findRow(const std::vector<TraceScopeStats>& rows, const std::string& name)
+	{
+		for (const TraceScopeStats& row : rows)
+		{
+			if (row.name == name)
+				return &row;
+		}
+		return nullptr;
+	}
+
+	// Arrays refilled between calls must be interned on every call, not
+	// cached per call site like literals
+	void runtimeArrayNames()
+	{
+		TraceOptions options;
+		options.aggregate = true;
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+		for (int i = 0; i < 4; ++i)
+		{
+			char buffer[32];
+			std::snprintf(buffer, sizeof(buffer), "Item_%d", i);
+			TRACE_SCOPE(buffer);
+
+			const char constBuffer[] = { 'C', static_cast<char>('0' + i), '\0' };
+			TRACE_SCOPE_ARGS(constBuffer, TRACE_ARG("i", i));
+
+			TRACE_SCOPE("Literal");
+		}
+
+		const std::vector<TraceScopeStats> rows = tracer.profile();
+		for (int i = 0; i < 4; ++i)
+		{
+			const TraceScopeStats* item = findRow(rows, "Item_" + std::to_string(i));
+			TEST_CHECK(item && item->count == 1);
+			const TraceScopeStats* constItem = findRow(rows, "C" + std::to_string(i));
+			TEST_CHECK(constItem && constItem->count == 1);
+		}
+		const TraceScopeStats* literal = findRow(rows, "Literal");
+		TEST_CHECK(literal && literal->count == 4);
+		tracer.endSession();
+		std::remove("tracer_tests.json");
+	}
+
+	size_t countOccurrences(const std::string& path, const std::string& needle)
+	{
+		std::ifstream file(path, std::ios::binary);
+		const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		size_t count = 0;
+		for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1))
+			++count;
+		return count;
+	}
+
+	// Start times of the JSON events called name, in file order
+	std::vector<double> eventStarts(const std::string& path, const std::string& name)
+	{
+		std::ifstream file(path, std::ios::binary);
+		const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		const std::string needle = "{\"name\":\"" + name + "\"";
+		std::vector<double> starts;
+		for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1))
+		{
+			const size_t ts = text.find("\"ts\":", pos);
+			if (ts != std::string::npos)
+				starts.push_back(std::stod(text.substr(ts + 5, 32)));
+		}
+		return starts;
+	}
+
+	// A wrapped ring is read from its oldest chunk, so one thread's events
+	// come out in the order they were recorded
+	void ringWrapKeepsOrder()
+	{
+		constexpr size_t kRingEvents = 2048;
+		constexpr size_t kChunkEvents = 1024;    // events per chunk without arguments
+		TraceOptions options;
+		options.ringBufferEvents = kRingEvents;
+		options.ringBufferArgsPerEvent = 0;
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+
+		// Dumped at every position of the chunk being written in the ring
+		for (int dump = 0; dump < 4; ++dump)
+		{
+			for (size_t i = 0; i < kChunkEvents + 100; ++i)
+			{
+				TRACE_SCOPE("RingOrder");
+			}
+			TEST_CHECK(tracer.dumpFlightRecorder("tracer_tests_ring.json"));
+			const std::vector<double> starts = eventStarts("tracer_tests_ring.json", "RingOrder");
+			TEST_CHECK(dump == 0 || starts.size() >= kRingEvents);
+			TEST_CHECK(std::is_sorted(starts.begin(), starts.end()));
+		}
+
+		// A window longer than the clock has run keeps the whole session
+		TEST_CHECK(tracer.dumpFlightRecorder("tracer_tests_ring.json", 1e10));
+		TEST_CHECK(eventStarts("tracer_tests_ring.json", "RingOrder").size() >= kRingEvents);
+		tracer.endSession();
+		std::remove("tracer_tests_ring.json");
+		std::remove("tracer_tests.json");
+	}
+
+#if !defined(_WIN32)
+	// Event start times of a crash dump or mapped file, in file order
+	std::vector<uint64_t> mappedStarts(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		TraceMappedHeader header{};
+		std::vector<uint64_t> starts;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| std::memcmp(header.magic, TraceMappedHeader::kMagic, sizeof(header.magic)) != 0)
+			return starts;
+
+		std::vector<char> chunk(header.chunkBytes);
+		for (uint64_t i = 0; i < std::min(header.chunksUsed, header.chunkCapacity); ++i)
+		{
+			file.seekg(static_cast<std::streamoff>(header.chunksOffset + i * header.chunkBytes));
+			if (!file.read(chunk.data(), static_cast<std::streamsize>(chunk.size())))
+				break;
+			uint64_t count = 0;
+			std::memcpy(&count, chunk.data() + header.countOffset, std::min<size_t>(header.countBytes, sizeof(count)));
+			for (uint64_t e = 0; e < std::min<uint64_t>(count, header.chunkEvents); ++e)
+			{
+				TraceEvent ev;
+				std::memcpy(&ev, chunk.data() + header.eventsOffset + e * sizeof(TraceEvent), sizeof(ev));
+				starts.push_back(ev.timestamp);
+			}
+		}
+		return starts;
+	}
+
+	// A crash dump of a wrapped ring has its chunks oldest first
+	void crashDumpKeepsOrder()
+	{
+		std::remove("tracer_tests_crash.tmap");
+		const pid_t child = fork();
+		if (child == 0)
+		{
+			TraceOptions options;
+			options.ringBufferEvents = 2048;
+			options.ringBufferArgsPerEvent = 0;
+			options.crashDumpPath = "tracer_tests_crash.tmap";
+			ChromeTracer::instance().beginSession("tracer_tests_crash.json", options);
+			for (int i = 0; i < 1024 * 3 + 100; ++i)
+			{
+				TRACE_SCOPE("CrashOrder");
+			}
+			std::abort();
+		}
+		int status = 0;
+		TEST_CHECK(child > 0 && waitpid(child, &status, 0) == child);
+		const std::vector<uint64_t> starts = mappedStarts("tracer_tests_crash.tmap");
+		TEST_CHECK(starts.size() >= 2048);
+		TEST_CHECK(std::is_sorted(starts.begin(), starts.end()));
+		std::remove("tracer_tests_crash.tmap");
+	}
+#endif
+
+	// Arguments are exported with the JSON type of their value
+	void argsKeepTypes()
+	{
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", TraceOptions{});
+		TRACE_INSTANT_ARGS("Typed", "test", TRACE_ARG("i", -3), TRACE_ARG("u", 7u), TRACE_ARG("d", 1.5),
+			TRACE_ARG("b", true), TRACE_ARG("s", "text"));
+		tracer.endSession();
+		TEST_CHECK(countOccurrences("tracer_tests.json", "\"args\":{\"i\":-3,\"u\":7,\"d\":1.5,\"b\":true,\"s\":\"text\"}") == 1);
+		std::remove("tracer_tests.json");
+	}
+
+	// A ring keeps ringBufferEvents events even when each carries an argument
+	void ringKeepsEventsWithArgs()
+	{
+		constexpr size_t kRingEvents = 4096;
+		TraceOptions options;
+		options.ringBufferEvents = kRingEvents;
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+		for (int i = 0; i < 20000; ++i)
+		{
+			TRACE_SCOPE_ARGS("RingScope", TRACE_ARG("i", i));
+		}
+		TEST_CHECK(tracer.dumpFlightRecorder("tracer_tests_ring.json"));
+		tracer.endSession();
+		TEST_CHECK(countOccurrences("tracer_tests_ring.json", "\"RingScope\"") >= kRingEvents);
+		std::remove("tracer_tests_ring.json");
+		std::remove("tracer_tests.json");
+	}
+
+	// Threads that record without pause until stopped
+	class RecordingThreads
+	{
+	public:
+		explicit RecordingThreads(int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				m_threads.emplace_back([this] {
+					while (!m_stop.load(std::memory_order_relaxed))
+					{
+						TRACE_SCOPE("Busy");
+					}
+				});
+			}
+		}
+
+		~RecordingThreads()
+		{
+			m_stop = true;
+			for (std::thread& thread : m_threads)
+				thread.join();
+		}
+
+	private:
+		std::atomic<bool> m_stop{ false };
+		std::vector<std::thread> m_threads;
+	};
+
+	double secondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Writer passes are bounded, so rotating and ending a streaming session
+	// return while threads record faster than the exporter writes
+	void streamingUnderLoad(TraceCompression compression)
+	{
+		constexpr double kMaxSeconds = 5.0;
+		TraceOptions options;
+		options.streaming = true;
+		options.compression = compression;
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests_stream.json", options);
+		{
+			RecordingThreads threads(4);
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			for (int i = 0; i < 2; ++i)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				TEST_CHECK(tracer.rotateSession("tracer_tests_stream_" + std::to_string(i) + ".json"));
+				TEST_CHECK(secondsSince(start) < kMaxSeconds);
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+			const auto start = std::chrono::steady_clock::now();
+			tracer.endSession();
+			TEST_CHECK(secondsSince(start) < kMaxSeconds);
+		}
+		// Each file has its own session's events, gzip ones aside
+		if (compression == TraceCompression::None)
+		{
+			TEST_CHECK(countOccurrences("tracer_tests_stream.json", "\"Busy\"") > 0);
+			TEST_CHECK(countOccurrences("tracer_tests_stream_0.json", "\"Busy\"") > 0);
+			TEST_CHECK(countOccurrences("tracer_tests_stream_1.json", "\"Busy\"") > 0);
+		}
+		std::remove("tracer_tests_stream.json");
+		std::remove("tracer_tests_stream_0.json");
+		std::remove("tracer_tests_stream_1.json");
+	}
+
+	// Overhead metadata has the calibrated cost of each event kind
+	void overheadByKind()
+	{
+		TraceOptions options;
+		options.subtractOverhead = true;
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+		{
+			TRACE_SCOPE("Outer");
+			TRACE_INSTANT("Inner", "test");
+			TRACE_COUNTER("Count", 1);
+		}
+		tracer.endSession();
+		for (const char* kind : { "complete", "completeArgs", "instant", "instantArgs", "counter" })
+			TEST_CHECK(countOccurrences("tracer_tests.json", std::string("\"") + kind + "\":") == 1);
+		TEST_CHECK(countOccurrences("tracer_tests.json", "\"subtracted\":true") == 1);
+		std::remove("tracer_tests.json");
+	}
+
+	// Timing the record cost enables no category the session filters out
+	void calibrationStaysPrivate()
+	{
+		TraceOptions options;
+		options.subtractOverhead = true;
+		options.categories = { "calibration_test" };
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+		TEST_CHECK(!tracer.isCategoryEnabled(tracer.internCategory("tracer")));
+		TEST_CHECK(!tracer.isCategoryEnabled(kTraceCalibrationCategory));
+		TEST_CHECK(tracer.isCategoryEnabled(tracer.internCategory("calibration_test")));
+		tracer.endSession();
+		std::remove("tracer_tests.json");
+	}
+
+	// Only the listed categories record
+	void categoryFilter()
+	{
+		TraceOptions options;
+		options.categories = { "kept" };
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+		TRACE_INSTANT("KeptEvent", "kept");
+		TRACE_INSTANT("FilteredEvent", "filtered");
+		tracer.endSession();
+		TEST_CHECK(countOccurrences("tracer_tests.json", "\"KeptEvent\"") == 1);
+		TEST_CHECK(countOccurrences("tracer_tests.json", "\"FilteredEvent\"") == 0);
+		std::remove("tracer_tests.json");
+	}
+
+	// Categories past TraceCategoryId's range fall into the overflow ID and
+	// stay disabled instead of wrapping onto earlier categories
+	void categoryOverflow()
+	{
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", TraceOptions{});
+		const TraceCategoryId first = tracer.internCategory("overflow_test.0");
+		TraceCategoryId last = first;
+		for (size_t i = 1; i <= kTraceOverflowCategory; ++i)
+			last = tracer.internCategory("overflow_test." + std::to_string(i));
+		TEST_CHECK(last == kTraceOverflowCategory);
+		TEST_CHECK(!tracer.isCategoryEnabled(last));
+		TEST_CHECK(tracer.isCategoryEnabled(first));
+
+		tracer.endSession();
+
+		TraceOptions filtered;
+		filtered.categories = { "overflow_test.0" };
+		tracer.beginSession("tracer_tests.json", filtered);
+		TEST_CHECK(tracer.isCategoryEnabled(first));
+		TEST_CHECK(!tracer.isCategoryEnabled(kTraceOverflowCategory));
+		tracer.endSession();
+		std::remove("tracer_tests.json");
+	}
+	// Runs tracer_analyze on path and returns what it printed, or nothing
+	// if it failed
+	std::string analyze(const std::string& analyzer, const std::string& path)
+	{
+		const std::string command = "\"" + analyzer + "\" -j 2 \"" + path + "\" > tracer_tests_analyze.txt 2>&1";
+		const int status = std::system(command.c_str());
+		std::ifstream file("tracer_tests_analyze.txt");
+		std::string output((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+		std::remove("tracer_tests_analyze.txt");
+		return status == 0 ? output : std::string();
+	}
+
+	// Self and total ms of name in the "Top scopes by self time" table
+	bool scopeTimes(const std::string& output, const std::string& name, double& self, double& total)
+	{
+		std::istringstream lines(output);
+		for (std::string line; std::getline(lines, line); )
+		{
+			if (line.size() <= name.size() + 2 || line.compare(line.size() - name.size() - 2, std::string::npos, "  " + name) != 0)
+				continue;
+			char percent = 0;
+			double share = 0;
+			std::istringstream row(line);
+			if (row >> self >> share >> percent >> total)
+				return true;
+		}
+		return false;
+	}
+
+	// A wrapped ring's chunks can sit in the file newest first. The analyzer
+	// nests them in the order they were filled, so Parent, which ends in the
+	// newer chunk, still encloses the Leaf scopes of the older one.
+	void analyzeInterleavedChunks(const std::string& analyzer)
+	{
+		constexpr uint32_t kChunkEvents = 4;
+		constexpr uint32_t kEventsOffset = 16;
+		constexpr uint32_t kChunkBytes = kEventsOffset + kChunkEvents * sizeof(TraceEvent);
+		const std::string names[] = { "Leaf", "Parent" };
+
+		std::vector<char> strings;
+		for (uint32_t id = 0; id < 2; ++id)
+		{
+			const TraceMappedString entry{ TraceMappedString::Name, id + 1, static_cast<uint32_t>(names[id].size()) };
+			strings.insert(strings.end(), reinterpret_cast<const char*>(&entry), reinterpret_cast<const char*>(&entry + 1));
+			strings.insert(strings.end(), names[id].begin(), names[id].end());
+			strings.resize((strings.size() + 3) & ~size_t(3));
+		}
+
+		TraceMappedHeader header{};
+		std::memcpy(header.magic, TraceMappedHeader::kMagic, sizeof(header.magic));
+		header.version = TraceMappedHeader::kVersion;
+		header.state = TraceMappedHeader::Closed;
+		header.nsPerTick = 1e6;
+		header.eventBytes = sizeof(TraceEvent);
+		header.argBytes = sizeof(TraceArg);
+		header.chunkBytes = kChunkBytes;
+		header.chunkEvents = kChunkEvents;
+		header.eventsOffset = kEventsOffset;
+		header.argsOffset = kChunkBytes;
+		header.argCountOffset = 8;
+		header.countBytes = 8;
+		header.threadsOffset = sizeof(header);
+		header.stringsOffset = sizeof(header);
+		header.stringsBytes = header.stringsUsed = strings.size();
+		header.chunksOffset = sizeof(header) + strings.size();
+		header.chunkCapacity = header.chunksUsed = 2;
+
+		// Times in ms: Leaf [0, 10] and [20, 30] in the older chunk, Parent
+		// [0, 100] and Leaf [110, 120] in the newer one, which comes first
+		struct Scope
+		{
+			uint32_t name;
+			uint64_t start;
+			uint64_t duration;
+		};
+		auto makeChunk = [&](std::initializer_list<Scope> scopes) {
+			std::vector<char> chunk(kChunkBytes);
+			const uint64_t count = scopes.size();
+			std::memcpy(chunk.data(), &count, sizeof(count));
+			size_t e = 0;
+			for (const Scope& scope : scopes)
+			{
+				TraceEvent ev{};
+				ev.timestamp = scope.start;
+				ev.duration = scope.duration;
+				ev.name = scope.name;
+				ev.phase = 'X';
+				std::memcpy(chunk.data() + kEventsOffset + e++ * sizeof(TraceEvent), &ev, sizeof(ev));
+			}
+			return chunk;
+		};
+		const std::vector<char> newer = makeChunk({ { 2, 0, 100 }, { 1, 110, 10 } });
+		const std::vector<char> older = makeChunk({ { 1, 0, 10 }, { 1, 20, 10 } });
+		{
+			std::ofstream file("tracer_tests_wrapped.tmap", std::ios::binary);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+			file.write(newer.data(), kChunkBytes);
+			file.write(older.data(), kChunkBytes);
+		}
+
+		const std::string output = analyze(analyzer, "tracer_tests_wrapped.tmap");
+		double self = 0, total = 0;
+		TEST_CHECK(scopeTimes(output, "Parent", self, total));
+		TEST_CHECK(self == 80.0 && total == 100.0);
+		TEST_CHECK(scopeTimes(output, "Leaf", self, total));
+		TEST_CHECK(self == 30.0 && total == 30.0);
+		std::remove("tracer_tests_wrapped.tmap");
+	}
+
+	// JSON whose events are out of write order is rejected rather than
+	// nested wrong, unless subtracted overhead has shortened its scopes
+	void analyzeRejectsDisorder(const std::string& analyzer)
+	{
+		const char* events = "{\"traceEvents\":["
+			"{\"name\":\"Leaf\",\"ph\":\"X\",\"ts\":20,\"dur\":10,\"pid\":1,\"tid\":1},"
+			"{\"name\":\"Leaf\",\"ph\":\"X\",\"ts\":0,\"dur\":10,\"pid\":1,\"tid\":1}]";
+		{
+			std::ofstream file("tracer_tests_disorder.json");
+			file << events << "}";
+		}
+		TEST_CHECK(analyze(analyzer, "tracer_tests_disorder.json").empty());
+		{
+			std::ofstream file("tracer_tests_disorder.json");
+			file << events << ",\"overhead\":{\"subtracted\":true}}";
+		}
+		TEST_CHECK(!analyze(analyzer, "tracer_tests_disorder.json").empty());
+		std::remove("tracer_tests_disorder.json");
+	}
+
+#if !defined(_WIN32)
+	// A mapped session keeps every completed event when its process dies,
+	// and tracer_recover turns the file into a regular trace
+	void mappedSurvivesExit(const std::string& recover)
+	{
+		constexpr int kScopes = 5000;
+		std::remove("tracer_tests_mapped.tmap");
+		const pid_t child = fork();
+		if (child == 0)
+		{
+			TraceOptions options;
+			options.mappedBytes = size_t(16) << 20;
+			ChromeTracer::instance().beginSession("tracer_tests_mapped.tmap", options);
+			for (int i = 0; i < kScopes; ++i)
+			{
+				TRACE_SCOPE("MappedScope");
+			}
+			_exit(0);
+		}
+		int status = 0;
+		TEST_CHECK(child > 0 && waitpid(child, &status, 0) == child);
+		const std::string command = "\"" + recover + "\" -o tracer_tests_mapped.json tracer_tests_mapped.tmap 2> /dev/null";
+		TEST_CHECK(std::system(command.c_str()) == 0);
+		TEST_CHECK(countOccurrences("tracer_tests_mapped.json", "\"MappedScope\"") == kScopes);
+		std::remove("tracer_tests_mapped.tmap");
+		std::remove("tracer_tests_mapped.json");
+	}
+
+	// tracer_collect forwards a live session's events while it records and
+	// exits once it ends
+	void liveReachesCollector(const std::string& collect)
+	{
+		const std::string name = "tracer_tests_live_" + std::to_string(getpid());
+		std::remove("tracer_tests_live.json");
+		TraceOptions options;
+		options.liveName = name;
+		options.liveBytes = size_t(4) << 20;
+		ChromeTracer& tracer = ChromeTracer::instance();
+		tracer.beginSession("tracer_tests.json", options);
+
+		const pid_t child = fork();
+		if (child == 0)
+		{
+			const int null = open("/dev/null", O_WRONLY);
+			dup2(null, STDERR_FILENO);
+			execl(collect.c_str(), collect.c_str(), "-o", "tracer_tests_live.json", name.c_str(), static_cast<char*>(nullptr));
+			_exit(127);
+		}
+		TEST_CHECK(child > 0);
+
+		// Until the collector has attached and forwarded something
+		const auto start = std::chrono::steady_clock::now();
+		while (child > 0 && countOccurrences("tracer_tests_live.json", "\"LiveScope\"") == 0 && secondsSince(start) < 10)
+		{
+			for (int i = 0; i < 1000; ++i)
+			{
+				TRACE_SCOPE("LiveScope");
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		tracer.endSession();
+
+		int status = -1;
+		while (child > 0 && waitpid(child, &status, WNOHANG) == 0 && secondsSince(start) < 20)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (child > 0 && status == -1)
+		{
+			kill(child, SIGKILL);
+			waitpid(child, &status, 0);
+		}
+		TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		TEST_CHECK(countOccurrences("tracer_tests_live.json", "\"LiveScope\"") > 0);
+		TEST_CHECK(countOccurrences("tracer_tests_live.json", "\"traceEvents\"") == 1);
+		std::remove("tracer_tests_live.json");
+		std::remove("tracer_tests.json");
+	}
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	runtimeArrayNames();
+	argsKeepTypes();
+	ringKeepsEventsWithArgs();
+	ringWrapKeepsOrder();
+#if !defined(_WIN32)
+	crashDumpKeepsOrder();
+#endif
+	streamingUnderLoad(TraceCompression::None);
+	streamingUnderLoad(TraceCompression::Gzip);
+	overheadByKind();
+	calibrationStaysPrivate();
+	categoryFilter();
+	// ctest passes the paths of tracer_analyze, tracer_recover and tracer_collect
+	if (argc > 1)
+	{
+		analyzeInterleavedChunks(argv[1]);
+		analyzeRejectsDisorder(argv[1]);
+	}
+#if !defined(_WIN32)
+	if (argc > 2)
+		mappedSurvivesExit(argv[2]);
+	if (argc > 3)
+		liveReachesCollector(argv[3]);
+#endif
+	// Last, since the categories it interns stay for later sessions
+	categoryOverflow();
+	if (g_failures > 0)
+		std::cerr << g_failures << " checks failed\n";
+	return g_failures;
+}